@@ -0,0 +1,621 @@
+﻿#include <ZnSerialize/zn_serialize.hpp>
+#include <ZnSerialize/zn_serialize_batch.hpp>
+#include <ZnSerialize/zn_serialize_compress.hpp>
+#include <ZnSerialize/zn_serialize_checksum.hpp>
+#include <ZnSerialize/zn_serialize_ring.hpp>
+#include <ZnSerialize/zn_serialize_columnar.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+
+/*
+ * 基准测试: 每行输出一条JSON记录, 便于脚本比较不同版本的结果
+ * 用法: ZnSerializeBench [--scale=倍数] [名称过滤]
+ * 数据由固定种子生成, 每项的迭代次数只由编码长度和scale决定, 不随机器快慢变化
+*/
+
+// 统计内存分配次数
+static std::atomic<size_t> g_allocations(0);
+
+// 替换后的new被内联, GCC会把其中的malloc与delete中的free误报为不匹配
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void* operator new(size_t size)
+{
+    ++g_allocations;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+ZN_STRUCT(Normal)
+{
+    int32_t a;
+    double b;
+    float c;
+    std::string d;
+    std::wstring e;
+    std::tuple<int, double, float> f;
+    ZN_SERIALIZE(a, b, c, d, e, f);
+};
+
+ZN_STRUCT(Used)
+{
+    Normal n1;
+    Normal n2;
+    bool operator<(const Used& o) const { return n1.a < o.n1.a; }
+    ZN_SERIALIZE(n1, n2);
+};
+
+ZN_STRUCT(Container)
+{
+    std::vector<std::shared_ptr<Used>> vector;
+    std::deque<Used> deque;
+    std::list<Used> list;
+    std::set<Used> std_set;
+    std::multiset<Used> multiset;
+    std::map<std::string, Used> map;
+    std::multimap<Used, int> multimap;
+    ZN_SERIALIZE(vector, deque, list, std_set, multiset, map, multimap);
+};
+
+ZN_STRUCT(Child, Container, Normal)
+{
+    std::string name;
+    ZN_SERIALIZE(name);
+};
+
+// 单条消息中的大容器, 用于分块模式的并行解码
+ZN_STRUCT(Snapshot)
+{
+    std::vector<Used> used;
+    std::map<int32_t, Normal> normals;
+    ZN_SERIALIZE(used, normals);
+};
+
+// 只有数值成员, 定长布局整体打包编码
+ZN_STRUCT(Tick)
+{
+    int64_t time;
+    uint32_t symbol;
+    int32_t volume;
+    double prices[4];
+    std::tuple<uint8_t, bool> flags;
+    ZN_SERIALIZE(time, symbol, volume, prices, flags);
+};
+
+// 与Child相同的数据, 按紧凑格式编码
+ZN_STRUCT(CompactChild, Child)
+{
+    typedef zn_serialize::CompactFormat ZnFormat;
+    ZN_SERIALIZE();
+};
+
+struct Options
+{
+    double scale = 1.0;
+    const char* filter = nullptr;
+};
+
+static Options g_options;
+static std::mt19937 g_random(20240601);
+// 结果写入volatile变量, 防止编译器省略编解码
+static volatile size_t g_sink = 0;
+static const void* volatile g_escape = nullptr;
+
+static int32_t random_int(int32_t low, int32_t high)
+{
+    return std::uniform_int_distribution<int32_t>(low, high)(g_random);
+}
+
+static std::string random_string(size_t size)
+{
+    std::string s(size, ' ');
+    for (auto& c : s)
+        c = static_cast<char>(random_int('a', 'z'));
+    return s;
+}
+
+static std::wstring random_wstring(size_t size)
+{
+    std::wstring s(size, L' ');
+    for (auto& c : s)
+        c = static_cast<wchar_t>(random_int(0x4E00, 0x9FA5));
+    return s;
+}
+
+static Normal make_normal()
+{
+    Normal n;
+    n.znset(random_int(-1000000, 1000000), random_int(0, 1000000) / 7.0, random_int(0, 1000) / 3.0f,
+        random_string(16), random_wstring(8), std::make_tuple(random_int(0, 100), random_int(0, 100) / 9.0, 1.5f));
+    return n;
+}
+
+static Used make_used()
+{
+    Used u;
+    u.n1 = make_normal();
+    u.n2 = make_normal();
+    return u;
+}
+
+static Child make_child(size_t items)
+{
+    Child child;
+    static_cast<Normal&>(child) = make_normal();
+    for (size_t i = 0; i < items; ++i)
+    {
+        child.vector.push_back(std::make_shared<Used>(make_used()));
+        child.deque.push_back(make_used());
+        child.list.push_back(make_used());
+        child.std_set.insert(make_used());
+        child.multiset.insert(make_used());
+        child.map[random_string(12)] = make_used();
+        child.multimap.insert(std::make_pair(make_used(), random_int(0, 100)));
+    }
+    child.name = random_string(24);
+    return child;
+}
+
+static bool selected(const std::string& name)
+{
+    return !g_options.filter || name.find(g_options.filter) != std::string::npos;
+}
+
+// 每项大约处理64MB数据, 迭代次数限制在[8, 2000000]
+static size_t iterations_for(size_t bytes)
+{
+    double n = 64.0 * 1024 * 1024 * g_options.scale / (bytes ? bytes : 1);
+    if (n < 8)
+        n = 8;
+    if (n > 2000000 * g_options.scale)
+        n = 2000000 * g_options.scale;
+    return n < 1 ? 1 : static_cast<size_t>(n);
+}
+
+template<typename fn_t>
+static void measure(const std::string& name, const char* format, const char* op, size_t bytes, size_t iterations, fn_t fn)
+{
+    size_t allocations = g_allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i)
+        fn();
+    auto stop = std::chrono::steady_clock::now();
+    allocations = g_allocations - allocations;
+    double seconds = std::chrono::duration<double>(stop - start).count();
+    if (seconds <= 0)
+        seconds = 1e-9;
+    std::printf("{\"name\":\"%s\",\"format\":\"%s\",\"op\":\"%s\",\"bytes\":%zu,\"iterations\":%zu,"
+        "\"seconds\":%.6f,\"mb_per_s\":%.2f,\"msgs_per_s\":%.1f,\"allocs_per_msg\":%.2f}\n",
+        name.c_str(), format, op, bytes, iterations, seconds,
+        bytes * static_cast<double>(iterations) / seconds / (1024 * 1024),
+        iterations / seconds, allocations / static_cast<double>(iterations));
+    std::fflush(stdout);
+}
+
+template<typename format_t> struct FormatName;
+template<> struct FormatName<zn_serialize::FixedFormat> { static const char* get() { return "fixed"; } };
+template<> struct FormatName<zn_serialize::CompactFormat> { static const char* get() { return "compact"; } };
+template<> struct FormatName<zn_serialize::PortableFormat> { static const char* get() { return "portable"; } };
+
+// 编码时每条消息使用新的缓冲区, 解码时每条消息解码为新的对象, 与一般的调用方式一致
+template<typename format_t, typename t>
+static void bench_format(const std::string& name, const t& v)
+{
+    typedef zn_serialize::FormatSink<format_t, ZnSerializeBuffer> Sink;
+    ZnSerializeBuffer encoded;
+    {
+        Sink sink(encoded);
+        zn_serialize::serialize(sink, v);
+    }
+    size_t bytes = encoded.size();
+    size_t iterations = iterations_for(bytes);
+    const char* format = FormatName<format_t>::get();
+    measure(name, format, "encode", bytes, iterations, [&]
+    {
+        ZnSerializeBuffer buf;
+        Sink sink(buf);
+        zn_serialize::serialize(sink, v);
+        g_sink += buf.size();
+    });
+    measure(name, format, "decode", bytes, iterations, [&]
+    {
+        t out;
+        zn_serialize::Reader<format_t> in(encoded);
+        zn_serialize::deserialize(in, out);
+        g_escape = &out;
+        g_sink += in.remain();
+    });
+    t reused;
+    measure(name, format, "decode_reuse", bytes, iterations, [&]
+    {
+        zn_serialize::Reader<format_t> in(encoded, true);
+        zn_serialize::deserialize(in, reused);
+        g_escape = &reused;
+        g_sink += in.remain();
+    });
+}
+
+template<typename t>
+static void bench(const std::string& name, const t& v)
+{
+    if (!selected(name))
+        return;
+    bench_format<zn_serialize::FixedFormat>(name, v);
+    bench_format<zn_serialize::CompactFormat>(name, v);
+    bench_format<zn_serialize::PortableFormat>(name, v);
+}
+
+// 结构体按自身声明的格式编码
+template<typename t>
+static void bench_struct(const std::string& name, const t& v)
+{
+    if (!selected(name))
+        return;
+    ZnSerializeBuffer encoded;
+    v.serialize(encoded);
+    size_t bytes = encoded.size();
+    size_t iterations = iterations_for(bytes);
+    const char* format = FormatName<typename t::ZnFormat>::get();
+    measure(name, format, "encode", bytes, iterations, [&]
+    {
+        ZnSerializeBuffer buf;
+        v.serialize(buf);
+        g_sink += buf.size();
+    });
+    measure(name, format, "decode", bytes, iterations, [&]
+    {
+        t out;
+        g_sink += out.deserialize(encoded.data(), encoded.data() + encoded.size()) - encoded.data();
+    });
+    t reused;
+    measure(name, format, "decode_reuse", bytes, iterations, [&]
+    {
+        g_sink += zn_serialize::deserialize_reuse(encoded, reused) - encoded.data();
+    });
+}
+
+template<typename t>
+static void bench_batch(const std::string& name, zn_serialize::WorkerPool& pool, const std::vector<t>& messages)
+{
+    if (!selected(name))
+        return;
+    ZnSerializeBuffer framed;
+    zn_serialize::serialize_batch(pool, messages.begin(), messages.end(), framed);
+    size_t bytes = framed.size();
+    size_t iterations = iterations_for(bytes);
+    const char* format = FormatName<typename t::ZnFormat>::get();
+    // 按批次计时, 每批的消息数与线程数见名称
+    measure(name, format, "encode_batch", bytes, iterations, [&]
+    {
+        ZnSerializeBuffer buf;
+        zn_serialize::serialize_batch(pool, messages.begin(), messages.end(), buf);
+        g_sink += buf.size();
+    });
+    measure(name, format, "decode_batch", bytes, iterations, [&]
+    {
+        std::vector<t> out;
+        zn_serialize::deserialize_batch(pool, framed, out);
+        g_sink += out.size();
+    });
+}
+
+// 压缩与解压已经序列化的数据, bytes为原始长度, 压缩后的长度见compressed_bytes
+static void bench_compress(const std::string& name, const ZnSerializeBuffer& raw)
+{
+    if (!selected(name))
+        return;
+    ZnSerializeBuffer compressed;
+    zn_serialize::compress(raw, compressed);
+    std::printf("{\"name\":\"%s\",\"format\":\"lz\",\"op\":\"ratio\",\"bytes\":%zu,\"compressed_bytes\":%zu}\n", name.c_str(), raw.size(), compressed.size());
+    size_t iterations = iterations_for(raw.size());
+    measure(name, "lz", "compress", raw.size(), iterations, [&]
+    {
+        ZnSerializeBuffer buf;
+        zn_serialize::compress(raw, buf);
+        g_sink += buf.size();
+    });
+    measure(name, "lz", "decompress", raw.size(), iterations, [&]
+    {
+        ZnSerializeBuffer buf;
+        zn_serialize::decompress(compressed, buf);
+        g_sink += buf.size();
+    });
+}
+
+// 带校验值的编解码, 与bench_struct的encode/decode对比即为校验的开销
+template<typename t>
+static void bench_checked(const std::string& name, const t& v)
+{
+    if (!selected(name))
+        return;
+    ZnSerializeBuffer encoded;
+    zn_serialize::serialize_checked(v, encoded);
+    size_t bytes = encoded.size();
+    size_t iterations = iterations_for(bytes);
+    const char* format = FormatName<typename t::ZnFormat>::get();
+    measure(name, format, "encode_checked", bytes, iterations, [&]
+    {
+        ZnSerializeBuffer buf;
+        zn_serialize::serialize_checked(v, buf);
+        g_sink += buf.size();
+    });
+    measure(name, format, "decode_checked", bytes, iterations, [&]
+    {
+        t out;
+        zn_serialize::deserialize_checked(encoded, out);
+        g_escape = &out;
+    });
+    measure(name, "crc32c", "checksum", bytes, iterations, [&]
+    {
+        g_sink += zn_serialize::crc32c(0, encoded.data(), encoded.size());
+    });
+}
+
+// 在同一线程写入环形缓冲区后立即读出, 与bench_struct的encode/decode对比即为省去的分配
+template<typename t>
+static void bench_ring(const std::string& name, const t& v)
+{
+    if (!selected(name))
+        return;
+    size_t bytes = zn_serialize::message_size(v);
+    size_t iterations = iterations_for(bytes);
+    const char* format = FormatName<typename t::ZnFormat>::get();
+    zn_serialize::SpscRing ring((bytes + zn_serialize::RingHeaderSize) * 8);
+    measure(name, format, "push_consume", bytes, iterations, [&]
+    {
+        ring.push(v);
+        ring.consume([](const uint8_t* begin, const uint8_t* end) { g_sink += end - begin; });
+    });
+    measure(name, format, "push_pop", bytes, iterations, [&]
+    {
+        ring.push(v);
+        t out;
+        ring.pop(out);
+        g_escape = &out;
+    });
+}
+
+// 引用跟踪模式的编解码, 与同一对象的bench_struct对比, 编码后的长度见shared_bytes
+template<typename t>
+static void bench_shared(const std::string& name, const t& v)
+{
+    if (!selected(name))
+        return;
+    ZnSerializeBuffer plain, encoded;
+    v.serialize(plain);
+    zn_serialize::serialize_shared(v, encoded);
+    const char* format = FormatName<typename t::ZnFormat>::get();
+    std::printf("{\"name\":\"%s\",\"format\":\"%s\",\"op\":\"ratio\",\"bytes\":%zu,\"shared_bytes\":%zu}\n", name.c_str(), format, plain.size(), encoded.size());
+    size_t bytes = encoded.size();
+    size_t iterations = iterations_for(bytes);
+    measure(name, format, "encode_shared", bytes, iterations, [&]
+    {
+        ZnSerializeBuffer buf;
+        zn_serialize::serialize_shared(v, buf);
+        g_sink += buf.size();
+    });
+    measure(name, format, "decode_shared", bytes, iterations, [&]
+    {
+        t out;
+        zn_serialize::deserialize_shared(encoded, out);
+        g_escape = &out;
+    });
+}
+
+// 列式编解码, 与同一序列按行编码的bench对比, 按列编码与压缩后的长度见columns_bytes与compressed_bytes
+template<typename t>
+static void bench_columns(const std::string& name, const std::vector<t>& rows)
+{
+    if (!selected(name))
+        return;
+    ZnSerializeBuffer plain, encoded, plain_lz, encoded_lz;
+    zn_serialize::serialize(plain, rows);
+    zn_serialize::serialize_columns(rows, encoded);
+    zn_serialize::compress(plain, plain_lz);
+    zn_serialize::compress(encoded, encoded_lz);
+    const char* format = FormatName<typename t::ZnFormat>::get();
+    std::printf("{\"name\":\"%s\",\"format\":\"%s\",\"op\":\"ratio\",\"bytes\":%zu,\"columns_bytes\":%zu,\"compressed_bytes\":%zu,\"columns_compressed_bytes\":%zu}\n",
+        name.c_str(), format, plain.size(), encoded.size(), plain_lz.size(), encoded_lz.size());
+    size_t bytes = encoded.size();
+    size_t iterations = iterations_for(bytes);
+    measure(name, format, "encode_columns", bytes, iterations, [&]
+    {
+        ZnSerializeBuffer buf;
+        zn_serialize::serialize_columns(rows, buf);
+        g_sink += buf.size();
+    });
+    measure(name, format, "decode_columns", bytes, iterations, [&]
+    {
+        std::vector<t> out;
+        zn_serialize::deserialize_columns(encoded, out);
+        g_escape = &out;
+    });
+}
+
+// 分块模式的编解码, decode_parallel使用线程池, decode_blocks在调用线程上顺序解码, 与bench_struct的decode对比
+template<typename t>
+static void bench_parallel(const std::string& name, zn_serialize::WorkerPool& pool, const t& v)
+{
+    if (!selected(name))
+        return;
+    ZnSerializeBuffer encoded;
+    zn_serialize::serialize_parallel(v, encoded);
+    size_t bytes = encoded.size();
+    size_t iterations = iterations_for(bytes);
+    const char* format = FormatName<typename t::ZnFormat>::get();
+    measure(name, format, "encode_parallel", bytes, iterations, [&]
+    {
+        ZnSerializeBuffer buf;
+        zn_serialize::serialize_parallel(v, buf);
+        g_sink += buf.size();
+    });
+    measure(name, format, "decode_blocks", bytes, iterations, [&]
+    {
+        t out;
+        g_sink += zn_serialize::deserialize_parallel(encoded, out) - encoded.data();
+    });
+    measure(name, format, "decode_parallel", bytes, iterations, [&]
+    {
+        t out;
+        g_sink += zn_serialize::deserialize_parallel(encoded, out, &pool) - encoded.data();
+    });
+}
+
+template<typename container_t>
+static container_t random_ints(size_t count)
+{
+    container_t c;
+    for (size_t i = 0; i < count; ++i)
+        c.insert(c.end(), random_int(-1000000, 1000000));
+    return c;
+}
+
+int main(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strncmp(argv[i], "--scale=", 8) == 0)
+            g_options.scale = std::atof(argv[i] + 8);
+        else
+            g_options.filter = argv[i];
+    }
+    if (g_options.scale <= 0)
+        g_options.scale = 1.0;
+
+    // 基础类型
+    bench("int32", static_cast<int32_t>(random_int(-1000000, 1000000)));
+    bench("uint64", static_cast<uint64_t>(random_int(0, 1000000)) << 20);
+    bench("double", random_int(0, 1000000) / 7.0);
+    bench("tuple<int,double,float>", std::make_tuple(random_int(0, 100), 3.14, 2.5f));
+    // 字符串
+    bench("string[16]", random_string(16));
+    bench("string[4096]", random_string(4096));
+    bench("wstring[16]", random_wstring(16));
+    bench("wstring[4096]", random_wstring(4096));
+    // 容器
+    bench("array<int,64>", [] { std::array<int32_t, 64> a; for (auto& v : a) v = random_int(-1000, 1000); return a; }());
+    bench("vector<int>[1024]", random_ints<std::vector<int32_t>>(1024));
+    bench("vector<bool>[1024]", [] { std::vector<bool> v; for (int i = 0; i < 1024; ++i) v.push_back(random_int(0, 1) != 0); return v; }());
+    bench("vector<string>[256]", [] { std::vector<std::string> v; for (int i = 0; i < 256; ++i) v.push_back(random_string(random_int(4, 64))); return v; }());
+    bench("deque<int>[1024]", random_ints<std::deque<int32_t>>(1024));
+    bench("list<int>[1024]", random_ints<std::list<int32_t>>(1024));
+    bench("set<int>[1024]", random_ints<std::set<int32_t>>(1024));
+    bench("multiset<int>[1024]", random_ints<std::multiset<int32_t>>(1024));
+    bench("map<int,string>[256]", [] { std::map<int32_t, std::string> m; for (int i = 0; i < 256; ++i) m[random_int(0, 1000000)] = random_string(16); return m; }());
+    bench("unordered_set<int>[1024]", random_ints<std::unordered_set<int32_t>>(1024));
+    bench("unordered_map<int,string>[256]", [] { std::unordered_map<int32_t, std::string> m; for (int i = 0; i < 256; ++i) m[random_int(0, 1000000)] = random_string(16); return m; }());
+    bench("set<int>[64K]", random_ints<std::set<int32_t>>(65536));
+    bench("unordered_set<int>[64K]", random_ints<std::unordered_set<int32_t>>(65536));
+    bench("multimap<int,int>[1024]", [] { std::multimap<int32_t, int32_t> m; for (int i = 0; i < 1024; ++i) m.insert(std::make_pair(random_int(0, 100), random_int(0, 1000000))); return m; }());
+    bench("shared_ptr<Normal>", std::make_shared<Normal>(make_normal()));
+    // 大型数值数组
+    bench("vector<double>[1M]", [] { std::vector<double> v(1 << 20); for (auto& d : v) d = random_int(0, 1000000) / 7.0; return v; }());
+    bench("vector<int>[1M]", random_ints<std::vector<int32_t>>(1 << 20));
+    bench("vector<uint8_t>[16M]", std::vector<uint8_t>(16 << 20, 0x5A));
+    // 结构体
+    bench_struct("Normal", make_normal());
+    bench_struct("Used", make_used());
+    auto child = make_child(8);
+    bench_struct("Child[8]", child);
+    CompactChild compact_child;
+    static_cast<Child&>(compact_child) = child;
+    bench_struct("CompactChild[8]", compact_child);
+    bench_struct("Child[256]", make_child(256));
+    {
+        Tick tick;
+        tick.time = 1700000000000;
+        tick.symbol = 42;
+        tick.volume = 300;
+        tick.flags = std::make_tuple(uint8_t(1), true);
+        for (int i = 0; i < 4; ++i)
+            tick.prices[i] = random_int(0, 1000000) / 7.0;
+        bench_struct("Tick", tick);
+        bench("vector<Tick>[4096]", std::vector<Tick>(4096, tick));
+    }
+    // 帧校验
+    bench_checked("checked<Child[8]>", child);
+    bench_checked("checked<CompactChild[8]>", compact_child);
+    bench_checked("checked<Child[256]>", make_child(256));
+    // 引用跟踪: 256个引用指向16个不同的对象
+    {
+        Container aliased;
+        std::vector<std::shared_ptr<Used>> unique;
+        for (int i = 0; i < 16; ++i)
+            unique.push_back(std::make_shared<Used>(make_used()));
+        for (int i = 0; i < 256; ++i)
+            aliased.vector.push_back(unique[random_int(0, 15)]);
+        bench_struct("Container[aliased 256/16]", aliased);
+        bench_shared("Container[aliased 256/16]", aliased);
+        bench_shared("Child[8]", child);
+    }
+    // 环形缓冲区
+    bench_ring("ring<Normal>", make_normal());
+    bench_ring("ring<Child[8]>", child);
+    bench_ring("ring<CompactChild[8]>", compact_child);
+    // 列式编码: 字符串成员只有8种取值
+    {
+        std::vector<Normal> rows;
+        std::vector<std::string> symbols;
+        for (int i = 0; i < 8; ++i)
+            symbols.push_back(random_string(8));
+        for (int i = 0; i < 4096; ++i)
+        {
+            rows.push_back(make_normal());
+            rows.back().a = i;
+            rows.back().d = symbols[random_int(0, 7)];
+        }
+        bench("vector<Normal>[4096]", rows);
+        bench_columns("vector<Normal>[4096]", rows);
+    }
+    // 压缩
+    {
+        ZnSerializeBuffer raw;
+        make_child(256).serialize(raw);
+        bench_compress("compress<Child[256]>", raw);
+        raw.clear();
+        std::map<int32_t, Normal> repeated;
+        auto normal = make_normal();
+        for (int i = 0; i < 4096; ++i)
+            repeated[i] = normal;
+        zn_serialize::serialize(raw, repeated);
+        bench_compress("compress<map<int,Normal>[4096]>", raw);
+    }
+    // 批量
+    zn_serialize::WorkerPool pool;
+    std::vector<Normal> normals;
+    for (int i = 0; i < 10000; ++i)
+        normals.push_back(make_normal());
+    bench_batch("batch<Normal>[10000]", pool, normals);
+    std::vector<Child> children;
+    for (int i = 0; i < 256; ++i)
+        children.push_back(make_child(2));
+    bench_batch("batch<Child[2]>[256]", pool, children);
+    // 分块模式
+    Snapshot snapshot;
+    for (int i = 0; i < 65536; ++i)
+    {
+        snapshot.used.push_back(make_used());
+        if (i < 16384)
+            snapshot.normals[i] = make_normal();
+    }
+    bench_struct("Snapshot[64K/16K]", snapshot);
+    bench_parallel("Snapshot[64K/16K]", pool, snapshot);
+    return 0;
+}
@@ -6,6 +6,7 @@
 */
 #pragma once
 #include <stdint.h>
+#include <string.h>
 #include <string>
 #include <vector>
 #include <deque>
@@ -15,7 +16,35 @@
 #include <stack>
 #include <queue>
 #include <tuple>
+#include <array>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#endif
+#ifdef ZN_SERIALIZE_PROFILE
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <typeinfo>
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#endif
+#endif
+
+// 本机是否为大端字节序, 可以在编译时定义为0或1覆盖自动检测的结果
+#ifndef ZN_SERIALIZE_BIG_ENDIAN
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define ZN_SERIALIZE_BIG_ENDIAN 1
+#else
+#define ZN_SERIALIZE_BIG_ENDIAN 0
+#endif
+#endif
 
 typedef std::vector<uint8_t> ZnSerializeBuffer;
 
@@ -31,28 +60,113 @@ namespace zn_serialize
     private:
         std::string message_;
     };
+
+    // 字节内容即为序列化结果的类型, 连续存放时(数组, std::vector, std::deque的块)整块拷贝
+    // 自定义的平凡类型如果没有特化serialize, 可以特化IsBulk开启整块拷贝
+    template<typename t> struct IsBulk : public std::integral_constant<bool, std::is_arithmetic<t>::value || std::is_enum<t>::value> {};
+    template<typename t, size_t s> struct IsBulk<t[s]> : public IsBulk<t> {};
+    template<typename t, size_t s> struct IsBulk<std::array<t, s>> : public IsBulk<t> {};
+
+    template<typename t> struct IsBulkSequence : public std::false_type {};
+    template<typename t, typename a> struct IsBulkSequence<std::vector<t, a>> : public IsBulk<t> {};
+    template<typename a> struct IsBulkSequence<std::vector<bool, a>> : public std::false_type {};
+    template<typename t, typename a> struct IsBulkSequence<std::deque<t, a>> : public IsBulk<t> {};
+
+    // 紧凑格式下变长编码的类型: 多字节的整数与枚举
+    template<typename t> struct IsVarint : public std::integral_constant<bool, (std::is_integral<t>::value || std::is_enum<t>::value) && !std::is_same<t, bool>::value && (sizeof(t) > 1)> {};
+    template<typename t> struct HasVarint : public IsVarint<t> {};
+    template<typename t, size_t s> struct HasVarint<t[s]> : public HasVarint<t> {};
+    template<typename t, size_t s> struct HasVarint<std::array<t, s>> : public HasVarint<t> {};
+
+    // 编码格式, 由输出端与输入端的类型携带, 编译期确定
+    // 默认格式: 数值按内存原样写入, 长度前缀为uint32_t
+    struct FixedFormat
+    {
+        // 该格式下字节内容即为序列化结果, 可以整块拷贝的类型
+        template<typename t> struct Bulk : public IsBulk<t> {};
+    };
+
+    // 紧凑格式: 无符号整数按LEB128变长编码, 有符号整数先zigzag再变长编码, 长度前缀也变长编码
+    // 浮点数, bool与单字节的类型仍按原样写入
+    struct CompactFormat
+    {
+        template<typename t> struct Bulk : public std::integral_constant<bool, IsBulk<t>::value && !HasVarint<t>::value> {};
+    };
+
+    // 可移植格式: 与默认格式相同, 但数值与长度前缀固定为小端序, 宽字符串固定按UTF-16编码(长度前缀为字节数)
+    // 小端的机器上除宽字符串外与默认格式的字节完全相同; 大端的机器上整块拷贝的数组与容器分段交换字节序后写入
+    struct PortableFormat
+    {
+        template<typename t> struct Bulk : public IsBulk<t> {};
+    };
+
+    // 整块拷贝的类型中的标量(数组, std::array的元素), 按它的宽度交换字节序; 自定义的IsBulk类型按原样写入
+    template<typename t> struct BulkScalar { typedef t type; };
+    template<typename t, size_t s> struct BulkScalar<t[s]> : public BulkScalar<t> {};
+    template<typename t, size_t s> struct BulkScalar<std::array<t, s>> : public BulkScalar<t> {};
+
+    // 该格式下t的字节是否需要交换字节序
+    template<typename format_t, typename t> struct NeedSwap : public std::false_type {};
+    template<typename t> struct NeedSwap<PortableFormat, t> : public std::integral_constant<bool, ZN_SERIALIZE_BIG_ENDIAN
+        && (std::is_arithmetic<typename BulkScalar<t>::type>::value || std::is_enum<typename BulkScalar<t>::type>::value)
+        && (sizeof(typename BulkScalar<t>::type) == 2 || sizeof(typename BulkScalar<t>::type) == 4 || sizeof(typename BulkScalar<t>::type) == 8)> {};
+
+    template<typename format_t, typename t> struct IsBulkFor : public format_t::template Bulk<t> {};
+    template<typename format_t, typename t> struct IsBulkSequenceFor
+        : public std::integral_constant<bool, IsBulkSequence<t>::value && IsBulkFor<format_t, typename t::value_type>::value> {};
+
+    // 需要多态时使用的虚接口: ZN_STRUCT(name, zn_serialize::Struct) 或全局定义 ZN_SERIALIZE_VIRTUAL
+    // 嵌套的结构体与基类总是按静态类型直接调用, 不经过虚函数
     struct Struct
     {
         typedef Struct ZnSerialize;
+        typedef FixedFormat ZnFormat;
+        virtual ~Struct() {}
+        virtual size_t serialized_size() const = 0;
         virtual void serialize(ZnSerializeBuffer& buffer) const = 0;
         virtual void deserialize(const ZnSerializeBuffer& buffer) = 0;
         virtual const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end) = 0;
     };
 
+    // 默认的基类, 没有虚函数, 序列化的调用全部在编译期确定, 可以整体内联
+    struct StaticStruct
+    {
+        typedef Struct ZnSerialize;
+        typedef FixedFormat ZnFormat;
+    };
+
+#ifdef ZN_SERIALIZE_VIRTUAL
+    typedef Struct DefaultStruct;
+#else
+    typedef StaticStruct DefaultStruct;
+#endif
+
     template<typename child_t, typename parent_t, typename...args>
     struct Parent : public parent_t, public Parent<Parent<child_t, parent_t, args...>, args...>
     {
         typedef Parent<child_t, parent_t, args...>   parent_pack_t;
     protected:
-        void parent_serialize(child_t* child, ZnSerializeBuffer& buffer)
+        size_t parent_serialized_size(child_t* child)
+        {
+            return child->parent_t::serialized_size() + Parent<Parent<child_t, parent_t, args...>, args...>::parent_serialized_size(this);
+        }
+        template<typename out_t>
+        void parent_serialize(child_t* child, out_t& out)
         {
-            child->parent_t::serialize(buffer);
-            Parent<Parent<child_t, parent_t, args...>, args...>::parent_serialize(this, buffer);
+            child->parent_t::serialize_to(out);
+            Parent<Parent<child_t, parent_t, args...>, args...>::parent_serialize(this, out);
         }
-        const uint8_t* parent_deserialize(child_t* child, const uint8_t* begin, const uint8_t* end)
+        template<typename in_t>
+        void parent_deserialize(child_t* child, in_t& in)
         {
-            auto p = child->parent_t::deserialize(begin, end);
-            return Parent<Parent<child_t, parent_t, args...>, args...>::parent_deserialize(this, p, end);
+            child->parent_t::deserialize_from(in);
+            Parent<Parent<child_t, parent_t, args...>, args...>::parent_deserialize(this, in);
+        }
+        template<typename visitor_t>
+        void parent_visit(child_t* child, visitor_t& visitor)
+        {
+            child->parent_t::visit_members(visitor);
+            Parent<Parent<child_t, parent_t, args...>, args...>::parent_visit(this, visitor);
         }
     };
 
@@ -61,365 +175,2594 @@ namespace zn_serialize
     {
         typedef Parent<child_t, parent_t>   parent_pack_t;
     protected:
-        void parent_serialize(child_t* child, ZnSerializeBuffer& buffer)
+        size_t parent_serialized_size(child_t* child)
+        {
+            return child->parent_t::serialized_size();
+        }
+        template<typename out_t>
+        void parent_serialize(child_t* child, out_t& out)
         {
-            child->parent_t::serialize(buffer);
+            child->parent_t::serialize_to(out);
         }
-        const uint8_t* parent_deserialize(child_t* child, const uint8_t* begin, const uint8_t* end)
+        template<typename in_t>
+        void parent_deserialize(child_t* child, in_t& in)
         {
-            return child->parent_t::deserialize(begin, end);
+            child->parent_t::deserialize_from(in);
+        }
+        template<typename visitor_t>
+        void parent_visit(child_t* child, visitor_t& visitor)
+        {
+            child->parent_t::visit_members(visitor);
         }
     };
 
     template<typename t> inline t* get_zn_struct(double);
     template<typename t> inline typename t::ZnSerialize* get_zn_struct(int);
     template<typename t> struct GetZnStructPtr { typedef decltype(get_zn_struct<t>(0)) Ptr;};
+    template<typename t> struct IsZnStruct : public std::is_same<typename GetZnStructPtr<t>::Ptr, Struct*> {};
 
-    template<typename t>
-    inline void default_serialize(ZnSerializeBuffer& out, const t& v, t* p)
-    {
-        out.insert(out.end(), reinterpret_cast<const uint8_t*>(&v), reinterpret_cast<const uint8_t*>(&v) + sizeof(v));
-    }
+    // 输出端的编码格式, 输出端没有声明ZnFormat时为default_t
+    template<typename out_t, typename default_t> inline default_t* get_sink_format(double);
+    template<typename out_t, typename default_t> inline typename out_t::ZnFormat* get_sink_format(int);
+    template<typename out_t, typename default_t = FixedFormat>
+    struct SinkFormat { typedef typename std::remove_pointer<decltype(get_sink_format<out_t, default_t>(0))>::type type; };
 
-    template<typename t>
-    inline void default_serialize(ZnSerializeBuffer& out, const t& v, Struct* p)
+    // 序列化的输出端(sink), 需要提供:
+    //   void write(const void* data, size_t size)  追加写入
+    //   void reserve(size_t size)                  即将写入size个字节, 可以借此一次性分配空间
+    //   typedef ... ZnFormat                       (可选)编码格式, 默认为FixedFormat
+    // ZnSerializeBuffer也可以直接作为输出端, 每次写入追加到末尾
+    template<typename out_t>
+    inline void write_bytes(out_t& out, const void* data, size_t size)
     {
-        p->serialize(out);
+        out.write(data, size);
     }
 
-    template<typename t>
-    inline const uint8_t* default_deserialize(const uint8_t* begin, const uint8_t* end, t& v, t* p)
+    inline void write_bytes(ZnSerializeBuffer& out, const void* data, size_t size)
     {
-        if (begin + sizeof(v) > end)
-            throw Exception("deserialize value failed, out of memery");
-        v = *reinterpret_cast<const t*>(begin);
-        return begin + sizeof(v);
+        out.insert(out.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
     }
 
-    template<typename t>
-    inline const uint8_t* default_deserialize(const uint8_t* begin, const uint8_t* end, t& v, Struct* p)
+    template<typename out_t>
+    inline void reserve_bytes(out_t& out, size_t size)
     {
-        return p->deserialize(begin, end);
+        out.reserve(size);
     }
 
-    template<typename t>
-    inline void serialize(ZnSerializeBuffer& out, const t& v)
+    inline void reserve_bytes(ZnSerializeBuffer& out, size_t size)
     {
-        default_serialize(out, v, static_cast<typename GetZnStructPtr<t>::Ptr>(const_cast<t*>(&v)));
+        out.reserve(out.size() + size);
     }
 
-    template<typename t>
-    inline const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, t& v)
+    inline uint16_t byte_swap(uint16_t v)
     {
-        return default_deserialize(begin, end, v, static_cast<typename GetZnStructPtr<t>::Ptr>(const_cast<t*>(&v)));
+        return static_cast<uint16_t>((v >> 8) | (v << 8));
     }
 
-    template<typename t>
-    inline void serialize(ZnSerializeBuffer& out, const std::shared_ptr<t>& v)
+    inline uint32_t byte_swap(uint32_t v)
     {
-        serialize(out, *v);
+#if defined(__GNUC__)
+        return __builtin_bswap32(v);
+#elif defined(_MSC_VER)
+        return _byteswap_ulong(v);
+#else
+        return (v >> 24) | ((v >> 8) & 0xFF00) | ((v << 8) & 0xFF0000) | (v << 24);
+#endif
     }
 
-    template<typename t>
-    inline const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, std::shared_ptr<t>& v)
+    inline uint64_t byte_swap(uint64_t v)
     {
-        if (!v)
-            v = std::make_shared<t>();
-        return deserialize(begin, end, *v);
+#if defined(__GNUC__)
+        return __builtin_bswap64(v);
+#elif defined(_MSC_VER)
+        return _byteswap_uint64(v);
+#else
+        return (static_cast<uint64_t>(byte_swap(static_cast<uint32_t>(v))) << 32) | byte_swap(static_cast<uint32_t>(v >> 32));
+#endif
     }
 
-    template<>
-    inline void serialize(ZnSerializeBuffer& out, const std::string& v)
+    template<size_t size> struct UnsignedOf;
+    template<> struct UnsignedOf<2> { typedef uint16_t type; };
+    template<> struct UnsignedOf<4> { typedef uint32_t type; };
+    template<> struct UnsignedOf<8> { typedef uint64_t type; };
+
+    // 原地交换count个size字节宽的值的字节序
+    // 宽度是编译期常量, 循环体只有读取, 交换, 写回, 编译器可以向量化为一次处理一整个向量寄存器
+    template<size_t size>
+    inline void swap_bytes(void* data, size_t count)
     {
-        uint32_t size = static_cast<uint32_t>(v.size());
-        out.insert(out.end(), reinterpret_cast<const uint8_t*>(&size), reinterpret_cast<const uint8_t*>(&size) + sizeof(size));
-        out.insert(out.end(), reinterpret_cast<const uint8_t*>(v.data()), reinterpret_cast<const uint8_t*>(v.data()) + size);
+        typedef typename UnsignedOf<size>::type unsigned_t;
+        auto p = static_cast<uint8_t*>(data);
+        for (size_t i = 0; i < count; ++i, p += size)
+        {
+            unsigned_t v;
+            memcpy(&v, p, size);
+            v = byte_swap(v);
+            memcpy(p, &v, size);
+        }
     }
 
-    template<>
-    inline const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, std::string& v)
-    {
-        if (begin + sizeof(uint32_t) > end)
-            throw Exception("deserialize string failed, out of memery");
-        auto p = begin;
-        uint32_t size = *reinterpret_cast<const uint32_t*>(p);
-        p += sizeof(uint32_t);
-        if (p + size > end)
-            throw Exception("deserialize string failed, out of memery");
-        v.assign(p, p + size);
-        return p + size;
+    // 交换count个t中每个标量的字节序
+    template<typename t>
+    inline void swap_items(t* data, size_t count)
+    {
+        typedef typename BulkScalar<t>::type scalar_t;
+        swap_bytes<sizeof(scalar_t)>(data, count * (sizeof(t) / sizeof(scalar_t)));
     }
 
-    template<>
-    inline void serialize(ZnSerializeBuffer& out, const std::wstring& v)
+    template<typename t>
+    inline void swap_bulk(t* data, size_t count, std::true_type)
     {
-        uint32_t size = static_cast<uint32_t>(v.size() * sizeof(wchar_t));
-        out.insert(out.end(), reinterpret_cast<const uint8_t*>(&size), reinterpret_cast<const uint8_t*>(&size) + sizeof(size));
-        out.insert(out.end(), reinterpret_cast<const uint8_t*>(v.data()), reinterpret_cast<const uint8_t*>(v.data()) + size);
+        swap_items(data, count);
     }
 
-    template<>
-    inline const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, std::wstring& v)
-    {
-        if (begin + sizeof(uint32_t) > end)
-            throw Exception("deserialize string failed, out of memery");
-        auto p = begin;
-        uint32_t size = *reinterpret_cast<const uint32_t*>(p);
-        p += sizeof(uint32_t);
-        if (p + size > end)
-            throw Exception("deserialize string failed, out of memery");
-        v.assign(reinterpret_cast<const wchar_t*>(p), reinterpret_cast<const wchar_t*>(p + size));
-        return p + size;
+    template<typename t>
+    inline void swap_bulk(t* data, size_t count, std::false_type)
+    {}
+
+    template<typename out_t, typename t>
+    inline void write_bulk(out_t& out, const t* v, size_t count, std::false_type)
+    {
+        write_bytes(out, v, count * sizeof(t));
     }
 
-    template<size_t i, typename...t>
-    struct ForeachTuple
+    // 需要交换字节序时按1KB分段拷贝到栈上, 交换后写入
+    template<typename out_t, typename t>
+    inline void write_bulk(out_t& out, const t* v, size_t count, std::true_type)
     {
-        void serialize(ZnSerializeBuffer& out, const std::tuple<t...>& tuple)
-        {
-            ForeachTuple<i-1, t...>().serialize(out, tuple);
-            zn_serialize::serialize(out, std::get<i>(tuple));
-        }
-        const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, std::tuple<t...>& tuple)
+        const size_t block = sizeof(t) < 1024 ? 1024 / sizeof(t) : 1;
+        t buffer[block];
+        while (count)
         {
-            auto p = ForeachTuple<i-1, t...>().deserialize(begin, end, tuple);
-            return zn_serialize::deserialize(p, end, std::get<i>(tuple));
+            size_t n = count < block ? count : block;
+            memcpy(buffer, v, n * sizeof(t));
+            swap_items(buffer, n);
+            write_bytes(out, buffer, n * sizeof(t));
+            v += n;
+            count -= n;
         }
-    };
+    }
 
-    template<typename...t>
-    struct ForeachTuple<0, t...>
+    // 整块写入count个连续的t, 按输出端的格式决定是否交换字节序
+    template<typename out_t, typename t>
+    inline void write_bulk(out_t& out, const t* v, size_t count)
     {
-        void serialize(ZnSerializeBuffer& out, const std::tuple<t...>& tuple)
-        {
-            zn_serialize::serialize(out, std::get<0>(tuple));
-        }
-        const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, std::tuple<t...>& tuple)
+        write_bulk(out, v, count, NeedSwap<typename SinkFormat<out_t>::type, t>());
+    }
+
+    template<typename out_t>
+    inline void write_varint(out_t& out, uint64_t v)
+    {
+        uint8_t bytes[10];
+        size_t size = 0;
+        while (v >= 0x80)
         {
-            return zn_serialize::deserialize(begin, end, std::get<0>(tuple));
+            bytes[size++] = static_cast<uint8_t>(v) | 0x80;
+            v >>= 7;
         }
-    };
+        bytes[size++] = static_cast<uint8_t>(v);
+        write_bytes(out, bytes, size);
+    }
 
-    template<typename...t>
-    inline void serialize(ZnSerializeBuffer& out, const std::tuple<t...>& v)
+    template<typename out_t>
+    inline void write_size(out_t& out, uint32_t size, const FixedFormat&)
     {
-        ForeachTuple<sizeof...(t)-1, t...>().serialize(out, v);
+        write_bytes(out, &size, sizeof(size));
     }
 
-    template<typename...t>
-    inline const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, std::tuple<t...>& v)
+    template<typename out_t>
+    inline void write_size(out_t& out, uint32_t size, const CompactFormat&)
     {
-        return ForeachTuple<sizeof...(t)-1, t...>().deserialize(begin, end, v);
+        write_varint(out, size);
     }
 
-    template<typename t, uint32_t s>
-    inline void serialize(ZnSerializeBuffer& out, const t(&v)[s])
+    template<typename out_t>
+    inline void write_size(out_t& out, uint32_t size, const PortableFormat&)
     {
-        for (uint32_t i = 0; i < s; ++i)
-            serialize(out, v[i]);
+        write_bulk(out, &size, 1, NeedSwap<PortableFormat, uint32_t>());
     }
 
-    template<typename t, uint32_t s>
-    inline const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, t(&v)[s])
+    template<typename out_t>
+    inline void write_size(out_t& out, uint32_t size)
     {
-        auto p = begin;
-        for (uint32_t i = 0; i < s; ++i)
-            p = deserialize(p, end, v[i]);
-        return p;
+        write_size(out, size, typename SinkFormat<out_t>::type());
     }
 
+    template<typename t, bool is_enum = std::is_enum<t>::value> struct IntegerOf { typedef t type; };
+    template<typename t> struct IntegerOf<t, true> { typedef typename std::underlying_type<t>::type type; };
 
-    template<>
-    inline void serialize(ZnSerializeBuffer& out, const Struct& v)
+    // 有符号整数先zigzag编码, 绝对值小的负数也只占很少的字节
+    template<typename t>
+    inline uint64_t to_varint(t v, std::true_type)
     {
-        const_cast<Struct&>(v).serialize(out);
+        return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(v) >> 63);
     }
 
-    template<>
-    inline const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, Struct& v)
+    template<typename t>
+    inline uint64_t to_varint(t v, std::false_type)
     {
-        return v.deserialize(begin, end);
+        return static_cast<uint64_t>(v);
     }
 
     template<typename t>
-    inline void serialize_container(ZnSerializeBuffer& out, const t& v)
+    inline t from_varint(uint64_t v, std::true_type)
     {
-        uint32_t size = static_cast<uint32_t>(v.size());
-        out.insert(out.end(), reinterpret_cast<const uint8_t*>(&size), reinterpret_cast<const uint8_t*>(&size) + sizeof(size));
-        for (const auto& i : v)
-            serialize(out, i);
+        return static_cast<t>(static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1));
     }
 
     template<typename t>
-    inline void serialize_map(ZnSerializeBuffer& out, const t& v)
+    inline t from_varint(uint64_t v, std::false_type)
     {
-        uint32_t size = static_cast<uint32_t>(v.size());
-        out.insert(out.end(), reinterpret_cast<const uint8_t*>(&size), reinterpret_cast<const uint8_t*>(&size) + sizeof(size));
-        for (const auto& i : v)
-        {
-            serialize(out, i.first);
-            serialize(out, i.second);
-        }
+        return static_cast<t>(v);
     }
 
-    template<typename t>
-    inline void serialize(ZnSerializeBuffer& out, const std::vector<t>& v) { serialize_container(out, v); }
-    template<typename t>
-    inline void serialize(ZnSerializeBuffer& out, const std::deque<t>& v) { serialize_container(out, v); }
-    template<typename t>
-    inline void serialize(ZnSerializeBuffer& out, const std::list<t>& v) { serialize_container(out, v); }
-    template<typename t>
-    inline void serialize(ZnSerializeBuffer& out, const std::set<t>& v) { serialize_container(out, v); }
-    template<typename t>
-    inline void serialize(ZnSerializeBuffer& out, const std::multiset<t>& v) { serialize_container(out, v); }
-    template<typename t>
-    inline void serialize(ZnSerializeBuffer& out, const std::stack<t>& v) { throw Exception("serialize failed, not allowed on statck"); }
-    template<typename t>
-    inline void serialize(ZnSerializeBuffer& out, const std::queue<t>& v) { throw Exception("serialize failed, not allowed on queue"); }
-    template<typename t>
-    inline void serialize(ZnSerializeBuffer& out, const std::priority_queue<t>& v) { throw Exception("serialize failed, not allowed on priority_queue"); }
-    template<typename k, typename t>
-    inline void serialize(ZnSerializeBuffer& out, const std::map<k, t>& v) { serialize_map(out, v); }
-    template<typename k, typename t>
-    inline void serialize(ZnSerializeBuffer& out, const std::multimap<k, t>& v) { serialize_map(out, v); }
+    template<typename out_t, typename t>
+    inline void write_compact(out_t& out, const t& v, std::true_type)
+    {
+        typedef typename IntegerOf<t>::type integer_t;
+        write_varint(out, to_varint(static_cast<integer_t>(v), std::is_signed<integer_t>()));
+    }
 
+    template<typename out_t, typename t>
+    inline void write_compact(out_t& out, const t& v, std::false_type)
+    {
+        write_bytes(out, &v, sizeof(v));
+    }
 
-    template<typename t>
-    inline const uint8_t* deserialize_container(const uint8_t* begin, const uint8_t* end, t& v)
+    template<typename out_t, typename t>
+    inline void write_value(out_t& out, const t& v, const FixedFormat&)
     {
-        if (begin + sizeof(uint32_t) > end)
-            throw Exception("deserialize container failed, out of memery");
-        auto p = begin;
-        uint32_t size = *reinterpret_cast<const uint32_t*>(p);
-        p += sizeof(uint32_t);
-        for (uint32_t i = 0; i < size; ++i)
-        {
-            typename t::value_type item;
-            p = deserialize(p, end, item);
-            v.push_back(item);
-        }
-        return p;
+        write_bytes(out, &v, sizeof(v));
     }
 
-    template<typename t>
-    inline const uint8_t* deserialize_set(const uint8_t* begin, const uint8_t* end, t& v)
+    template<typename out_t, typename t>
+    inline void write_value(out_t& out, const t& v, const CompactFormat&)
     {
-        if (begin + sizeof(uint32_t) > end)
-            throw Exception("deserialize set failed, out of memery");
-        auto p = begin;
-        uint32_t size = *reinterpret_cast<const uint32_t*>(p);
-        p += sizeof(uint32_t);
-        for (uint32_t i = 0; i < size; ++i)
-        {
-            typename t::value_type item;
-            p = deserialize(p, end, item);
-            v.insert(item);
-        }
-        return p;
+        write_compact(out, v, IsVarint<t>());
     }
 
-    template<typename t>
-    inline const uint8_t* deserialize_map(const uint8_t* begin, const uint8_t* end, t& v)
+    template<typename out_t, typename t>
+    inline void write_value(out_t& out, const t& v, const PortableFormat&)
     {
-        if (begin + sizeof(uint32_t) > end)
-            throw Exception("deserialize map failed, out of memery");
-        auto p = begin;
-        uint32_t size = *reinterpret_cast<const uint32_t*>(p);
-        p += sizeof(uint32_t);
-        for (uint32_t i = 0; i < size; ++i)
-        {
-            typename t::key_type key;
-            typename t::value_type::second_type item;
-            p = deserialize(p, end, key);
-            p = deserialize(p, end, item);
-            v.insert(std::make_pair(key, item));
-        }
-        return p;
+        write_bulk(out, &v, 1, NeedSwap<PortableFormat, t>());
     }
 
-    template<typename t>
-    inline const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, std::vector<t>& v) { return deserialize_container(begin, end, v); }
-    template<typename t>
-    inline const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, std::deque<t>& v) { return deserialize_container(begin, end, v); }
-    template<typename t>
-    inline const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, std::list<t>& v) { return deserialize_container(begin, end, v); }
-    template<typename t>
-    inline const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, std::set<t>& v) { return deserialize_set(begin, end, v); }
-    template<typename t>
-    inline const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, std::multiset<t>& v) { return deserialize_set(begin, end, v); }
-    template<typename t>
-    inline const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, std::stack<t>& v) { throw Exception("deserialize failed, not allowed on statck"); }
-    template<typename t>
-    inline const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, std::queue<t>& v) { throw Exception("deserialize failed, not allowed on queue"); }
-    template<typename t>
-    inline const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, std::priority_queue<t>& v) { throw Exception("deserialize failed, not allowed on priority_queue"); }
-    template<typename k, typename t>
-    inline const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, std::map<k, t>& v) { return deserialize_map(begin, end, v); }
-    template<typename k, typename t>
-    inline const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, std::multimap<k, t>& v) { return deserialize_map(begin, end, v); }
+    // 直接写入预先分配好的内存, 不做越界检查, 调用方需保证空间足够(由serialized_size计算)
+    class CursorSink
+    {
+    public:
+        explicit CursorSink(uint8_t* cursor)
+            : cursor_(cursor)
+        {}
+        void reserve(size_t size)
+        {}
+        void write(const void* data, size_t size)
+        {
+            memcpy(cursor_, data, size);
+            cursor_ += size;
+        }
+        uint8_t* cursor() const { return cursor_; }
+    private:
+        uint8_t* cursor_;
+    };
 
-    template<typename t, typename...args_t>
-    inline void serialize(ZnSerializeBuffer& out, const t& v, const args_t&...args)
+    // 固定容量的内存(如预先分配的发送缓冲区, 栈上数组, 共享内存), 空间不足时抛出异常
+    class SpanSink
     {
-        serialize(out, v);
-        serialize(out, args...);
-    }
+    public:
+        SpanSink(uint8_t* data, size_t capacity)
+            : begin_(data), cursor_(data), end_(data + capacity)
+        {}
+        void reserve(size_t size)
+        {
+            if (size > static_cast<size_t>(end_ - cursor_))
+                throw Exception("serialize failed, out of capacity");
+        }
+        void write(const void* data, size_t size)
+        {
+            reserve(size);
+            memcpy(cursor_, data, size);
+            cursor_ += size;
+        }
+        uint8_t* data() const { return begin_; }
+        size_t size() const { return static_cast<size_t>(cursor_ - begin_); }
+        size_t capacity() const { return static_cast<size_t>(end_ - begin_); }
+    private:
+        uint8_t* begin_;
+        uint8_t* cursor_;
+        uint8_t* end_;
+    };
 
-    template<typename t, typename...args_t>
-    inline const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, t& v, args_t&...args)
+    // 链式分块存储, 写满一块后追加新块而不搬移已写入的数据, 各块可直接组成iovec发送
+    class ChunkSink
     {
-        return deserialize(deserialize(begin, end, v), end, args...);
-    }
+    public:
+        explicit ChunkSink(size_t chunk_size = 4096)
+            : chunk_size_(chunk_size), size_(0)
+        {}
+        // 已写入的块不会搬移, 不需要预留
+        void reserve(size_t size)
+        {}
+        void write(const void* data, size_t size)
+        {
+            auto p = static_cast<const uint8_t*>(data);
+            size_ += size;
+            while (size)
+            {
+                if (chunks_.empty() || chunks_.back().size() == chunks_.back().capacity())
+                    add_chunk();
+                auto& chunk = chunks_.back();
+                size_t count = chunk.capacity() - chunk.size();
+                if (count > size)
+                    count = size;
+                chunk.insert(chunk.end(), p, p + count);
+                p += count;
+                size -= count;
+            }
+        }
+        const std::vector<ZnSerializeBuffer>& chunks() const { return chunks_; }
+        size_t size() const { return size_; }
+        void copy_to(ZnSerializeBuffer& out) const
+        {
+            out.reserve(out.size() + size_);
+            for (const auto& chunk : chunks_)
+                out.insert(out.end(), chunk.begin(), chunk.end());
+        }
+        void clear()
+        {
+            chunks_.clear();
+            size_ = 0;
+        }
+    private:
+        void add_chunk()
+        {
+            chunks_.push_back(ZnSerializeBuffer());
+            chunks_.back().reserve(chunk_size_);
+        }
+        size_t chunk_size_;
+        size_t size_;
+        std::vector<ZnSerializeBuffer> chunks_;
+    };
 
-    template<typename t, typename...args_t>
-    inline const uint8_t* deserialize(const ZnSerializeBuffer& in, t& v, args_t&...args)
+    // 为输出端指定编码格式, 如 FormatSink<CompactFormat, ZnSerializeBuffer>
+    template<typename format_t, typename sink_t>
+    class FormatSink
     {
-        auto end = in.data() + in.size();
-        return deserialize(deserialize(in.data(), end, v), end, args...);
-    }
+    public:
+        typedef format_t ZnFormat;
+        explicit FormatSink(sink_t& sink)
+            : sink_(sink)
+        {}
+        void reserve(size_t size)
+        {
+            reserve_bytes(sink_, size);
+        }
+        void write(const void* data, size_t size)
+        {
+            write_bytes(sink_, data, size);
+        }
+        sink_t& sink() const { return sink_; }
+    private:
+        sink_t& sink_;
+    };
 
-    template<typename t, typename...parents_t>
-    struct AutoAdaptBase : public Parent<t, parents_t...>
+    // 只统计写入的字节数, 用于得到变长格式编码后的长度
+    template<typename format_t = FixedFormat>
+    class CountSink
     {
-    protected:
-        template<typename ...args_t>
-        void auto_adapt_serialize(t* child, ZnSerializeBuffer& buffer, const args_t&...args)
+    public:
+        typedef format_t ZnFormat;
+        CountSink()
+            : size_(0)
+        {}
+        void reserve(size_t size)
+        {}
+        void write(const void* data, size_t size)
         {
-            Parent<t, parents_t...>::parent_pack_t::parent_serialize(child, buffer);
-            zn_serialize::serialize(buffer, args...);
+            size_ += size;
         }
-        void auto_adapt_serialize(t* child, ZnSerializeBuffer& buffer)
+        size_t size() const { return size_; }
+    private:
+        size_t size_;
+    };
+
+    // 每个类型唯一的地址, 引用跟踪时用来确认编号指向的对象类型相同
+    template<typename t> struct TypeId { static const char id; };
+    template<typename t> const char TypeId<t>::id = 0;
+
+    // 引用跟踪模式下shared_ptr的标记: 空指针, 首次出现(随后是完整的对象), 或SharedBackRef + 对象的编号
+    const uint32_t SharedNull = 0;
+    const uint32_t SharedNew = 1;
+    const uint32_t SharedBackRef = 2;
+
+    // 引用跟踪的输出端: 同一个对象被多个shared_ptr引用时只完整写入一次, 之后只写入它的编号, 见serialize_shared
+    template<typename sink_t>
+    class SharedSink
+    {
+    public:
+        typedef typename SinkFormat<sink_t>::type ZnFormat;
+        explicit SharedSink(sink_t& sink)
+            : sink_(sink), size_(0), next_(0)
+        {}
+        // 重复的对象不会写入, 按完整对象计算的长度偏大, 不预留
+        void reserve(size_t size)
+        {}
+        void write(const void* data, size_t size)
         {
-            Parent<t, parents_t...>::parent_pack_t::parent_serialize(child, buffer);
+            write_bytes(sink_, data, size);
+            size_ += size;
         }
-        template<typename ...args_t>
-        const uint8_t* auto_adapt_deserialize(t* child, const uint8_t* begin, const uint8_t* end, args_t&...args)
+        // 返回p的标记, 首次出现时分配编号; 同一地址以不同类型出现时作为新的对象
+        template<typename t>
+        uint32_t track(const t* p)
         {
-            auto p = Parent<t, parents_t...>::parent_pack_t::parent_deserialize(child, begin, end);
-            return zn_serialize::deserialize(p, end, args...);
+            if (!p)
+                return SharedNull;
+            auto it = ids_.find(p);
+            if (it != ids_.end() && it->second.type == &TypeId<t>::id)
+                return SharedBackRef + it->second.id;
+            if (next_ > 0xFFFFFFFF - SharedBackRef)
+                throw Exception("serialize failed, too many shared objects");
+            Entry entry = { next_++, &TypeId<t>::id };
+            if (it != ids_.end())
+                it->second = entry;
+            else
+                ids_.emplace(p, entry);
+            return SharedNew;
         }
-        const uint8_t* auto_adapt_deserialize(t* child, const uint8_t* begin, const uint8_t* end)
+        sink_t& sink() const { return sink_; }
+        size_t size() const { return size_; }
+    private:
+        struct Entry
+        {
+            uint32_t id;
+            const void* type;
+        };
+        sink_t& sink_;
+        size_t size_;
+        uint32_t next_;
+        std::unordered_map<const void*, Entry> ids_;
+    };
+
+    template<typename out_t> struct IsSharedSink : public std::false_type {};
+    template<typename sink_t> struct IsSharedSink<SharedSink<sink_t>> : public std::true_type {};
+
+    // 分块模式: 元素不能整块拷贝且元素数不少于ParallelThreshold的容器, 在元素数之后写入每ParallelBlockSize个元素编码后的字节数
+    const uint32_t ParallelThreshold = 4096;
+    const uint32_t ParallelBlockSize = 1024;
+
+    // 分块模式的输出端, 见serialize_parallel
+    template<typename sink_t>
+    class ParallelSink
+    {
+    public:
+        typedef typename SinkFormat<sink_t>::type ZnFormat;
+        explicit ParallelSink(sink_t& sink)
+            : sink_(sink), size_(0)
+        {}
+        // 按普通格式计算的长度不包括各容器的分块表, 不预留
+        void reserve(size_t size)
+        {}
+        void write(const void* data, size_t size)
         {
-            return Parent<t, parents_t...>::parent_pack_t::parent_deserialize(child, begin, end);
+            write_bytes(sink_, data, size);
+            size_ += size;
         }
+        sink_t& sink() const { return sink_; }
+        size_t size() const { return size_; }
+    private:
+        sink_t& sink_;
+        size_t size_;
     };
 
-    template<typename t>
-    struct AutoAdaptBase<t> : public Struct
+    template<typename out_t> struct IsParallelSink : public std::false_type {};
+    template<typename sink_t> struct IsParallelSink<ParallelSink<sink_t>> : public std::true_type {};
+
+    // 分块模式解码时使用的线程池: 把[0, count)分段后执行fn(begin, end), 全部完成后返回, 见WorkerPool
+    class ParallelRunner
     {
-    protected:
-        template<typename...args_t>
-        void auto_adapt_serialize(t* child, ZnSerializeBuffer& buffer, const args_t&...args)
+    public:
+        virtual ~ParallelRunner() {}
+        virtual void run(size_t count, const std::function<void(size_t, size_t)>& fn) = 0;
+    };
+
+    // 当前线程的内存池(见zn_serialize_arena.hpp), 内存池不是线程安全的, 设置了内存池时分块模式在调用线程上顺序解码
+    class Arena;
+    inline Arena*& current_arena()
+    {
+        static thread_local Arena* arena = nullptr;
+        return arena;
+    }
+
+    // 引用跟踪模式下已解码的对象, 按首次出现的顺序编号, 见deserialize_shared
+    class SharedTable
+    {
+    public:
+        template<typename t>
+        void add(const std::shared_ptr<t>& v)
         {
-            zn_serialize::serialize(buffer, args...);
+            objects_.push_back(Entry{ v, &TypeId<t>::id });
         }
-        template<typename...args_t>
-        const uint8_t* auto_adapt_deserialize(t* child, const uint8_t* begin, const uint8_t* end, args_t&...args)
+        template<typename t>
+        std::shared_ptr<t> get(uint32_t id) const
         {
-            return zn_serialize::deserialize(begin, end, args...);
+            if (id >= objects_.size())
+                throw Exception("deserialize shared_ptr failed, invalid reference");
+            if (objects_[id].type != &TypeId<t>::id)
+                throw Exception("deserialize shared_ptr failed, reference type mismatch");
+            return std::static_pointer_cast<t>(objects_[id].object);
         }
+        size_t size() const { return objects_.size(); }
+        void clear() { objects_.clear(); }
+    private:
+        struct Entry
+        {
+            std::shared_ptr<void> object;
+            const void* type;
+        };
+        std::vector<Entry> objects_;
+    };
+
+    // 反序列化的输入端, 从cursor读到end, 编码格式为format_t
+    // reuse为false时容器的内容追加到原有元素之后; 为true时复用模式, 见deserialize_reuse
+    // shared不为空时为引用跟踪模式, 见deserialize_shared
+    // blocks为true时为分块模式, parallel不为空时在它上面并行解码大容器的各块, 见deserialize_parallel
+    template<typename format_t = FixedFormat>
+    struct Reader
+    {
+        typedef format_t ZnFormat;
+        Reader(const uint8_t* begin, const uint8_t* end, bool reuse = false)
+            : cursor(begin), end(end), reuse(reuse), shared(nullptr), blocks(false), parallel(nullptr)
+        {}
+        explicit Reader(const ZnSerializeBuffer& buffer, bool reuse = false)
+            : cursor(buffer.data()), end(buffer.data() + buffer.size()), reuse(reuse), shared(nullptr), blocks(false), parallel(nullptr)
+        {}
+        size_t remain() const { return static_cast<size_t>(end - cursor); }
+        const uint8_t* cursor;
+        const uint8_t* end;
+        bool reuse;
+        SharedTable* shared;
+        bool blocks;
+        ParallelRunner* parallel;
+    };
+
+    // 跳过size个字节, 返回跳过部分的起始位置, 剩余字节不足时抛出异常
+    template<typename format_t>
+    inline const uint8_t* read_bytes(Reader<format_t>& in, size_t size, const char* error)
+    {
+        if (size > in.remain())
+            throw Exception(error);
+        auto p = in.cursor;
+        in.cursor += size;
+        return p;
+    }
+
+    // 性能统计: 全局定义 ZN_SERIALIZE_PROFILE 后按类型统计结构体与容器的编解码次数, 字节数, 元素数与耗时
+    // 各线程累加到自己的计数器, 互不竞争; profile_snapshot汇总所有线程(包括已退出的线程)的结果
+    // 未定义时ProfileScope为空类型, 编译后没有任何开销
+    struct ProfileStats
+    {
+        uint64_t count;
+        uint64_t bytes;
+        uint64_t elements;
+        uint64_t nanoseconds;
+    };
+
+    struct ProfileRecord
+    {
+        std::string name;
+        bool container;
+        ProfileStats serialize;
+        ProfileStats deserialize;
     };
 
+#ifdef ZN_SERIALIZE_PROFILE
+    // 单个线程的计数器, 只有所属线程写入; 新增类型时加锁, 以便汇总时安全地读取
+    class ProfileTable
+    {
+    public:
+        struct Counter
+        {
+            Counter() : count(0), bytes(0), elements(0), nanoseconds(0) {}
+            std::atomic<uint64_t> count;
+            std::atomic<uint64_t> bytes;
+            std::atomic<uint64_t> elements;
+            std::atomic<uint64_t> nanoseconds;
+        };
+        ProfileTable();
+        ~ProfileTable();
+        Counter& counter(size_t id, bool deserialize)
+        {
+            size_t index = id * 2 + (deserialize ? 1 : 0);
+            if (index >= counters_.size())
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                while (index >= counters_.size())
+                    counters_.emplace_back();
+            }
+            return counters_[index];
+        }
+        static ProfileTable& current()
+        {
+            static thread_local ProfileTable table;
+            return table;
+        }
+    private:
+        friend class ProfileRegistry;
+        std::mutex mutex_;
+        std::deque<Counter> counters_;
+    };
+
+    class ProfileRegistry
+    {
+    public:
+        static ProfileRegistry& instance()
+        {
+            static ProfileRegistry registry;
+            return registry;
+        }
+        size_t add_type(const char* name, bool container)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ProfileRecord record = ProfileRecord();
+            record.name = demangle(name);
+            record.container = container;
+            records_.push_back(record);
+            return records_.size() - 1;
+        }
+        void attach(ProfileTable* table)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tables_.push_back(table);
+        }
+        // 线程退出时把计数并入records_
+        void detach(ProfileTable* table)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            collect(*table, records_);
+            for (size_t i = 0; i < tables_.size(); ++i)
+            {
+                if (tables_[i] == table)
+                {
+                    tables_.erase(tables_.begin() + i);
+                    break;
+                }
+            }
+        }
+        std::vector<ProfileRecord> snapshot()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto records = records_;
+            for (auto table : tables_)
+                collect(*table, records);
+            return records;
+        }
+        void reset()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& record : records_)
+                record.serialize = record.deserialize = ProfileStats();
+            for (auto table : tables_)
+            {
+                std::lock_guard<std::mutex> table_lock(table->mutex_);
+                for (auto& counter : table->counters_)
+                {
+                    counter.count = 0;
+                    counter.bytes = 0;
+                    counter.elements = 0;
+                    counter.nanoseconds = 0;
+                }
+            }
+        }
+    private:
+        static void collect(ProfileTable& table, std::vector<ProfileRecord>& records)
+        {
+            std::lock_guard<std::mutex> lock(table.mutex_);
+            for (size_t i = 0; i < table.counters_.size() && i / 2 < records.size(); ++i)
+            {
+                auto& counter = table.counters_[i];
+                auto& stats = i % 2 ? records[i / 2].deserialize : records[i / 2].serialize;
+                stats.count += counter.count.load(std::memory_order_relaxed);
+                stats.bytes += counter.bytes.load(std::memory_order_relaxed);
+                stats.elements += counter.elements.load(std::memory_order_relaxed);
+                stats.nanoseconds += counter.nanoseconds.load(std::memory_order_relaxed);
+            }
+        }
+        static std::string demangle(const char* name)
+        {
+#if defined(__GNUG__)
+            int status = 0;
+            char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+            if (status == 0 && demangled)
+            {
+                std::string result(demangled);
+                free(demangled);
+                return result;
+            }
+#endif
+            return name;
+        }
+        std::mutex mutex_;
+        std::vector<ProfileTable*> tables_;
+        std::vector<ProfileRecord> records_;
+    };
+
+    inline ProfileTable::ProfileTable()
+    {
+        ProfileRegistry::instance().attach(this);
+    }
+
+    inline ProfileTable::~ProfileTable()
+    {
+        ProfileRegistry::instance().detach(this);
+    }
+
+    template<typename t>
+    inline size_t profile_id()
+    {
+        static const size_t id = ProfileRegistry::instance().add_type(typeid(t).name(), !IsZnStruct<t>::value);
+        return id;
+    }
+
+    // 输出端与输入端的当前位置, 两次之差即为写入或读取的字节数; 无法得到位置的输出端不统计字节数
+    template<typename out_t>
+    inline auto profile_position(const out_t& out, int) -> decltype(static_cast<uint64_t>(out.size()))
+    {
+        return static_cast<uint64_t>(out.size());
+    }
+    template<typename out_t>
+    inline uint64_t profile_position(const out_t& out, double)
+    {
+        return 0;
+    }
+    template<typename out_t>
+    inline uint64_t profile_position(const out_t& out)
+    {
+        return profile_position(out, 0);
+    }
+    inline uint64_t profile_position(const CursorSink& out)
+    {
+        return reinterpret_cast<uintptr_t>(out.cursor());
+    }
+    template<typename format_t, typename sink_t>
+    inline uint64_t profile_position(const FormatSink<format_t, sink_t>& out)
+    {
+        return profile_position(out.sink());
+    }
+    template<typename format_t>
+    inline uint64_t profile_position(const Reader<format_t>& in)
+    {
+        return reinterpret_cast<uintptr_t>(in.cursor);
+    }
+
+    template<typename io_t> struct IsReader : public std::false_type {};
+    template<typename format_t> struct IsReader<Reader<format_t>> : public std::true_type {};
+
+    // 统计一次结构体或容器的编解码, io_t为输出端或输入端, 析构时累加到当前线程的计数器
+    // 容器编码的元素数为容器的大小; 解码的元素数在复用模式下为解码后的大小, 否则为新增的元素数
+    template<typename t, typename io_t>
+    class ProfileScope
+    {
+    public:
+        explicit ProfileScope(const io_t& io)
+            : io_(io), container_(nullptr), size_(nullptr), elements_(0)
+        {
+            start();
+        }
+        ProfileScope(const io_t& io, const t& v)
+            : io_(io), container_(&v), size_(&ProfileScope::size_of), elements_(reuse(io) ? 0 : v.size())
+        {
+            start();
+        }
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+        ~ProfileScope()
+        {
+            auto stop = std::chrono::steady_clock::now();
+            auto& counter = ProfileTable::current().counter(profile_id<t>(), IsReader<io_t>::value);
+            counter.count.fetch_add(1, std::memory_order_relaxed);
+            counter.bytes.fetch_add(profile_position(io_) - begin_, std::memory_order_relaxed);
+            counter.elements.fetch_add(IsReader<io_t>::value && container_ ? size_(*container_) - elements_ : elements_, std::memory_order_relaxed);
+            counter.nanoseconds.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start_).count()), std::memory_order_relaxed);
+        }
+    private:
+        template<typename format_t>
+        static bool reuse(const Reader<format_t>& in) { return in.reuse; }
+        template<typename out_t>
+        static bool reuse(const out_t& out) { return false; }
+        // 只在容器的构造函数中取地址, 结构体不需要size()
+        static uint64_t size_of(const t& v) { return v.size(); }
+        void start()
+        {
+            begin_ = profile_position(io_);
+            start_ = std::chrono::steady_clock::now();
+        }
+        const io_t& io_;
+        const t* container_;
+        uint64_t (*size_)(const t&);
+        uint64_t elements_;
+        uint64_t begin_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    inline std::vector<ProfileRecord> profile_snapshot()
+    {
+        return ProfileRegistry::instance().snapshot();
+    }
+
+    inline void profile_reset()
+    {
+        ProfileRegistry::instance().reset();
+    }
+#else
+    template<typename t, typename io_t>
+    class ProfileScope
+    {
+    public:
+        explicit ProfileScope(const io_t&) {}
+        ProfileScope(const io_t&, const t&) {}
+    };
+
+    inline std::vector<ProfileRecord> profile_snapshot()
+    {
+        return std::vector<ProfileRecord>();
+    }
+
+    inline void profile_reset()
+    {}
+#endif
+
+    // 一个和两个字节是最常见的情况, 单独处理
+    template<typename format_t>
+    inline uint64_t read_varint(Reader<format_t>& in, const char* error)
+    {
+        auto p = in.cursor;
+        if (p != in.end && *p < 0x80)
+        {
+            in.cursor = p + 1;
+            return *p;
+        }
+        if (in.end - p >= 2 && p[1] < 0x80)
+        {
+            in.cursor = p + 2;
+            return (p[0] & 0x7F) | (static_cast<uint64_t>(p[1]) << 7);
+        }
+        uint64_t v = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7)
+        {
+            if (p == in.end)
+                throw Exception(error);
+            uint8_t byte = *p++;
+            v |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (byte < 0x80)
+            {
+                in.cursor = p;
+                return v;
+            }
+        }
+        throw Exception("deserialize varint failed, too long");
+    }
+
+    template<typename format_t>
+    inline uint32_t read_size(Reader<format_t>& in, const char* error, const FixedFormat&)
+    {
+        return *reinterpret_cast<const uint32_t*>(read_bytes(in, sizeof(uint32_t), error));
+    }
+
+    template<typename format_t>
+    inline uint32_t read_size(Reader<format_t>& in, const char* error, const CompactFormat&)
+    {
+        uint64_t size = read_varint(in, error);
+        if (size > 0xFFFFFFFF)
+            throw Exception(error);
+        return static_cast<uint32_t>(size);
+    }
+
+    template<typename format_t>
+    inline uint32_t read_size(Reader<format_t>& in, const char* error, const PortableFormat&)
+    {
+        uint32_t size;
+        memcpy(&size, read_bytes(in, sizeof(uint32_t), error), sizeof(size));
+        swap_bulk(&size, 1, NeedSwap<PortableFormat, uint32_t>());
+        return size;
+    }
+
+    template<typename format_t>
+    inline uint32_t read_size(Reader<format_t>& in, const char* error)
+    {
+        return read_size(in, error, format_t());
+    }
+
+    template<typename format_t, typename t>
+    inline void read_compact(Reader<format_t>& in, t& v, std::true_type)
+    {
+        typedef typename IntegerOf<t>::type integer_t;
+        uint64_t value = read_varint(in, "deserialize value failed, out of memery");
+        if (value > static_cast<uint64_t>(std::numeric_limits<typename std::make_unsigned<integer_t>::type>::max()))
+            throw Exception("deserialize value failed, varint out of range");
+        v = static_cast<t>(from_varint<integer_t>(value, std::is_signed<integer_t>()));
+    }
+
+    template<typename format_t, typename t>
+    inline void read_compact(Reader<format_t>& in, t& v, std::false_type)
+    {
+        v = *reinterpret_cast<const t*>(read_bytes(in, sizeof(v), "deserialize value failed, out of memery"));
+    }
+
+    template<typename format_t, typename t>
+    inline void read_value(Reader<format_t>& in, t& v, const FixedFormat&)
+    {
+        v = *reinterpret_cast<const t*>(read_bytes(in, sizeof(v), "deserialize value failed, out of memery"));
+    }
+
+    template<typename format_t, typename t>
+    inline void read_value(Reader<format_t>& in, t& v, const CompactFormat&)
+    {
+        read_compact(in, v, IsVarint<t>());
+    }
+
+    template<typename format_t, typename t>
+    inline void read_value(Reader<format_t>& in, t& v, const PortableFormat&)
+    {
+        memcpy(&v, read_bytes(in, sizeof(v), "deserialize value failed, out of memery"), sizeof(v));
+        swap_bulk(&v, 1, NeedSwap<PortableFormat, t>());
+    }
+
+    // 整块读取count个连续的t, 调用方已检查剩余的字节数, 按输入端的格式决定是否交换字节序
+    template<typename format_t, typename t>
+    inline void read_bulk(Reader<format_t>& in, t* v, size_t count)
+    {
+        memcpy(v, in.cursor, count * sizeof(t));
+        in.cursor += count * sizeof(t);
+        swap_bulk(v, count, NeedSwap<format_t, t>());
+    }
+
+    template<typename t>
+    inline size_t default_serialized_size(const t& v, t* p)
+    {
+        return sizeof(v);
+    }
+
+    template<typename t>
+    inline size_t default_serialized_size(const t& v, Struct* p)
+    {
+        return v.t::serialized_size();
+    }
+
+    template<typename out_t, typename t>
+    inline void default_serialize(out_t& out, const t& v, t* p)
+    {
+        write_value(out, v, typename SinkFormat<out_t>::type());
+    }
+
+    template<typename out_t, typename t>
+    inline void default_serialize(out_t& out, const t& v, Struct* p)
+    {
+        v.serialize_to(out);
+    }
+
+    template<typename format_t, typename t>
+    inline void default_deserialize(Reader<format_t>& in, t& v, t* p)
+    {
+        read_value(in, v, format_t());
+    }
+
+    template<typename format_t, typename t>
+    inline void default_deserialize(Reader<format_t>& in, t& v, Struct* p)
+    {
+        v.t::deserialize_from(in);
+    }
+
+    // serialized_size按默认格式(FixedFormat)计算, 变长格式的长度可以写入CountSink得到
+    template<typename t>
+    inline size_t serialized_size(const t& v)
+    {
+        return default_serialized_size(v, static_cast<typename GetZnStructPtr<t>::Ptr>(nullptr));
+    }
+
+    template<typename out_t, typename t>
+    inline void serialize(out_t& out, const t& v)
+    {
+        default_serialize(out, v, static_cast<typename GetZnStructPtr<t>::Ptr>(nullptr));
+    }
+
+    template<typename format_t, typename t>
+    inline void deserialize(Reader<format_t>& in, t& v)
+    {
+        default_deserialize(in, v, static_cast<typename GetZnStructPtr<t>::Ptr>(nullptr));
+    }
+
+    template<typename t>
+    inline const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, t& v)
+    {
+        Reader<> in(begin, end);
+        deserialize(in, v);
+        return in.cursor;
+    }
+
+    // 字符串与容器支持自定义的分配器(如zn_serialize_arena.hpp中的ArenaAllocator)
+    template<typename tr, typename a>
+    inline size_t serialized_size(const std::basic_string<char, tr, a>& v)
+    {
+        return sizeof(uint32_t) + v.size();
+    }
+
+    template<typename out_t, typename tr, typename a>
+    inline void serialize(out_t& out, const std::basic_string<char, tr, a>& v)
+    {
+        uint32_t size = static_cast<uint32_t>(v.size());
+        write_size(out, size);
+        write_bytes(out, v.data(), size);
+    }
+
+    template<typename format_t, typename tr, typename a>
+    inline void deserialize(Reader<format_t>& in, std::basic_string<char, tr, a>& v)
+    {
+        uint32_t size = read_size(in, "deserialize string failed, out of memery");
+        auto p = read_bytes(in, size, "deserialize string failed, out of memery");
+        v.assign(p, p + size);
+    }
+
+    template<typename tr, typename a>
+    inline size_t serialized_size(const std::basic_string<wchar_t, tr, a>& v)
+    {
+        return sizeof(uint32_t) + v.size() * sizeof(wchar_t);
+    }
+
+    // 默认格式与紧凑格式按wchar_t原样写入, 宽度随平台不同(Windows为2字节, Linux为4字节)
+    template<typename out_t, typename tr, typename a, typename format_t>
+    inline void serialize_wide(out_t& out, const std::basic_string<wchar_t, tr, a>& v, const format_t&)
+    {
+        uint32_t size = static_cast<uint32_t>(v.size() * sizeof(wchar_t));
+        write_size(out, size);
+        write_bytes(out, v.data(), size);
+    }
+
+    template<typename out_t, typename tr, typename a>
+    inline void serialize_utf16(out_t& out, const std::basic_string<wchar_t, tr, a>& v, std::true_type)
+    {
+        write_size(out, static_cast<uint32_t>(v.size() * sizeof(uint16_t)));
+        write_bulk(out, reinterpret_cast<const uint16_t*>(v.data()), v.size());
+    }
+
+    // 4字节的wchar_t为UTF-32, 超出基本平面的字符写为代理对
+    template<typename out_t, typename tr, typename a>
+    inline void serialize_utf16(out_t& out, const std::basic_string<wchar_t, tr, a>& v, std::false_type)
+    {
+        size_t units = v.size();
+        for (auto c : v)
+        {
+            uint32_t code = static_cast<uint32_t>(c);
+            if (code > 0x10FFFF)
+                throw Exception("serialize wstring failed, invalid character");
+            if (code > 0xFFFF)
+                ++units;
+        }
+        if (units > 0x7FFFFFFF)
+            throw Exception("serialize wstring failed, too long");
+        write_size(out, static_cast<uint32_t>(units * sizeof(uint16_t)));
+        uint16_t buffer[256];
+        size_t n = 0;
+        for (auto c : v)
+        {
+            if (n + 2 > 256)
+            {
+                write_bulk(out, buffer, n);
+                n = 0;
+            }
+            uint32_t code = static_cast<uint32_t>(c);
+            if (code > 0xFFFF)
+            {
+                code -= 0x10000;
+                buffer[n++] = static_cast<uint16_t>(0xD800 | (code >> 10));
+                buffer[n++] = static_cast<uint16_t>(0xDC00 | (code & 0x3FF));
+            }
+            else
+                buffer[n++] = static_cast<uint16_t>(code);
+        }
+        if (n)
+            write_bulk(out, buffer, n);
+    }
+
+    template<typename out_t, typename tr, typename a>
+    inline void serialize_wide(out_t& out, const std::basic_string<wchar_t, tr, a>& v, const PortableFormat&)
+    {
+        serialize_utf16(out, v, std::integral_constant<bool, sizeof(wchar_t) == sizeof(uint16_t)>());
+    }
+
+    template<typename out_t, typename tr, typename a>
+    inline void serialize(out_t& out, const std::basic_string<wchar_t, tr, a>& v)
+    {
+        serialize_wide(out, v, typename SinkFormat<out_t>::type());
+    }
+
+    template<typename format_t, typename tr, typename a, typename tag_t>
+    inline void deserialize_wide(Reader<format_t>& in, std::basic_string<wchar_t, tr, a>& v, const tag_t&)
+    {
+        uint32_t size = read_size(in, "deserialize string failed, out of memery");
+        auto p = read_bytes(in, size, "deserialize string failed, out of memery");
+        v.assign(reinterpret_cast<const wchar_t*>(p), reinterpret_cast<const wchar_t*>(p + size));
+    }
+
+    template<typename tr, typename a>
+    inline void deserialize_utf16(const uint8_t* p, size_t units, std::basic_string<wchar_t, tr, a>& v, std::true_type)
+    {
+        v.resize(units);
+        if (units)
+        {
+            memcpy(&v[0], p, units * sizeof(uint16_t));
+            swap_bulk(reinterpret_cast<uint16_t*>(&v[0]), units, NeedSwap<PortableFormat, uint16_t>());
+        }
+    }
+
+    inline uint16_t load_utf16(const uint8_t* p)
+    {
+        uint16_t unit;
+        memcpy(&unit, p, sizeof(unit));
+        swap_bulk(&unit, 1, NeedSwap<PortableFormat, uint16_t>());
+        return unit;
+    }
+
+    // 代理对合并为一个字符, 不成对的代理原样保留
+    template<typename tr, typename a>
+    inline void deserialize_utf16(const uint8_t* p, size_t units, std::basic_string<wchar_t, tr, a>& v, std::false_type)
+    {
+        v.clear();
+        v.reserve(units);
+        for (size_t i = 0; i < units; ++i)
+        {
+            uint32_t code = load_utf16(p + i * sizeof(uint16_t));
+            if (code >= 0xD800 && code < 0xDC00 && i + 1 < units)
+            {
+                uint32_t low = load_utf16(p + (i + 1) * sizeof(uint16_t));
+                if (low >= 0xDC00 && low < 0xE000)
+                {
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    ++i;
+                }
+            }
+            v.push_back(static_cast<wchar_t>(code));
+        }
+    }
+
+    template<typename format_t, typename tr, typename a>
+    inline void deserialize_wide(Reader<format_t>& in, std::basic_string<wchar_t, tr, a>& v, const PortableFormat&)
+    {
+        uint32_t size = read_size(in, "deserialize string failed, out of memery");
+        if (size % sizeof(uint16_t))
+            throw Exception("deserialize string failed, bad utf16 size");
+        auto p = read_bytes(in, size, "deserialize string failed, out of memery");
+        deserialize_utf16(p, size / sizeof(uint16_t), v, std::integral_constant<bool, sizeof(wchar_t) == sizeof(uint16_t)>());
+    }
+
+    template<typename format_t, typename tr, typename a>
+    inline void deserialize(Reader<format_t>& in, std::basic_string<wchar_t, tr, a>& v)
+    {
+        deserialize_wide(in, v, format_t());
+    }
+
+    template<typename t>
+    inline size_t serialized_size(const std::shared_ptr<t>& v)
+    {
+        return serialized_size(*v);
+    }
+
+    template<typename out_t, typename t>
+    inline void serialize_pointer(out_t& out, const std::shared_ptr<t>& v, std::false_type)
+    {
+        serialize(out, *v);
+    }
+
+    // 先登记再写入对象, 对象内部再引用自己时写入的是编号
+    template<typename out_t, typename t>
+    inline void serialize_pointer(out_t& out, const std::shared_ptr<t>& v, std::true_type)
+    {
+        uint32_t ref = out.track(v.get());
+        write_size(out, ref);
+        if (ref == SharedNew)
+            serialize(out, *v);
+    }
+
+    template<typename out_t, typename t>
+    inline void serialize(out_t& out, const std::shared_ptr<t>& v)
+    {
+        serialize_pointer(out, v, IsSharedSink<out_t>());
+    }
+
+    // 每个对象只在首次出现时分配一次, 之后的引用共享同一个对象
+    template<typename format_t, typename t>
+    inline void deserialize_pointer(Reader<format_t>& in, std::shared_ptr<t>& v)
+    {
+        uint32_t ref = read_size(in, "deserialize shared_ptr failed, out of memery");
+        if (ref == SharedNull)
+            v.reset();
+        else if (ref != SharedNew)
+            v = in.shared->template get<t>(ref - SharedBackRef);
+        else
+        {
+            v = std::make_shared<t>();
+            in.shared->add(v);
+            deserialize(in, *v);
+        }
+    }
+
+    template<typename format_t, typename t>
+    inline void deserialize(Reader<format_t>& in, std::shared_ptr<t>& v)
+    {
+        if (in.shared)
+            return deserialize_pointer(in, v);
+        if (!v)
+            v = std::make_shared<t>();
+        deserialize(in, *v);
+    }
+
+    // 字符串视图, 与std::string的序列化格式相同
+    // 反序列化时直接指向输入的字节流, 不分配内存, 使用期间输入的字节流必须有效
+    class StringView
+    {
+    public:
+        StringView()
+            : data_(nullptr), size_(0)
+        {}
+        StringView(const char* data, size_t size)
+            : data_(data), size_(size)
+        {}
+        StringView(const char* data)
+            : data_(data), size_(strlen(data))
+        {}
+        StringView(const std::string& v)
+            : data_(v.data()), size_(v.size())
+        {}
+        const char* data() const { return data_; }
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+        char operator[](size_t i) const { return data_[i]; }
+        const char* begin() const { return data_; }
+        const char* end() const { return data_ + size_; }
+        std::string str() const { return std::string(data_, size_); }
+        bool operator==(const StringView& o) const { return size_ == o.size_ && (size_ == 0 || memcmp(data_, o.data_, size_) == 0); }
+        bool operator!=(const StringView& o) const { return !(*this == o); }
+    private:
+        const char* data_;
+        size_t size_;
+    };
+
+    // 平凡类型的数组视图, 与std::vector<t>的序列化格式相同
+    // 反序列化时直接指向输入的字节流, 不分配内存, 使用期间输入的字节流必须有效
+    // 字节流中的元素不一定按t对齐, operator[]总是按字节读取, data()只在对齐时可用
+    template<typename t>
+    class ArrayView
+    {
+        static_assert(std::is_trivially_copyable<t>::value, "ArrayView only supports trivially copyable types");
+    public:
+        ArrayView()
+            : data_(nullptr), size_(0)
+        {}
+        ArrayView(const t* data, size_t size)
+            : data_(reinterpret_cast<const uint8_t*>(data)), size_(size)
+        {}
+        ArrayView(const std::vector<t>& v)
+            : data_(reinterpret_cast<const uint8_t*>(v.data())), size_(v.size())
+        {}
+        static ArrayView from_bytes(const uint8_t* data, size_t size)
+        {
+            ArrayView view;
+            view.data_ = data;
+            view.size_ = size;
+            return view;
+        }
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+        const uint8_t* bytes() const { return data_; }
+        bool aligned() const { return reinterpret_cast<uintptr_t>(data_) % std::alignment_of<t>::value == 0; }
+        const t* data() const { return aligned() ? reinterpret_cast<const t*>(data_) : nullptr; }
+        t operator[](size_t i) const
+        {
+            t v;
+            memcpy(&v, data_ + i * sizeof(t), sizeof(t));
+            return v;
+        }
+        void copy_to(std::vector<t>& out) const
+        {
+            out.resize(size_);
+            if (size_)
+                memcpy(out.data(), data_, size_ * sizeof(t));
+        }
+    private:
+        const uint8_t* data_;
+        size_t size_;
+    };
+
+    template<>
+    inline size_t serialized_size(const StringView& v)
+    {
+        return sizeof(uint32_t) + v.size();
+    }
+
+    template<typename out_t>
+    inline void serialize(out_t& out, const StringView& v)
+    {
+        uint32_t size = static_cast<uint32_t>(v.size());
+        write_size(out, size);
+        write_bytes(out, v.data(), size);
+    }
+
+    template<typename format_t>
+    inline void deserialize(Reader<format_t>& in, StringView& v)
+    {
+        uint32_t size = read_size(in, "deserialize string failed, out of memery");
+        auto p = read_bytes(in, size, "deserialize string failed, out of memery");
+        v = StringView(reinterpret_cast<const char*>(p), size);
+    }
+
+    template<typename t>
+    inline size_t serialized_size(const ArrayView<t>& v)
+    {
+        return sizeof(uint32_t) + v.size() * sizeof(t);
+    }
+
+    template<typename out_t, typename t>
+    inline void serialize(out_t& out, const ArrayView<t>& v)
+    {
+        static_assert(IsBulkFor<typename SinkFormat<out_t>::type, t>::value && !NeedSwap<typename SinkFormat<out_t>::type, t>::value, "ArrayView elements must be stored as is in this format");
+        write_size(out, static_cast<uint32_t>(v.size()));
+        if (!v.empty())
+            write_bytes(out, v.bytes(), v.size() * sizeof(t));
+    }
+
+    template<typename format_t, typename t>
+    inline void deserialize(Reader<format_t>& in, ArrayView<t>& v)
+    {
+        static_assert(IsBulkFor<format_t, t>::value && !NeedSwap<format_t, t>::value, "ArrayView elements must be stored as is in this format");
+        uint32_t size = read_size(in, "deserialize array view failed, out of memery");
+        if (size > in.remain() / sizeof(t))
+            throw Exception("deserialize array view failed, out of memery");
+        v = ArrayView<t>::from_bytes(read_bytes(in, size * sizeof(t), "deserialize array view failed, out of memery"), size);
+    }
+
+    template<size_t i, typename...t>
+    struct ForeachTuple
+    {
+        size_t serialized_size(const std::tuple<t...>& tuple)
+        {
+            return ForeachTuple<i-1, t...>().serialized_size(tuple) + zn_serialize::serialized_size(std::get<i>(tuple));
+        }
+        template<typename out_t>
+        void serialize(out_t& out, const std::tuple<t...>& tuple)
+        {
+            ForeachTuple<i-1, t...>().serialize(out, tuple);
+            zn_serialize::serialize(out, std::get<i>(tuple));
+        }
+        template<typename format_t>
+        void deserialize(Reader<format_t>& in, std::tuple<t...>& tuple)
+        {
+            ForeachTuple<i-1, t...>().deserialize(in, tuple);
+            zn_serialize::deserialize(in, std::get<i>(tuple));
+        }
+    };
+
+    template<typename...t>
+    struct ForeachTuple<0, t...>
+    {
+        size_t serialized_size(const std::tuple<t...>& tuple)
+        {
+            return zn_serialize::serialized_size(std::get<0>(tuple));
+        }
+        template<typename out_t>
+        void serialize(out_t& out, const std::tuple<t...>& tuple)
+        {
+            zn_serialize::serialize(out, std::get<0>(tuple));
+        }
+        template<typename format_t>
+        void deserialize(Reader<format_t>& in, std::tuple<t...>& tuple)
+        {
+            zn_serialize::deserialize(in, std::get<0>(tuple));
+        }
+    };
+
+    template<typename...t>
+    inline size_t serialized_size(const std::tuple<t...>& v)
+    {
+        return ForeachTuple<sizeof...(t)-1, t...>().serialized_size(v);
+    }
+
+    template<typename out_t, typename...t>
+    inline void serialize(out_t& out, const std::tuple<t...>& v)
+    {
+        ForeachTuple<sizeof...(t)-1, t...>().serialize(out, v);
+    }
+
+    template<typename format_t, typename...t>
+    inline void deserialize(Reader<format_t>& in, std::tuple<t...>& v)
+    {
+        ForeachTuple<sizeof...(t)-1, t...>().deserialize(in, v);
+    }
+
+    template<typename t>
+    inline size_t serialized_size_array(const t* v, size_t s, std::true_type)
+    {
+        return s * sizeof(t);
+    }
+
+    template<typename t>
+    inline size_t serialized_size_array(const t* v, size_t s, std::false_type)
+    {
+        size_t size = 0;
+        for (size_t i = 0; i < s; ++i)
+            size += serialized_size(v[i]);
+        return size;
+    }
+
+    template<typename out_t, typename t>
+    inline void serialize_array(out_t& out, const t* v, size_t s, std::true_type)
+    {
+        write_bulk(out, v, s);
+    }
+
+    template<typename out_t, typename t>
+    inline void serialize_array(out_t& out, const t* v, size_t s, std::false_type)
+    {
+        for (size_t i = 0; i < s; ++i)
+            serialize(out, v[i]);
+    }
+
+    template<typename format_t, typename t>
+    inline void deserialize_array(Reader<format_t>& in, t* v, size_t s, std::true_type)
+    {
+        if (s > in.remain() / sizeof(t))
+            throw Exception("deserialize array failed, out of memery");
+        read_bulk(in, v, s);
+    }
+
+    template<typename format_t, typename t>
+    inline void deserialize_array(Reader<format_t>& in, t* v, size_t s, std::false_type)
+    {
+        for (size_t i = 0; i < s; ++i)
+            deserialize(in, v[i]);
+    }
+
+    template<typename t, uint32_t s>
+    inline size_t serialized_size(const t(&v)[s]) { return serialized_size_array(v, s, IsBulk<t>()); }
+    template<typename out_t, typename t, uint32_t s>
+    inline void serialize(out_t& out, const t(&v)[s]) { serialize_array(out, v, s, IsBulkFor<typename SinkFormat<out_t>::type, t>()); }
+    template<typename format_t, typename t, uint32_t s>
+    inline void deserialize(Reader<format_t>& in, t(&v)[s]) { deserialize_array(in, v, s, IsBulkFor<format_t, t>()); }
+
+    template<typename t, size_t s>
+    inline size_t serialized_size(const std::array<t, s>& v) { return serialized_size_array(v.data(), s, IsBulk<t>()); }
+    template<typename out_t, typename t, size_t s>
+    inline void serialize(out_t& out, const std::array<t, s>& v) { serialize_array(out, v.data(), s, IsBulkFor<typename SinkFormat<out_t>::type, t>()); }
+    template<typename format_t, typename t, size_t s>
+    inline void deserialize(Reader<format_t>& in, std::array<t, s>& v) { deserialize_array(in, v.data(), s, IsBulkFor<format_t, t>()); }
+
+    template<>
+    inline size_t serialized_size(const Struct& v)
+    {
+        return v.serialized_size();
+    }
+
+    // 只知道基类时无法确定输出端类型, 按结构体自身的格式先序列化到临时缓冲区再写入
+    template<typename out_t>
+    inline void serialize(out_t& out, const Struct& v)
+    {
+        ZnSerializeBuffer buffer;
+        v.serialize(buffer);
+        write_bytes(out, buffer.data(), buffer.size());
+    }
+
+    inline void serialize(ZnSerializeBuffer& out, const Struct& v)
+    {
+        v.serialize(out);
+    }
+
+    template<typename format_t>
+    inline void deserialize(Reader<format_t>& in, Struct& v)
+    {
+        in.cursor = v.deserialize(in.cursor, in.end);
+    }
+
+    template<typename t>
+    inline size_t serialized_size_container(const t& v, std::true_type)
+    {
+        return sizeof(uint32_t) + v.size() * sizeof(typename t::value_type);
+    }
+
+    template<typename t>
+    inline size_t serialized_size_container(const t& v, std::false_type)
+    {
+        size_t size = sizeof(uint32_t);
+        for (const auto& i : v)
+            size += serialized_size(i);
+        return size;
+    }
+
+    template<typename t>
+    inline size_t serialized_size_container(const t& v)
+    {
+        return serialized_size_container(v, IsBulk<typename t::value_type>());
+    }
+
+    template<typename t>
+    inline size_t serialized_size_map(const t& v)
+    {
+        size_t size = sizeof(uint32_t);
+        for (const auto& i : v)
+            size += serialized_size(i.first) + serialized_size(i.second);
+        return size;
+    }
+
+    // 映射的元素依次写入键与值
+    template<typename out_t, typename t>
+    inline void serialize_item(out_t& out, const t& v, std::false_type)
+    {
+        serialize(out, v);
+    }
+
+    template<typename out_t, typename t>
+    inline void serialize_item(out_t& out, const t& v, std::true_type)
+    {
+        serialize(out, v.first);
+        serialize(out, v.second);
+    }
+
+    template<typename out_t, typename t, typename map_t>
+    inline void write_blocks(out_t& out, const t& v, map_t, std::false_type)
+    {}
+
+    // 分块模式下先统计每块编码后的长度(包括嵌套容器的分块表)写入分块表, 元素随后按原来的顺序写入
+    template<typename out_t, typename t, typename map_t>
+    inline void write_blocks(out_t& out, const t& v, map_t, std::true_type)
+    {
+        if (v.size() < ParallelThreshold)
+            return;
+        typedef CountSink<typename SinkFormat<out_t>::type> count_t;
+        count_t count;
+        ParallelSink<count_t> counter(count);
+        size_t n = 0, last = 0;
+        for (const auto& i : v)
+        {
+            serialize_item(counter, i, map_t());
+            if (++n % ParallelBlockSize == 0 || n == v.size())
+            {
+                if (count.size() - last > std::numeric_limits<uint32_t>::max())
+                    throw Exception("serialize container failed, block too large");
+                write_size(out, static_cast<uint32_t>(count.size() - last));
+                last = count.size();
+            }
+        }
+    }
+
+    template<typename out_t, typename t, typename a>
+    inline void serialize_container(out_t& out, const std::vector<t, a>& v, std::true_type)
+    {
+        write_size(out, static_cast<uint32_t>(v.size()));
+        if (!v.empty())
+            write_bulk(out, v.data(), v.size());
+    }
+
+    template<typename out_t, typename t, typename a>
+    inline void serialize_container(out_t& out, const std::deque<t, a>& v, std::true_type)
+    {
+        write_size(out, static_cast<uint32_t>(v.size()));
+        // deque分块连续存储, 逐块拷贝
+        for (auto it = v.begin(); it != v.end();)
+        {
+            const t* block = &*it;
+            size_t count = 1;
+            for (++it; it != v.end() && &*it == block + count; ++it)
+                ++count;
+            write_bulk(out, block, count);
+        }
+    }
+
+    template<typename out_t, typename t>
+    inline void serialize_container(out_t& out, const t& v, std::false_type)
+    {
+        write_size(out, static_cast<uint32_t>(v.size()));
+        write_blocks(out, v, std::false_type(), IsParallelSink<out_t>());
+        for (const auto& i : v)
+            serialize(out, i);
+    }
+
+    template<typename out_t, typename t>
+    inline void serialize_container(out_t& out, const t& v)
+    {
+        ProfileScope<t, out_t> scope(out, v);
+        serialize_container(out, v, IsBulkSequenceFor<typename SinkFormat<out_t>::type, t>());
+    }
+
+    template<typename out_t, typename t>
+    inline void serialize_map(out_t& out, const t& v)
+    {
+        ProfileScope<t, out_t> scope(out, v);
+        write_size(out, static_cast<uint32_t>(v.size()));
+        write_blocks(out, v, std::true_type(), IsParallelSink<out_t>());
+        for (const auto& i : v)
+            serialize_item(out, i, std::true_type());
+    }
+
+    template<typename t, typename a>
+    inline size_t serialized_size(const std::vector<t, a>& v) { return serialized_size_container(v); }
+    template<typename t, typename a>
+    inline size_t serialized_size(const std::deque<t, a>& v) { return serialized_size_container(v); }
+    template<typename t, typename a>
+    inline size_t serialized_size(const std::list<t, a>& v) { return serialized_size_container(v); }
+    template<typename t, typename c, typename a>
+    inline size_t serialized_size(const std::set<t, c, a>& v) { return serialized_size_container(v); }
+    template<typename t, typename c, typename a>
+    inline size_t serialized_size(const std::multiset<t, c, a>& v) { return serialized_size_container(v); }
+    template<typename t>
+    inline size_t serialized_size(const std::stack<t>& v) { throw Exception("serialize failed, not allowed on statck"); }
+    template<typename t>
+    inline size_t serialized_size(const std::queue<t>& v) { throw Exception("serialize failed, not allowed on queue"); }
+    template<typename t>
+    inline size_t serialized_size(const std::priority_queue<t>& v) { throw Exception("serialize failed, not allowed on priority_queue"); }
+    template<typename k, typename t, typename c, typename a>
+    inline size_t serialized_size(const std::map<k, t, c, a>& v) { return serialized_size_map(v); }
+    template<typename k, typename t, typename c, typename a>
+    inline size_t serialized_size(const std::multimap<k, t, c, a>& v) { return serialized_size_map(v); }
+    template<typename t, typename h, typename e, typename a>
+    inline size_t serialized_size(const std::unordered_set<t, h, e, a>& v) { return serialized_size_container(v); }
+    template<typename t, typename h, typename e, typename a>
+    inline size_t serialized_size(const std::unordered_multiset<t, h, e, a>& v) { return serialized_size_container(v); }
+    template<typename k, typename t, typename h, typename e, typename a>
+    inline size_t serialized_size(const std::unordered_map<k, t, h, e, a>& v) { return serialized_size_map(v); }
+    template<typename k, typename t, typename h, typename e, typename a>
+    inline size_t serialized_size(const std::unordered_multimap<k, t, h, e, a>& v) { return serialized_size_map(v); }
+
+    template<typename out_t, typename t, typename a>
+    inline void serialize(out_t& out, const std::vector<t, a>& v) { serialize_container(out, v); }
+    template<typename out_t, typename t, typename a>
+    inline void serialize(out_t& out, const std::deque<t, a>& v) { serialize_container(out, v); }
+    template<typename out_t, typename t, typename a>
+    inline void serialize(out_t& out, const std::list<t, a>& v) { serialize_container(out, v); }
+    template<typename out_t, typename t, typename c, typename a>
+    inline void serialize(out_t& out, const std::set<t, c, a>& v) { serialize_container(out, v); }
+    template<typename out_t, typename t, typename c, typename a>
+    inline void serialize(out_t& out, const std::multiset<t, c, a>& v) { serialize_container(out, v); }
+    template<typename out_t, typename t>
+    inline void serialize(out_t& out, const std::stack<t>& v) { throw Exception("serialize failed, not allowed on statck"); }
+    template<typename out_t, typename t>
+    inline void serialize(out_t& out, const std::queue<t>& v) { throw Exception("serialize failed, not allowed on queue"); }
+    template<typename out_t, typename t>
+    inline void serialize(out_t& out, const std::priority_queue<t>& v) { throw Exception("serialize failed, not allowed on priority_queue"); }
+    template<typename out_t, typename k, typename t, typename c, typename a>
+    inline void serialize(out_t& out, const std::map<k, t, c, a>& v) { serialize_map(out, v); }
+    template<typename out_t, typename k, typename t, typename c, typename a>
+    inline void serialize(out_t& out, const std::multimap<k, t, c, a>& v) { serialize_map(out, v); }
+    template<typename out_t, typename t, typename h, typename e, typename a>
+    inline void serialize(out_t& out, const std::unordered_set<t, h, e, a>& v) { serialize_container(out, v); }
+    template<typename out_t, typename t, typename h, typename e, typename a>
+    inline void serialize(out_t& out, const std::unordered_multiset<t, h, e, a>& v) { serialize_container(out, v); }
+    template<typename out_t, typename k, typename t, typename h, typename e, typename a>
+    inline void serialize(out_t& out, const std::unordered_map<k, t, h, e, a>& v) { serialize_map(out, v); }
+    template<typename out_t, typename k, typename t, typename h, typename e, typename a>
+    inline void serialize(out_t& out, const std::unordered_multimap<k, t, h, e, a>& v) { serialize_map(out, v); }
+    // 按长度前缀预留空间, 长度来自输入的数据, 以剩余字节数为上限, 避免错误的数据导致分配过多内存
+    template<typename format_t, typename t, typename a>
+    inline void reserve_items(Reader<format_t>& in, std::vector<t, a>& v, uint32_t size)
+    {
+        v.reserve(v.size() + (size < in.remain() ? size : in.remain()));
+    }
+
+    // 无序容器按元素数预先分配桶, 插入时不再重新散列
+    template<typename format_t, typename t, typename h, typename e, typename a>
+    inline void reserve_items(Reader<format_t>& in, std::unordered_set<t, h, e, a>& v, uint32_t size)
+    {
+        v.reserve(v.size() + (size < in.remain() ? size : in.remain()));
+    }
+
+    template<typename format_t, typename t, typename h, typename e, typename a>
+    inline void reserve_items(Reader<format_t>& in, std::unordered_multiset<t, h, e, a>& v, uint32_t size)
+    {
+        v.reserve(v.size() + (size < in.remain() ? size : in.remain()));
+    }
+
+    template<typename format_t, typename k, typename t, typename h, typename e, typename a>
+    inline void reserve_items(Reader<format_t>& in, std::unordered_map<k, t, h, e, a>& v, uint32_t size)
+    {
+        v.reserve(v.size() + (size < in.remain() ? size : in.remain()));
+    }
+
+    template<typename format_t, typename k, typename t, typename h, typename e, typename a>
+    inline void reserve_items(Reader<format_t>& in, std::unordered_multimap<k, t, h, e, a>& v, uint32_t size)
+    {
+        v.reserve(v.size() + (size < in.remain() ? size : in.remain()));
+    }
+
+    template<typename format_t, typename t>
+    inline void reserve_items(Reader<format_t>& in, t& v, uint32_t size)
+    {}
+
+    // 复用模式下直接解码到已有的元素中, 元素自身的空间(字符串, 嵌套的容器)也得以保留, 多余的元素删除
+    template<typename format_t, typename t>
+    inline uint32_t deserialize_existing(Reader<format_t>& in, t& v, uint32_t size)
+    {
+        uint32_t count = 0;
+        auto it = v.begin();
+        for (; it != v.end() && count < size; ++it, ++count)
+            deserialize(in, *it);
+        v.erase(it, v.end());
+        return count;
+    }
+
+    template<typename format_t, typename a>
+    inline uint32_t deserialize_existing(Reader<format_t>& in, std::vector<bool, a>& v, uint32_t size)
+    {
+        v.clear();
+        return 0;
+    }
+
+    // 在容器末尾直接构造元素再解码, 不经过临时对象
+    template<typename format_t, typename t>
+    inline void deserialize_back(Reader<format_t>& in, t& v)
+    {
+        v.emplace_back();
+        deserialize(in, v.back());
+    }
+
+    template<typename format_t, typename a>
+    inline void deserialize_back(Reader<format_t>& in, std::vector<bool, a>& v)
+    {
+        bool item;
+        deserialize(in, item);
+        v.push_back(item);
+    }
+
+    // 分块表: 各块相对于第一个元素的起止偏移, 不是分块模式或元素较少时为空
+    struct BlockTable
+    {
+        const uint8_t* base;
+        std::vector<size_t> offsets;
+        bool empty() const { return offsets.empty(); }
+        size_t count() const { return offsets.size() - 1; }
+        // 顺序解码完所有元素后应当正好到达最后一块的末尾
+        void check(const uint8_t* cursor) const
+        {
+            if (!offsets.empty() && cursor != base + offsets.back())
+                throw Exception("deserialize container failed, block size mismatch");
+        }
+    };
+
+    template<typename format_t>
+    inline void read_blocks(Reader<format_t>& in, uint32_t size, BlockTable& blocks)
+    {
+        if (!in.blocks || size < ParallelThreshold)
+            return;
+        size_t count = (size + ParallelBlockSize - 1) / ParallelBlockSize;
+        if (count > in.remain())
+            throw Exception("deserialize container failed, out of memery");
+        blocks.offsets.resize(count + 1);
+        blocks.offsets[0] = 0;
+        for (size_t i = 0; i < count; ++i)
+            blocks.offsets[i + 1] = blocks.offsets[i] + read_size(in, "deserialize container failed, out of memery");
+        if (blocks.offsets.back() > in.remain())
+            throw Exception("deserialize container failed, out of memery");
+        blocks.base = in.cursor;
+    }
+
+    // 在线程池上解码各块, 每块用独立的Reader, 块内嵌套的容器顺序解码; fn(block, i)解码第i块的元素
+    template<typename format_t, typename fn_t>
+    inline void run_blocks(Reader<format_t>& in, const BlockTable& blocks, const fn_t& fn)
+    {
+        in.parallel->run(blocks.count(), [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                Reader<format_t> block(blocks.base + blocks.offsets[i], blocks.base + blocks.offsets[i + 1], in.reuse);
+                block.blocks = true;
+                fn(block, i);
+                if (block.cursor != block.end)
+                    throw Exception("deserialize container failed, block size mismatch");
+            }
+        });
+        in.cursor = blocks.base + blocks.offsets.back();
+    }
+
+    template<typename t> struct IsMapContainer : public std::false_type {};
+    template<typename k, typename t, typename c, typename a> struct IsMapContainer<std::map<k, t, c, a>> : public std::true_type {};
+    template<typename k, typename t, typename c, typename a> struct IsMapContainer<std::multimap<k, t, c, a>> : public std::true_type {};
+    template<typename k, typename t, typename h, typename e, typename a> struct IsMapContainer<std::unordered_map<k, t, h, e, a>> : public std::true_type {};
+    template<typename k, typename t, typename h, typename e, typename a> struct IsMapContainer<std::unordered_multimap<k, t, h, e, a>> : public std::true_type {};
+
+    // 可以先调整大小再直接解码到各元素中的容器
+    template<typename t> struct IsBlockInPlace : public std::false_type {};
+    template<typename t, typename a> struct IsBlockInPlace<std::vector<t, a>> : public std::true_type {};
+    template<typename t, typename a> struct IsBlockInPlace<std::deque<t, a>> : public std::true_type {};
+
+    // 其他容器各块先解码到临时的序列中, 映射的键去掉const
+    template<typename t, bool map = IsMapContainer<t>::value> struct BlockItem { typedef typename t::value_type type; };
+    template<typename t> struct BlockItem<t, true> { typedef std::pair<typename t::key_type, typename t::mapped_type> type; };
+
+    template<typename format_t, typename t>
+    inline void deserialize_item(Reader<format_t>& in, t& v, std::false_type)
+    {
+        deserialize(in, v);
+    }
+
+    template<typename format_t, typename t>
+    inline void deserialize_item(Reader<format_t>& in, t& v, std::true_type)
+    {
+        deserialize(in, v.first);
+        deserialize(in, v.second);
+    }
+
+    template<typename format_t, typename t>
+    inline void deserialize_blocks(Reader<format_t>& in, t& v, uint32_t size, const BlockTable& blocks, std::true_type)
+    {
+        size_t offset = in.reuse ? 0 : v.size();
+        v.resize(offset + size);
+        run_blocks(in, blocks, [&](Reader<format_t>& block, size_t i)
+        {
+            size_t first = offset + i * ParallelBlockSize, last = offset + (i + 1 < blocks.count() ? (i + 1) * ParallelBlockSize : size);
+            for (size_t j = first; j < last; ++j)
+                deserialize(block, v[j]);
+        });
+    }
+
+    // 按块的顺序合并, 有序容器中的元素本来就是有序的, 每次插入到末尾
+    template<typename format_t, typename t>
+    inline void deserialize_blocks(Reader<format_t>& in, t& v, uint32_t size, const BlockTable& blocks, std::false_type)
+    {
+        typedef typename BlockItem<t>::type item_t;
+        if (in.reuse)
+            v.clear();
+        reserve_items(in, v, size);
+        std::vector<std::vector<item_t>> parts(blocks.count());
+        run_blocks(in, blocks, [&](Reader<format_t>& block, size_t i)
+        {
+            parts[i].resize(i + 1 < blocks.count() ? ParallelBlockSize : size - i * ParallelBlockSize);
+            for (auto& item : parts[i])
+                deserialize_item(block, item, IsMapContainer<t>());
+        });
+        for (auto& part : parts)
+            for (auto& item : part)
+                v.insert(v.end(), std::move(item));
+    }
+
+    // 返回false时由调用者顺序解码
+    // 当前线程设置了内存池时, 元素的分配器都指向这个内存池, 不能在多个线程中同时分配
+    // 各块的总长度小于元素数时(有元素不占字节, 或分块表已损坏)不预先分配所有元素, 顺序解码时按剩余的字节数预留
+    template<typename format_t, typename t>
+    inline bool deserialize_blocks(Reader<format_t>& in, t& v, uint32_t size, const BlockTable& blocks)
+    {
+        if (!in.parallel || blocks.empty() || size > blocks.offsets.back() || current_arena())
+            return false;
+        deserialize_blocks(in, v, size, blocks, IsBlockInPlace<t>());
+        return true;
+    }
+
+    // std::vector<bool>的元素不能在多个线程中同时写入
+    template<typename format_t, typename a>
+    inline bool deserialize_blocks(Reader<format_t>& in, std::vector<bool, a>& v, uint32_t size, const BlockTable& blocks)
+    {
+        return false;
+    }
+
+    template<typename format_t, typename t, typename a>
+    inline void deserialize_container(Reader<format_t>& in, std::vector<t, a>& v, std::true_type)
+    {
+        uint32_t size = read_size(in, "deserialize container failed, out of memery");
+        if (size > in.remain() / sizeof(t))
+            throw Exception("deserialize container failed, out of memery");
+        if (in.reuse)
+            v.clear();
+        if (size)
+        {
+            size_t offset = v.size();
+            v.resize(offset + size);
+            read_bulk(in, v.data() + offset, size);
+        }
+    }
+
+    template<typename format_t, typename t, typename a>
+    inline void deserialize_container(Reader<format_t>& in, std::deque<t, a>& v, std::true_type)
+    {
+        uint32_t size = read_size(in, "deserialize container failed, out of memery");
+        if (size > in.remain() / sizeof(t))
+            throw Exception("deserialize container failed, out of memery");
+        if (in.reuse)
+            v.clear();
+        size_t offset = v.size();
+        v.resize(offset + size);
+        for (auto it = v.begin() + offset; it != v.end();)
+        {
+            t* block = &*it;
+            size_t count = 1;
+            for (++it; it != v.end() && &*it == block + count; ++it)
+                ++count;
+            read_bulk(in, block, count);
+        }
+    }
+
+    template<typename format_t, typename t>
+    inline void deserialize_container(Reader<format_t>& in, t& v, std::false_type)
+    {
+        uint32_t size = read_size(in, "deserialize container failed, out of memery");
+        BlockTable blocks;
+        read_blocks(in, size, blocks);
+        if (deserialize_blocks(in, v, size, blocks))
+            return;
+        uint32_t i = in.reuse ? deserialize_existing(in, v, size) : 0;
+        reserve_items(in, v, size - i);
+        for (; i < size; ++i)
+            deserialize_back(in, v);
+        blocks.check(in.cursor);
+    }
+
+    template<typename format_t, typename t>
+    inline void deserialize_container(Reader<format_t>& in, t& v)
+    {
+        ProfileScope<t, Reader<format_t>> scope(in, v);
+        deserialize_container(in, v, IsBulkSequenceFor<format_t, t>());
+    }
+
+    // 有序容器编码时按顺序写入, 解码时每次插入到末尾, 重建为线性时间; 输入无序时仍然正确, 只是退化为逐个查找位置
+    template<typename format_t, typename t>
+    inline void deserialize_set(Reader<format_t>& in, t& v)
+    {
+        ProfileScope<t, Reader<format_t>> scope(in, v);
+        uint32_t size = read_size(in, "deserialize set failed, out of memery");
+        BlockTable blocks;
+        read_blocks(in, size, blocks);
+        if (deserialize_blocks(in, v, size, blocks))
+            return;
+        if (in.reuse)
+            v.clear();
+        reserve_items(in, v, size);
+        for (uint32_t i = 0; i < size; ++i)
+        {
+            typename t::value_type item;
+            deserialize(in, item);
+            v.emplace_hint(v.end(), std::move(item));
+        }
+        blocks.check(in.cursor);
+    }
+
+    template<typename format_t, typename t>
+    inline void deserialize_map(Reader<format_t>& in, t& v)
+    {
+        ProfileScope<t, Reader<format_t>> scope(in, v);
+        uint32_t size = read_size(in, "deserialize map failed, out of memery");
+        BlockTable blocks;
+        read_blocks(in, size, blocks);
+        if (deserialize_blocks(in, v, size, blocks))
+            return;
+        if (in.reuse)
+            v.clear();
+        reserve_items(in, v, size);
+        for (uint32_t i = 0; i < size; ++i)
+        {
+            typename t::key_type key;
+            typename t::mapped_type item;
+            deserialize(in, key);
+            deserialize(in, item);
+            v.emplace_hint(v.end(), std::move(key), std::move(item));
+        }
+        blocks.check(in.cursor);
+    }
+
+    template<typename format_t, typename t, typename a>
+    inline void deserialize(Reader<format_t>& in, std::vector<t, a>& v) { deserialize_container(in, v); }
+    template<typename format_t, typename t, typename a>
+    inline void deserialize(Reader<format_t>& in, std::deque<t, a>& v) { deserialize_container(in, v); }
+    template<typename format_t, typename t, typename a>
+    inline void deserialize(Reader<format_t>& in, std::list<t, a>& v) { deserialize_container(in, v); }
+    template<typename format_t, typename t, typename c, typename a>
+    inline void deserialize(Reader<format_t>& in, std::set<t, c, a>& v) { deserialize_set(in, v); }
+    template<typename format_t, typename t, typename c, typename a>
+    inline void deserialize(Reader<format_t>& in, std::multiset<t, c, a>& v) { deserialize_set(in, v); }
+    template<typename format_t, typename t>
+    inline void deserialize(Reader<format_t>& in, std::stack<t>& v) { throw Exception("deserialize failed, not allowed on statck"); }
+    template<typename format_t, typename t>
+    inline void deserialize(Reader<format_t>& in, std::queue<t>& v) { throw Exception("deserialize failed, not allowed on queue"); }
+    template<typename format_t, typename t>
+    inline void deserialize(Reader<format_t>& in, std::priority_queue<t>& v) { throw Exception("deserialize failed, not allowed on priority_queue"); }
+    template<typename format_t, typename k, typename t, typename c, typename a>
+    inline void deserialize(Reader<format_t>& in, std::map<k, t, c, a>& v) { deserialize_map(in, v); }
+    template<typename format_t, typename k, typename t, typename c, typename a>
+    inline void deserialize(Reader<format_t>& in, std::multimap<k, t, c, a>& v) { deserialize_map(in, v); }
+    template<typename format_t, typename t, typename h, typename e, typename a>
+    inline void deserialize(Reader<format_t>& in, std::unordered_set<t, h, e, a>& v) { deserialize_set(in, v); }
+    template<typename format_t, typename t, typename h, typename e, typename a>
+    inline void deserialize(Reader<format_t>& in, std::unordered_multiset<t, h, e, a>& v) { deserialize_set(in, v); }
+    template<typename format_t, typename k, typename t, typename h, typename e, typename a>
+    inline void deserialize(Reader<format_t>& in, std::unordered_map<k, t, h, e, a>& v) { deserialize_map(in, v); }
+    template<typename format_t, typename k, typename t, typename h, typename e, typename a>
+    inline void deserialize(Reader<format_t>& in, std::unordered_multimap<k, t, h, e, a>& v) { deserialize_map(in, v); }
+
+    inline size_t serialized_size()
+    {
+        return 0;
+    }
+
+    template<typename t, typename...args_t>
+    inline size_t serialized_size(const t& v, const args_t&...args)
+    {
+        return serialized_size(v) + serialized_size(args...);
+    }
+
+    template<typename out_t>
+    inline void serialize_values(out_t& out)
+    {}
+
+    template<typename out_t, typename t, typename...args_t>
+    inline void serialize_values(out_t& out, const t& v, const args_t&...args)
+    {
+        serialize(out, v);
+        serialize_values(out, args...);
+    }
+
+    // 定长格式先计算总长度, 只分配一次空间; 变长格式的长度要编码后才知道, 不预留
+    template<typename out_t, typename...args_t>
+    inline void reserve_values(out_t& out, const FixedFormat&, const args_t&...args)
+    {
+        reserve_bytes(out, serialized_size(args...));
+    }
+
+    template<typename out_t, typename...args_t>
+    inline void reserve_values(out_t& out, const CompactFormat&, const args_t&...args)
+    {}
+
+    template<typename out_t, typename...args_t>
+    inline void reserve_values(out_t& out, const PortableFormat&, const args_t&...args)
+    {}
+
+    template<typename out_t, typename format_t, typename...args_t>
+    inline void serialize_sized(out_t& out, const format_t& format, const args_t&...args)
+    {
+        reserve_values(out, format, args...);
+        serialize_values(out, args...);
+    }
+
+    // 定长格式写入ZnSerializeBuffer时先扩容, 再通过游标不做检查地直接写入
+    template<typename...args_t>
+    inline void serialize_sized(ZnSerializeBuffer& out, const FixedFormat&, const args_t&...args)
+    {
+        size_t offset = out.size();
+        out.resize(offset + serialized_size(args...));
+        CursorSink cursor(out.data() + offset);
+        serialize_values(cursor, args...);
+    }
+
+    template<typename out_t, typename t, typename...args_t>
+    inline void serialize(out_t& out, const t& v, const args_t&...args)
+    {
+        serialize_sized(out, typename SinkFormat<out_t>::type(), v, args...);
+    }
+
+    template<typename format_t>
+    inline void deserialize_values(Reader<format_t>& in)
+    {}
+
+    template<typename format_t, typename t, typename...args_t>
+    inline void deserialize_values(Reader<format_t>& in, t& v, args_t&...args)
+    {
+        deserialize(in, v);
+        deserialize_values(in, args...);
+    }
+
+    template<typename t, typename...args_t>
+    inline const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end, t& v, args_t&...args)
+    {
+        Reader<> in(begin, end);
+        deserialize_values(in, v, args...);
+        return in.cursor;
+    }
+
+    template<typename t, typename...args_t>
+    inline const uint8_t* deserialize(const ZnSerializeBuffer& in, t& v, args_t&...args)
+    {
+        Reader<> reader(in);
+        deserialize_values(reader, v, args...);
+        return reader.cursor;
+    }
+
+    // 结构体作为一整条消息编解码, 输出端没有声明格式时使用结构体声明的格式(ZnFormat)
+    // 嵌套的结构体与基类跟随外层的格式
+    template<typename out_t, typename t>
+    inline void serialize_message(out_t& out, const t& v)
+    {
+        reserve_values(out, typename SinkFormat<out_t>::type(), v);
+        v.serialize_to(out);
+    }
+
+    // 定长格式写入ZnSerializeBuffer时先扩容, 再不做检查地直接写入
+    template<typename t>
+    inline void serialize_message(ZnSerializeBuffer& out, const t& v)
+    {
+        size_t offset = out.size();
+        out.resize(offset + v.t::serialized_size());
+        CursorSink cursor(out.data() + offset);
+        v.serialize_to(cursor);
+    }
+
+    template<typename out_t, typename t>
+    inline void serialize_struct(out_t& out, const t& v, std::true_type)
+    {
+        serialize_message(out, v);
+    }
+
+    template<typename out_t, typename t>
+    inline void serialize_struct(out_t& out, const t& v, std::false_type)
+    {
+        FormatSink<typename t::ZnFormat, out_t> sink(out);
+        serialize_message(sink, v);
+    }
+
+    template<typename out_t, typename t>
+    inline void serialize_struct(out_t& out, const t& v)
+    {
+        serialize_struct(out, v, std::is_same<typename SinkFormat<out_t, typename t::ZnFormat>::type, typename SinkFormat<out_t>::type>());
+    }
+
+    template<typename t>
+    inline const uint8_t* deserialize_struct(const uint8_t* begin, const uint8_t* end, t& v)
+    {
+        Reader<typename t::ZnFormat> in(begin, end);
+        v.t::deserialize_from(in);
+        return in.cursor;
+    }
+
+    // 复用模式反序列化整条消息: 容器先清空但保留容量, vector, deque, list直接解码到已有的元素中
+    // 反复解码到同一个长期存在的对象时, 对象不会增长, 也不会反复分配内存
+    template<typename t>
+    inline const uint8_t* deserialize_reuse(const uint8_t* begin, const uint8_t* end, t& v)
+    {
+        Reader<typename t::ZnFormat> in(begin, end, true);
+        v.t::deserialize_from(in);
+        return in.cursor;
+    }
+
+    template<typename t>
+    inline const uint8_t* deserialize_reuse(const ZnSerializeBuffer& buffer, t& v)
+    {
+        return deserialize_reuse(buffer.data(), buffer.data() + buffer.size(), v);
+    }
+
+    // 引用跟踪: 同一个对象被多个shared_ptr引用时只完整编码一次, 之后只写入编号, 解码时重建共享关系
+    // 每个shared_ptr多一个标记, 允许空指针; 编码后的格式与普通模式不同, 必须用deserialize_shared解码
+    template<typename t, typename out_t>
+    inline void serialize_shared(const t& v, out_t& out)
+    {
+        FormatSink<typename t::ZnFormat, out_t> format(out);
+        SharedSink<FormatSink<typename t::ZnFormat, out_t>> sink(format);
+        v.serialize_to(sink);
+    }
+
+    template<typename t>
+    inline const uint8_t* deserialize_shared(const uint8_t* begin, const uint8_t* end, t& v)
+    {
+        SharedTable shared;
+        Reader<typename t::ZnFormat> in(begin, end);
+        in.shared = &shared;
+        v.t::deserialize_from(in);
+        return in.cursor;
+    }
+
+    template<typename t>
+    inline const uint8_t* deserialize_shared(const ZnSerializeBuffer& buffer, t& v)
+    {
+        return deserialize_shared(buffer.data(), buffer.data() + buffer.size(), v);
+    }
+
+    // 分块模式: 元素数不少于ParallelThreshold的容器带有分块表, 解码时可以把各块分给多个线程
+    // 编码后的格式与普通模式不同, 必须用deserialize_parallel解码
+    template<typename t, typename out_t>
+    inline void serialize_parallel(const t& v, out_t& out)
+    {
+        FormatSink<typename t::ZnFormat, out_t> format(out);
+        ParallelSink<FormatSink<typename t::ZnFormat, out_t>> sink(format);
+        v.serialize_to(sink);
+    }
+
+    // runner为空时在调用线程上顺序解码
+    template<typename t>
+    inline const uint8_t* deserialize_parallel(const uint8_t* begin, const uint8_t* end, t& v, ParallelRunner* runner = nullptr)
+    {
+        Reader<typename t::ZnFormat> in(begin, end);
+        in.blocks = true;
+        in.parallel = runner;
+        v.t::deserialize_from(in);
+        return in.cursor;
+    }
+
+    template<typename t>
+    inline const uint8_t* deserialize_parallel(const ZnSerializeBuffer& buffer, t& v, ParallelRunner* runner = nullptr)
+    {
+        return deserialize_parallel(buffer.data(), buffer.data() + buffer.size(), v, runner);
+    }
+
+    template<typename t>
+    inline size_t message_size(const t& v, std::true_type)
+    {
+        return v.t::serialized_size();
+    }
+
+    template<typename t>
+    inline size_t message_size(const t& v, std::false_type)
+    {
+        CountSink<typename t::ZnFormat> count;
+        v.serialize_to(count);
+        return count.size();
+    }
+
+    // 结构体按自身声明的格式编码为一整条消息的字节数
+    template<typename t>
+    inline size_t message_size(const t& v)
+    {
+        return message_size(v, std::is_same<typename t::ZnFormat, FixedFormat>());
+    }
+
+    // 按序列化的顺序(先基类再成员)依次调用visitor(member)
+    template<typename visitor_t>
+    inline void visit_values(visitor_t& visitor)
+    {}
+
+    template<typename visitor_t, typename t, typename...args_t>
+    inline void visit_values(visitor_t& visitor, t& v, args_t&...args)
+    {
+        visitor(v);
+        visit_values(visitor, args...);
+    }
+
+    // 定长布局: 编码长度是编译期常量的类型, 即数值, 枚举, 它们的数组, std::array, std::tuple, 以及成员(包括基类)全部定长的结构体
+    // 紧凑格式下多字节的整数变长编码, 不是定长
+    struct FixedLayoutInfo
+    {
+        bool fixed;
+        size_t size;
+    };
+
+    template<typename...t> struct FixedMembers {};
+    template<typename...t> inline FixedMembers<t...> fixed_members(const t&...);
+    inline FixedMembers<> fixed_members();
+
+    // 不需要对象, 按顺序以空指针const t*访问成员的类型
+    template<typename visitor_t, typename...t>
+    inline void visit_types(visitor_t& visitor, FixedMembers<t...>)
+    {
+        int expand[] = { 0, (visitor(static_cast<const t*>(nullptr)), 0)... };
+        (void)expand;
+    }
+
+    template<typename format_t, typename t, bool = IsZnStruct<t>::value>
+    struct FixedField
+    {
+        static constexpr FixedLayoutInfo get()
+        {
+            return FixedLayoutInfo{ (std::is_arithmetic<t>::value || std::is_enum<t>::value) && IsBulkFor<format_t, t>::value, sizeof(t) };
+        }
+        static void pack(uint8_t*& p, const t& v)
+        {
+            t value = v;
+            swap_bulk(&value, 1, NeedSwap<format_t, t>());
+            memcpy(p, &value, sizeof(t));
+            p += sizeof(t);
+        }
+        static void unpack(const uint8_t*& p, t& v)
+        {
+            memcpy(&v, p, sizeof(t));
+            swap_bulk(&v, 1, NeedSwap<format_t, t>());
+            p += sizeof(t);
+        }
+    };
+
+    template<typename format_t, typename list_t> struct FixedFieldSum;
+
+    template<typename format_t>
+    struct FixedFieldSum<format_t, FixedMembers<>>
+    {
+        static constexpr FixedLayoutInfo get() { return FixedLayoutInfo{ true, 0 }; }
+    };
+
+    template<typename format_t, typename t, typename...args_t>
+    struct FixedFieldSum<format_t, FixedMembers<t, args_t...>>
+    {
+        static constexpr FixedLayoutInfo get()
+        {
+            return FixedLayoutInfo{ FixedField<format_t, t>::get().fixed && FixedFieldSum<format_t, FixedMembers<args_t...>>::get().fixed
+                , FixedField<format_t, t>::get().size + FixedFieldSum<format_t, FixedMembers<args_t...>>::get().size };
+        }
+    };
+
+    // 整块拷贝且不需要交换字节序的数组一次拷贝, 其余逐个元素
+    template<typename format_t, typename t>
+    inline void pack_fixed_array(uint8_t*& p, const t* v, size_t s, std::true_type)
+    {
+        memcpy(p, v, s * sizeof(t));
+        p += s * sizeof(t);
+    }
+
+    template<typename format_t, typename t>
+    inline void pack_fixed_array(uint8_t*& p, const t* v, size_t s, std::false_type)
+    {
+        for (size_t i = 0; i < s; ++i)
+            FixedField<format_t, t>::pack(p, v[i]);
+    }
+
+    template<typename format_t, typename t>
+    inline void unpack_fixed_array(const uint8_t*& p, t* v, size_t s, std::true_type)
+    {
+        memcpy(v, p, s * sizeof(t));
+        p += s * sizeof(t);
+    }
+
+    template<typename format_t, typename t>
+    inline void unpack_fixed_array(const uint8_t*& p, t* v, size_t s, std::false_type)
+    {
+        for (size_t i = 0; i < s; ++i)
+            FixedField<format_t, t>::unpack(p, v[i]);
+    }
+
+    template<typename format_t, typename t> struct IsFixedCopy
+        : public std::integral_constant<bool, IsBulkFor<format_t, t>::value && !NeedSwap<format_t, t>::value> {};
+
+    template<typename format_t, typename t, size_t s>
+    struct FixedField<format_t, t[s], false>
+    {
+        static constexpr FixedLayoutInfo get() { return FixedLayoutInfo{ FixedField<format_t, t>::get().fixed, s * FixedField<format_t, t>::get().size }; }
+        static void pack(uint8_t*& p, const t(&v)[s]) { pack_fixed_array<format_t>(p, v, s, IsFixedCopy<format_t, t>()); }
+        static void unpack(const uint8_t*& p, t(&v)[s]) { unpack_fixed_array<format_t>(p, v, s, IsFixedCopy<format_t, t>()); }
+    };
+
+    template<typename format_t, typename t, size_t s>
+    struct FixedField<format_t, std::array<t, s>, false>
+    {
+        static constexpr FixedLayoutInfo get() { return FixedLayoutInfo{ FixedField<format_t, t>::get().fixed, s * FixedField<format_t, t>::get().size }; }
+        static void pack(uint8_t*& p, const std::array<t, s>& v) { pack_fixed_array<format_t>(p, v.data(), s, IsFixedCopy<format_t, t>()); }
+        static void unpack(const uint8_t*& p, std::array<t, s>& v) { unpack_fixed_array<format_t>(p, v.data(), s, IsFixedCopy<format_t, t>()); }
+    };
+
+    template<typename format_t, size_t i, size_t n>
+    struct FixedTuple
+    {
+        template<typename tuple_t>
+        static void pack(uint8_t*& p, const tuple_t& v)
+        {
+            FixedField<format_t, typename std::tuple_element<i, tuple_t>::type>::pack(p, std::get<i>(v));
+            FixedTuple<format_t, i + 1, n>::pack(p, v);
+        }
+        template<typename tuple_t>
+        static void unpack(const uint8_t*& p, tuple_t& v)
+        {
+            FixedField<format_t, typename std::tuple_element<i, tuple_t>::type>::unpack(p, std::get<i>(v));
+            FixedTuple<format_t, i + 1, n>::unpack(p, v);
+        }
+    };
+
+    template<typename format_t, size_t n>
+    struct FixedTuple<format_t, n, n>
+    {
+        template<typename tuple_t> static void pack(uint8_t*& p, const tuple_t& v) {}
+        template<typename tuple_t> static void unpack(const uint8_t*& p, tuple_t& v) {}
+    };
+
+    template<typename format_t, typename...t>
+    struct FixedField<format_t, std::tuple<t...>, false>
+    {
+        static constexpr FixedLayoutInfo get() { return FixedFieldSum<format_t, FixedMembers<t...>>::get(); }
+        static void pack(uint8_t*& p, const std::tuple<t...>& v) { FixedTuple<format_t, 0, sizeof...(t)>::pack(p, v); }
+        static void unpack(const uint8_t*& p, std::tuple<t...>& v) { FixedTuple<format_t, 0, sizeof...(t)>::unpack(p, v); }
+    };
+
+    template<typename format_t>
+    struct FixedPackVisitor
+    {
+        uint8_t* p;
+        template<typename m>
+        void operator()(const m& v)
+        {
+            FixedField<format_t, m>::pack(p, v);
+        }
+    };
+
+    template<typename format_t>
+    struct FixedUnpackVisitor
+    {
+        const uint8_t* p;
+        template<typename m>
+        void operator()(m& v)
+        {
+            FixedField<format_t, m>::unpack(p, v);
+        }
+    };
+
+    // 结构体: 基类(ZnParents)的长度加上ZN_SERIALIZE中成员的长度, 按visit_members的顺序逐个打包
+    template<typename format_t, typename t>
+    struct FixedField<format_t, t, true>
+    {
+        static constexpr FixedLayoutInfo get()
+        {
+            return FixedLayoutInfo{ FixedFieldSum<format_t, typename t::ZnParents>::get().fixed && t::template zn_member_layout<format_t>().fixed
+                , FixedFieldSum<format_t, typename t::ZnParents>::get().size + t::template zn_member_layout<format_t>().size };
+        }
+        static void pack(uint8_t*& p, const t& v)
+        {
+            FixedPackVisitor<format_t> visitor = { p };
+            v.visit_members(visitor);
+            p = visitor.p;
+        }
+        static void unpack(const uint8_t*& p, t& v)
+        {
+            FixedUnpackVisitor<format_t> visitor = { p };
+            v.visit_members(visitor);
+            p = visitor.p;
+        }
+    };
+
+    // 结构体按format_t编码的长度是否为编译期常量, 是时size为该长度, 否则为0
+    template<typename t, typename format_t = typename t::ZnFormat>
+    struct FixedLayout : public std::integral_constant<bool, FixedField<format_t, t>::get().fixed>
+    {
+        static constexpr size_t size = FixedField<format_t, t>::get().fixed ? FixedField<format_t, t>::get().size : 0;
+    };
+
+    template<typename t, typename format_t> constexpr size_t FixedLayout<t, format_t>::size;
+
+    // 定长布局的结构体编码时先在栈上打包, 一次写入输出端; 解码时只检查一次剩余的字节数, 之后不做检查地逐个拷贝
+    // 超过FixedPackLimit的结构体编码时仍逐个成员写入
+    const size_t FixedPackLimit = 1024;
+
+    template<typename t> struct IsFixedLayout : public FixedLayout<t, FixedFormat> {};
+
+    template<typename format_t, typename t> struct IsFixedPack
+        : public std::integral_constant<bool, FixedLayout<t, format_t>::value && FixedLayout<t, format_t>::size && FixedLayout<t, format_t>::size <= FixedPackLimit> {};
+    template<typename format_t, typename t> struct IsFixedUnpack
+        : public std::integral_constant<bool, FixedLayout<t, format_t>::value && FixedLayout<t, format_t>::size> {};
+
+    template<typename out_t, typename t>
+    inline void write_fixed(out_t& out, const t& v)
+    {
+        typedef typename SinkFormat<out_t>::type format_t;
+        uint8_t buffer[FixedLayout<t, format_t>::size];
+        uint8_t* p = buffer;
+        FixedField<format_t, t>::pack(p, v);
+        write_bytes(out, buffer, sizeof(buffer));
+    }
+
+    template<typename format_t, typename t>
+    inline void read_fixed(Reader<format_t>& in, t& v)
+    {
+        const uint8_t* p = read_bytes(in, FixedLayout<t, format_t>::size, "deserialize struct failed, out of memery");
+        FixedField<format_t, t>::unpack(p, v);
+    }
+
+    template<typename t, typename...parents_t>
+    struct AutoAdaptBase : public Parent<t, parents_t...>
+    {
+        typedef FixedMembers<parents_t...> ZnParents;
+    protected:
+        template<typename ...args_t>
+        size_t auto_adapt_serialized_size(t* child, const args_t&...args)
+        {
+            return adapt_serialized_size(child, IsFixedLayout<t>(), args...);
+        }
+        template<typename out_t, typename ...args_t>
+        void auto_adapt_serialize(t* child, out_t& out, const args_t&...args)
+        {
+            ProfileScope<t, out_t> scope(out);
+            adapt_serialize(child, out, IsFixedPack<typename SinkFormat<out_t>::type, t>(), args...);
+        }
+        template<typename in_t, typename ...args_t>
+        void auto_adapt_deserialize(t* child, in_t& in, args_t&...args)
+        {
+            ProfileScope<t, in_t> scope(in);
+            adapt_deserialize(child, in, IsFixedUnpack<typename in_t::ZnFormat, t>(), args...);
+        }
+        template<typename visitor_t, typename ...args_t>
+        void auto_adapt_visit(t* child, visitor_t& visitor, args_t&...args)
+        {
+            Parent<t, parents_t...>::parent_pack_t::parent_visit(child, visitor);
+            zn_serialize::visit_values(visitor, args...);
+        }
+    private:
+        template<typename ...args_t>
+        size_t adapt_serialized_size(t* child, std::true_type, const args_t&...args)
+        {
+            return FixedLayout<t, FixedFormat>::size;
+        }
+        template<typename ...args_t>
+        size_t adapt_serialized_size(t* child, std::false_type, const args_t&...args)
+        {
+            return Parent<t, parents_t...>::parent_pack_t::parent_serialized_size(child) + zn_serialize::serialized_size(args...);
+        }
+        template<typename out_t, typename ...args_t>
+        void adapt_serialize(t* child, out_t& out, std::true_type, const args_t&...args)
+        {
+            write_fixed(out, *child);
+        }
+        template<typename out_t, typename ...args_t>
+        void adapt_serialize(t* child, out_t& out, std::false_type, const args_t&...args)
+        {
+            Parent<t, parents_t...>::parent_pack_t::parent_serialize(child, out);
+            zn_serialize::serialize_values(out, args...);
+        }
+        template<typename in_t, typename ...args_t>
+        void adapt_deserialize(t* child, in_t& in, std::true_type, args_t&...args)
+        {
+            read_fixed(in, *child);
+        }
+        template<typename in_t, typename ...args_t>
+        void adapt_deserialize(t* child, in_t& in, std::false_type, args_t&...args)
+        {
+            Parent<t, parents_t...>::parent_pack_t::parent_deserialize(child, in);
+            zn_serialize::deserialize_values(in, args...);
+        }
+    };
+
+    template<typename t, typename root_t>
+    struct AutoAdaptRoot : public root_t
+    {
+        typedef FixedMembers<> ZnParents;
+    protected:
+        template<typename...args_t>
+        size_t auto_adapt_serialized_size(t* child, const args_t&...args)
+        {
+            return adapt_serialized_size(IsFixedLayout<t>(), args...);
+        }
+        template<typename out_t, typename...args_t>
+        void auto_adapt_serialize(t* child, out_t& out, const args_t&...args)
+        {
+            ProfileScope<t, out_t> scope(out);
+            adapt_serialize(child, out, IsFixedPack<typename SinkFormat<out_t>::type, t>(), args...);
+        }
+        template<typename in_t, typename...args_t>
+        void auto_adapt_deserialize(t* child, in_t& in, args_t&...args)
+        {
+            ProfileScope<t, in_t> scope(in);
+            adapt_deserialize(child, in, IsFixedUnpack<typename in_t::ZnFormat, t>(), args...);
+        }
+        template<typename visitor_t, typename...args_t>
+        void auto_adapt_visit(t* child, visitor_t& visitor, args_t&...args)
+        {
+            zn_serialize::visit_values(visitor, args...);
+        }
+    private:
+        template<typename...args_t>
+        size_t adapt_serialized_size(std::true_type, const args_t&...args)
+        {
+            return FixedLayout<t, FixedFormat>::size;
+        }
+        template<typename...args_t>
+        size_t adapt_serialized_size(std::false_type, const args_t&...args)
+        {
+            return zn_serialize::serialized_size(args...);
+        }
+        template<typename out_t, typename...args_t>
+        void adapt_serialize(t* child, out_t& out, std::true_type, const args_t&...args)
+        {
+            write_fixed(out, *child);
+        }
+        template<typename out_t, typename...args_t>
+        void adapt_serialize(t* child, out_t& out, std::false_type, const args_t&...args)
+        {
+            zn_serialize::serialize_values(out, args...);
+        }
+        template<typename in_t, typename...args_t>
+        void adapt_deserialize(t* child, in_t& in, std::true_type, args_t&...args)
+        {
+            read_fixed(in, *child);
+        }
+        template<typename in_t, typename...args_t>
+        void adapt_deserialize(t* child, in_t& in, std::false_type, args_t&...args)
+        {
+            zn_serialize::deserialize_values(in, args...);
+        }
+    };
+
+    template<typename t>
+    struct AutoAdaptBase<t> : public AutoAdaptRoot<t, DefaultStruct>
+    {};
+
+    template<typename t>
+    struct AutoAdaptBase<t, Struct> : public AutoAdaptRoot<t, Struct>
+    {};
+
+    template<typename t>
+    struct AutoAdaptBase<t, StaticStruct> : public AutoAdaptRoot<t, StaticStruct>
+    {};
+
     template<typename first_member_t, typename...other_members_t>
     struct AssignmentMembers
     {
@@ -471,17 +2814,33 @@ namespace zn_serialize
 #if ZN_VA_OPT_SUPPORTED == 0
 
 #define ZN_STRUCT(name,...)     struct name : public zn_serialize::AutoAdaptBase<name, ##__VA_ARGS__>
-#define ZN_SERIALIZE(...)       void serialize(ZnSerializeBuffer& buffer) const { zn_serialize::cancel_const(this)->auto_adapt_serialize(zn_serialize::cancel_const(this), buffer, ##__VA_ARGS__); }\
+#define ZN_SERIALIZE(...)       size_t serialized_size() const { return zn_serialize::cancel_const(this)->auto_adapt_serialized_size(zn_serialize::cancel_const(this), ##__VA_ARGS__); }\
+                                template<typename out_t> void serialize_to(out_t& out) const { zn_serialize::cancel_const(this)->auto_adapt_serialize(zn_serialize::cancel_const(this), out, ##__VA_ARGS__); }\
+                                template<typename out_t> void serialize(out_t& out) const { zn_serialize::serialize_struct(out, *this); }\
+                                void serialize(ZnSerializeBuffer& buffer) const { zn_serialize::serialize_struct(buffer, *this); }\
                                 void deserialize(const ZnSerializeBuffer& buffer){ deserialize(buffer.data(), buffer.data() + buffer.size()); }\
-                                const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end){ return this->auto_adapt_deserialize(this, begin, end, ##__VA_ARGS__); }\
-                                template<typename...values_t> void znset(const values_t&...other_values){decltype(zn_serialize::get_assignment_members_type(__VA_ARGS__))()(__VA_ARGS__,other_values...);}
+                                const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end){ return zn_serialize::deserialize_struct(begin, end, *this); }\
+                                template<typename in_t> void deserialize_from(in_t& in){ this->auto_adapt_deserialize(this, in, ##__VA_ARGS__); }\
+                                template<typename visitor_t> void visit_members(visitor_t& visitor){ this->auto_adapt_visit(this, visitor, ##__VA_ARGS__); }\
+                                template<typename visitor_t> void visit_members(visitor_t& visitor) const { zn_serialize::cancel_const(this)->auto_adapt_visit(zn_serialize::cancel_const(this), visitor, ##__VA_ARGS__); }\
+                                template<typename...values_t> void znset(const values_t&...other_values){decltype(zn_serialize::get_assignment_members_type(__VA_ARGS__))()(__VA_ARGS__,other_values...);}\
+                                template<typename format_t> static constexpr zn_serialize::FixedLayoutInfo zn_member_layout(){ return zn_serialize::FixedFieldSum<format_t, decltype(zn_serialize::fixed_members(__VA_ARGS__))>::get(); }\
+                                template<typename visitor_t> static void visit_member_types(visitor_t& visitor){ zn_serialize::visit_types(visitor, decltype(zn_serialize::fixed_members(__VA_ARGS__))()); }
 
 #else
 
 #define ZN_STRUCT(name,...)     struct name : public zn_serialize::AutoAdaptBase<name __VA_OPT__(,) __VA_ARGS__>
-#define ZN_SERIALIZE(...)       void serialize(ZnSerializeBuffer& buffer) const { zn_serialize::cancel_const(this)->auto_adapt_serialize(zn_serialize::cancel_const(this), buffer __VA_OPT__(,) __VA_ARGS__); }\
+#define ZN_SERIALIZE(...)       size_t serialized_size() const { return zn_serialize::cancel_const(this)->auto_adapt_serialized_size(zn_serialize::cancel_const(this) __VA_OPT__(,) __VA_ARGS__); }\
+                                template<typename out_t> void serialize_to(out_t& out) const { zn_serialize::cancel_const(this)->auto_adapt_serialize(zn_serialize::cancel_const(this), out __VA_OPT__(,) __VA_ARGS__); }\
+                                template<typename out_t> void serialize(out_t& out) const { zn_serialize::serialize_struct(out, *this); }\
+                                void serialize(ZnSerializeBuffer& buffer) const { zn_serialize::serialize_struct(buffer, *this); }\
                                 void deserialize(const ZnSerializeBuffer& buffer){ deserialize(buffer.data(), buffer.data() + buffer.size()); }\
-                                const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end){ return this->auto_adapt_deserialize(this, begin, end __VA_OPT__(,) __VA_ARGS__); }\
-                                template<typename...values_t> void znset(const values_t&...other_values){decltype(zn_serialize::get_assignment_members_type(__VA_ARGS__))()(__VA_ARGS__ __VA_OPT__(,) other_values...);}
+                                const uint8_t* deserialize(const uint8_t* begin, const uint8_t* end){ return zn_serialize::deserialize_struct(begin, end, *this); }\
+                                template<typename in_t> void deserialize_from(in_t& in){ this->auto_adapt_deserialize(this, in __VA_OPT__(,) __VA_ARGS__); }\
+                                template<typename visitor_t> void visit_members(visitor_t& visitor){ this->auto_adapt_visit(this, visitor __VA_OPT__(,) __VA_ARGS__); }\
+                                template<typename visitor_t> void visit_members(visitor_t& visitor) const { zn_serialize::cancel_const(this)->auto_adapt_visit(zn_serialize::cancel_const(this), visitor __VA_OPT__(,) __VA_ARGS__); }\
+                                template<typename...values_t> void znset(const values_t&...other_values){decltype(zn_serialize::get_assignment_members_type(__VA_ARGS__))()(__VA_ARGS__ __VA_OPT__(,) other_values...);}\
+                                template<typename format_t> static constexpr zn_serialize::FixedLayoutInfo zn_member_layout(){ return zn_serialize::FixedFieldSum<format_t, decltype(zn_serialize::fixed_members(__VA_ARGS__))>::get(); }\
+                                template<typename visitor_t> static void visit_member_types(visitor_t& visitor){ zn_serialize::visit_types(visitor, decltype(zn_serialize::fixed_members(__VA_ARGS__))()); }
 
 #endif
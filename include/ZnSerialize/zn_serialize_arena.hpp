@@ -0,0 +1,157 @@
+/*
+ * 内存池反序列化: 一条消息的字符串与容器节点从同一块连续内存中按指针递增分配, 用完一次性释放
+*/
+#pragma once
+#include "zn_serialize.hpp"
+#include <functional>
+
+namespace zn_serialize
+{
+    // 按指针递增分配, 单独的释放不做任何事, clear或析构时整体释放
+    // 从中分配的对象必须在clear或析构之前销毁
+    class Arena
+    {
+    public:
+        explicit Arena(size_t block_size = 64 * 1024)
+            : block_size_(block_size), cursor_(nullptr), end_(nullptr), used_(0)
+        {}
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+        void* allocate(size_t size, size_t align)
+        {
+            auto p = align_up(cursor_, align);
+            if (!p || size > static_cast<size_t>(end_ - p))
+            {
+                add_block(size + align);
+                p = align_up(cursor_, align);
+            }
+            cursor_ = p + size;
+            used_ += size;
+            return p;
+        }
+        // 释放所有分配的内存, 保留第一块供下一条消息使用
+        void clear()
+        {
+            if (blocks_.size() > 1)
+                blocks_.resize(1);
+            cursor_ = blocks_.empty() ? nullptr : blocks_[0].data;
+            end_ = blocks_.empty() ? nullptr : blocks_[0].data + blocks_[0].size;
+            used_ = 0;
+        }
+        size_t used() const { return used_; }
+        size_t blocks() const { return blocks_.size(); }
+        // 当前线程的ArenaScope指定的内存池, 默认构造的ArenaAllocator从它分配
+        static Arena*& current()
+        {
+            return current_arena();
+        }
+    private:
+        struct Block
+        {
+            std::unique_ptr<uint8_t[]> buffer;
+            uint8_t* data;
+            size_t size;
+        };
+        static uint8_t* align_up(uint8_t* p, size_t align)
+        {
+            if (!p)
+                return nullptr;
+            auto offset = reinterpret_cast<uintptr_t>(p) % align;
+            return offset ? p + (align - offset) : p;
+        }
+        void add_block(size_t size)
+        {
+            if (size < block_size_)
+                size = block_size_;
+            Block block;
+            block.buffer.reset(new uint8_t[size]);
+            block.data = block.buffer.get();
+            block.size = size;
+            cursor_ = block.data;
+            end_ = block.data + size;
+            blocks_.push_back(std::move(block));
+        }
+        size_t block_size_;
+        std::vector<Block> blocks_;
+        uint8_t* cursor_;
+        uint8_t* end_;
+        size_t used_;
+    };
+
+    // 在作用域内把arena设为当前线程的内存池, 作用域内构造的arena容器都从它分配
+    class ArenaScope
+    {
+    public:
+        explicit ArenaScope(Arena& arena)
+            : previous_(Arena::current())
+        {
+            Arena::current() = &arena;
+        }
+        ArenaScope(const ArenaScope&) = delete;
+        ArenaScope& operator=(const ArenaScope&) = delete;
+        ~ArenaScope()
+        {
+            Arena::current() = previous_;
+        }
+    private:
+        Arena* previous_;
+    };
+
+    // 从Arena分配的分配器, 构造时没有内存池则使用全局的new/delete
+    // 拷贝容器时不沿用原容器的内存池, 而是使用拷贝时当前线程的内存池, 拷贝出的对象不会引用已释放的内存池
+    template<typename t>
+    class ArenaAllocator
+    {
+    public:
+        typedef t value_type;
+        template<typename u> struct rebind { typedef ArenaAllocator<u> other; };
+        ArenaAllocator()
+            : arena_(Arena::current())
+        {}
+        explicit ArenaAllocator(Arena* arena)
+            : arena_(arena)
+        {}
+        template<typename u>
+        ArenaAllocator(const ArenaAllocator<u>& o)
+            : arena_(o.arena())
+        {}
+        t* allocate(size_t n)
+        {
+            if (arena_)
+                return static_cast<t*>(arena_->allocate(n * sizeof(t), std::alignment_of<t>::value));
+            return static_cast<t*>(::operator new(n * sizeof(t)));
+        }
+        void deallocate(t* p, size_t n)
+        {
+            if (!arena_)
+                ::operator delete(p);
+        }
+        ArenaAllocator select_on_container_copy_construction() const { return ArenaAllocator(); }
+        Arena* arena() const { return arena_; }
+    private:
+        Arena* arena_;
+    };
+
+    template<typename t, typename u>
+    inline bool operator==(const ArenaAllocator<t>& a, const ArenaAllocator<u>& b) { return a.arena() == b.arena(); }
+    template<typename t, typename u>
+    inline bool operator!=(const ArenaAllocator<t>& a, const ArenaAllocator<u>& b) { return a.arena() != b.arena(); }
+
+    // 使用ArenaAllocator的字符串与容器, 可以直接作为ZN_SERIALIZE的成员
+    namespace arena
+    {
+        typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> string;
+        typedef std::basic_string<wchar_t, std::char_traits<wchar_t>, ArenaAllocator<wchar_t>> wstring;
+        template<typename t> using vector = std::vector<t, ArenaAllocator<t>>;
+        template<typename t> using deque = std::deque<t, ArenaAllocator<t>>;
+        template<typename t> using list = std::list<t, ArenaAllocator<t>>;
+        template<typename t, typename c = std::less<t>> using set = std::set<t, c, ArenaAllocator<t>>;
+        template<typename t, typename c = std::less<t>> using multiset = std::multiset<t, c, ArenaAllocator<t>>;
+        template<typename k, typename t, typename c = std::less<k>> using map = std::map<k, t, c, ArenaAllocator<std::pair<const k, t>>>;
+        template<typename k, typename t, typename c = std::less<k>> using multimap = std::multimap<k, t, c, ArenaAllocator<std::pair<const k, t>>>;
+        template<typename t, typename h = std::hash<t>, typename e = std::equal_to<t>> using unordered_set = std::unordered_set<t, h, e, ArenaAllocator<t>>;
+        template<typename t, typename h = std::hash<t>, typename e = std::equal_to<t>> using unordered_multiset = std::unordered_multiset<t, h, e, ArenaAllocator<t>>;
+        template<typename k, typename t, typename h = std::hash<k>, typename e = std::equal_to<k>> using unordered_map = std::unordered_map<k, t, h, e, ArenaAllocator<std::pair<const k, t>>>;
+        template<typename k, typename t, typename h = std::hash<k>, typename e = std::equal_to<k>> using unordered_multimap = std::unordered_multimap<k, t, h, e, ArenaAllocator<std::pair<const k, t>>>;
+    }
+};
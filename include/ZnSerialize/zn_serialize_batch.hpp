@@ -0,0 +1,217 @@
+/*
+ * 批量序列化: 大量互相独立的消息在线程池上并行编解码
+ * 帧格式: 每条消息前加uint32_t的消息长度, 依次连续存放
+*/
+#pragma once
+#include "zn_serialize.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <thread>
+
+namespace zn_serialize
+{
+    // 固定数量的工作线程, 多次批量调用之间复用, 也可以用于deserialize_parallel
+    class WorkerPool : public ParallelRunner
+    {
+    public:
+        // threads为参与计算的线程总数(包括调用线程)
+        explicit WorkerPool(size_t threads = std::thread::hardware_concurrency())
+            : stop_(false), generation_(0)
+        {
+            for (size_t i = 1; i < threads; ++i)
+                threads_.emplace_back([this] { work(); });
+        }
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+        ~WorkerPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            wake_.notify_all();
+            for (auto& thread : threads_)
+                thread.join();
+        }
+        size_t size() const { return threads_.size() + 1; }
+        // 把[0, count)分段后并行执行fn(begin, end), 调用线程也参与, 全部完成后返回
+        // fn抛出的异常在所有分段结束后重新抛出(只保留第一个)
+        void run(size_t count, const std::function<void(size_t, size_t)>& fn) override
+        {
+            if (count == 0)
+                return;
+            if (threads_.empty() || count == 1)
+            {
+                fn(0, count);
+                return;
+            }
+            std::lock_guard<std::mutex> run_lock(run_mutex_);
+            // 分段比线程数多一些, 各段耗时不均时也能分摊
+            size_t chunks = size() * 4 < count ? size() * 4 : count;
+            auto job = std::make_shared<Job>(fn, count, chunks);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                job_ = job;
+                ++generation_;
+            }
+            wake_.notify_all();
+            execute(*job);
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                finish_.wait(lock, [&] { return job->done == job->chunks; });
+                job_.reset();
+            }
+            if (job->error)
+                std::rethrow_exception(job->error);
+        }
+    private:
+        struct Job
+        {
+            Job(const std::function<void(size_t, size_t)>& fn, size_t count, size_t chunks)
+                : fn(fn), count(count), chunks(chunks), next(0), done(0)
+            {}
+            const std::function<void(size_t, size_t)>& fn;
+            size_t count;
+            size_t chunks;
+            std::atomic<size_t> next;
+            std::atomic<size_t> done;
+            std::mutex error_mutex;
+            std::exception_ptr error;
+        };
+
+        void execute(Job& job)
+        {
+            for (;;)
+            {
+                size_t i = job.next++;
+                if (i >= job.chunks)
+                    return;
+                try
+                {
+                    job.fn(job.count * i / job.chunks, job.count * (i + 1) / job.chunks);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(job.error_mutex);
+                    if (!job.error)
+                        job.error = std::current_exception();
+                }
+                if (++job.done == job.chunks)
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    finish_.notify_all();
+                }
+            }
+        }
+
+        void work()
+        {
+            size_t generation = 0;
+            for (;;)
+            {
+                std::shared_ptr<Job> job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    wake_.wait(lock, [&] { return stop_ || (job_ && generation_ != generation); });
+                    if (stop_)
+                        return;
+                    generation = generation_;
+                    job = job_;
+                }
+                execute(*job);
+            }
+        }
+
+        std::vector<std::thread> threads_;
+        std::mutex run_mutex_;
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::condition_variable finish_;
+        bool stop_;
+        size_t generation_;
+        std::shared_ptr<Job> job_;
+    };
+
+    // 先并行计算每条消息的长度, 得到各帧的偏移后一次性分配, 再并行写入互不重叠的区间
+    // [first, last)为ZN_STRUCT的随机访问序列, 结果追加到out末尾
+    template<typename iterator_t>
+    inline void serialize_batch(WorkerPool& pool, iterator_t first, iterator_t last, ZnSerializeBuffer& out)
+    {
+        typedef typename std::iterator_traits<iterator_t>::value_type t;
+        size_t count = static_cast<size_t>(last - first);
+        std::vector<size_t> offsets(count + 1);
+        pool.run(count, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                offsets[i + 1] = sizeof(uint32_t) + message_size(first[i]);
+        });
+        offsets[0] = out.size();
+        for (size_t i = 0; i < count; ++i)
+            offsets[i + 1] += offsets[i];
+        out.resize(offsets[count]);
+        pool.run(count, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                CursorSink cursor(out.data() + offsets[i]);
+                write_size(cursor, static_cast<uint32_t>(offsets[i + 1] - offsets[i] - sizeof(uint32_t)));
+                FormatSink<typename t::ZnFormat, CursorSink> sink(cursor);
+                first[i].serialize_to(sink);
+            }
+        });
+    }
+
+    // 每条消息写入各自的缓冲区, 结果追加到out末尾
+    template<typename iterator_t>
+    inline void serialize_batch(WorkerPool& pool, iterator_t first, iterator_t last, std::vector<ZnSerializeBuffer>& out)
+    {
+        size_t count = static_cast<size_t>(last - first);
+        size_t offset = out.size();
+        out.resize(offset + count);
+        pool.run(count, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                first[i].serialize(out[offset + i]);
+        });
+    }
+
+    // 按帧头拆分出每条消息的字节范围
+    inline void split_frames(const uint8_t* begin, const uint8_t* end, std::vector<std::pair<const uint8_t*, const uint8_t*>>& frames)
+    {
+        Reader<> in(begin, end);
+        while (in.cursor != in.end)
+        {
+            uint32_t size = read_size(in, "deserialize batch failed, out of memery");
+            auto p = read_bytes(in, size, "deserialize batch failed, out of memery");
+            frames.push_back(std::make_pair(p, p + size));
+        }
+    }
+
+    // 拆分帧后并行解码, 每帧解码为out末尾新增的一个对象
+    template<typename t>
+    inline void deserialize_batch(WorkerPool& pool, const uint8_t* begin, const uint8_t* end, std::vector<t>& out)
+    {
+        std::vector<std::pair<const uint8_t*, const uint8_t*>> frames;
+        split_frames(begin, end, frames);
+        size_t offset = out.size();
+        out.resize(offset + frames.size());
+        pool.run(frames.size(), [&](size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; ++i)
+            {
+                if (out[offset + i].deserialize(frames[i].first, frames[i].second) != frames[i].second)
+                    throw Exception("deserialize batch failed, frame size mismatch");
+            }
+        });
+    }
+
+    template<typename t>
+    inline void deserialize_batch(WorkerPool& pool, const ZnSerializeBuffer& in, std::vector<t>& out)
+    {
+        deserialize_batch(pool, in.data(), in.data() + in.size(), out);
+    }
+};
@@ -0,0 +1,415 @@
+/*
+ * 帧校验: 消息之后附加CRC32C校验值, 解码前先校验, 损坏的数据不会进入解码
+ * 帧格式: 消息字节(按结构体声明的格式) + uint32_t CRC32C(小端序)
+ * 校验值在编码的同时按小块累加(数据仍在L1缓存中), 不需要编码后再遍历一次输出
+ * x86上运行时检测到SSE4.2时使用crc32指令, 编译目标支持ARMv8 CRC扩展时使用crc32c指令, 都按3段并行计算后合并
+ * 否则使用按8字节查表的软件实现
+*/
+#pragma once
+#include "zn_serialize.hpp"
+#include <cstddef>
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define ZN_SERIALIZE_CRC32C_X86 1
+#include <nmmintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define ZN_SERIALIZE_CRC32C_TARGET
+#else
+#define ZN_SERIALIZE_CRC32C_TARGET __attribute__((target("sse4.2")))
+#endif
+#elif defined(__ARM_FEATURE_CRC32)
+#define ZN_SERIALIZE_CRC32C_ARM 1
+#include <arm_acle.h>
+#endif
+
+namespace zn_serialize
+{
+    // 反射多项式0x82F63B78, 8张256项的表, 每次处理8个字节
+    struct Crc32cTable
+    {
+        uint32_t table[8][256];
+        Crc32cTable()
+        {
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; ++bit)
+                    crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+                table[0][i] = crc;
+            }
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                for (int k = 1; k < 8; ++k)
+                    table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+            }
+        }
+        static const Crc32cTable& instance()
+        {
+            static const Crc32cTable v;
+            return v;
+        }
+    };
+
+    inline uint32_t load_crc_word(const uint8_t* p)
+    {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return ZN_SERIALIZE_BIG_ENDIAN ? byte_swap(v) : v;
+    }
+
+    // 软件实现, crc为未取反的中间值
+    inline uint32_t crc32c_software(uint32_t crc, const uint8_t* p, size_t size)
+    {
+        const auto& t = Crc32cTable::instance().table;
+        for (; size >= 8; size -= 8, p += 8)
+        {
+            uint32_t low = load_crc_word(p) ^ crc;
+            uint32_t high = load_crc_word(p + 4);
+            crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24]
+                ^ t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^ t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+        }
+        for (; size; --size, ++p)
+            crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xFF];
+        return crc;
+    }
+
+    // 把校验值移过len个0字节, 即乘以x^(8 * len) mod P; 乘数固定, 按字节拆成4张表
+    // 硬件实现把数据分为3段并行计算(crc指令的延迟为3个周期, 每周期可以发出一条), 再用它合并
+    struct Crc32cShift
+    {
+        static const size_t Lane = 256;
+        uint32_t table[4][256];
+        Crc32cShift()
+        {
+            uint32_t k = 0x80000000;
+            for (size_t i = 0; i < Lane * 8; ++i)
+                k = k & 1 ? (k >> 1) ^ 0x82F63B78 : k >> 1;
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                for (uint32_t b = 0; b < 256; ++b)
+                    table[i][b] = multiply(b << (i * 8), k);
+            }
+        }
+        // GF(2)上的多项式乘法 a * b mod P(反射表示)
+        static uint32_t multiply(uint32_t a, uint32_t b)
+        {
+            uint32_t product = 0;
+            for (uint32_t m = 0x80000000; m && a; m >>= 1)
+            {
+                if (a & m)
+                {
+                    product ^= b;
+                    a ^= m;
+                }
+                b = b & 1 ? (b >> 1) ^ 0x82F63B78 : b >> 1;
+            }
+            return product;
+        }
+        uint32_t shift(uint32_t crc) const
+        {
+            return table[0][crc & 0xFF] ^ table[1][(crc >> 8) & 0xFF] ^ table[2][(crc >> 16) & 0xFF] ^ table[3][crc >> 24];
+        }
+        static const Crc32cShift& instance()
+        {
+            static const Crc32cShift v;
+            return v;
+        }
+    };
+
+#if defined(ZN_SERIALIZE_CRC32C_X86)
+    inline bool crc32c_hardware_supported()
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 20)) != 0;
+#else
+        return __builtin_cpu_supports("sse4.2") != 0;
+#endif
+    }
+
+    ZN_SERIALIZE_CRC32C_TARGET inline uint32_t crc32c_hardware(uint32_t crc, const uint8_t* p, size_t size)
+    {
+#if defined(__x86_64__) || defined(_M_X64)
+        const size_t lane = Crc32cShift::Lane;
+        if (size >= lane * 3)
+        {
+            const Crc32cShift& shift = Crc32cShift::instance();
+            for (; size >= lane * 3; size -= lane * 3, p += lane * 3)
+            {
+                uint64_t a = crc, b = 0, c = 0;
+                for (size_t i = 0; i < lane; i += 8)
+                {
+                    uint64_t x, y, z;
+                    memcpy(&x, p + i, sizeof(x));
+                    memcpy(&y, p + lane + i, sizeof(y));
+                    memcpy(&z, p + lane * 2 + i, sizeof(z));
+                    a = _mm_crc32_u64(a, x);
+                    b = _mm_crc32_u64(b, y);
+                    c = _mm_crc32_u64(c, z);
+                }
+                crc = shift.shift(shift.shift(static_cast<uint32_t>(a)) ^ static_cast<uint32_t>(b)) ^ static_cast<uint32_t>(c);
+            }
+        }
+        uint64_t crc64 = crc;
+        for (; size >= 8; size -= 8, p += 8)
+        {
+            uint64_t v;
+            memcpy(&v, p, sizeof(v));
+            crc64 = _mm_crc32_u64(crc64, v);
+        }
+        crc = static_cast<uint32_t>(crc64);
+#endif
+        for (; size >= 4; size -= 4, p += 4)
+        {
+            uint32_t v;
+            memcpy(&v, p, sizeof(v));
+            crc = _mm_crc32_u32(crc, v);
+        }
+        for (; size; --size, ++p)
+            crc = _mm_crc32_u8(crc, *p);
+        return crc;
+    }
+#elif defined(ZN_SERIALIZE_CRC32C_ARM)
+    inline bool crc32c_hardware_supported()
+    {
+        return true;
+    }
+
+    inline uint32_t crc32c_hardware(uint32_t crc, const uint8_t* p, size_t size)
+    {
+        const size_t lane = Crc32cShift::Lane;
+        if (size >= lane * 3)
+        {
+            const Crc32cShift& shift = Crc32cShift::instance();
+            for (; size >= lane * 3; size -= lane * 3, p += lane * 3)
+            {
+                uint32_t a = crc, b = 0, c = 0;
+                for (size_t i = 0; i < lane; i += 8)
+                {
+                    uint64_t x, y, z;
+                    memcpy(&x, p + i, sizeof(x));
+                    memcpy(&y, p + lane + i, sizeof(y));
+                    memcpy(&z, p + lane * 2 + i, sizeof(z));
+                    a = __crc32cd(a, x);
+                    b = __crc32cd(b, y);
+                    c = __crc32cd(c, z);
+                }
+                crc = shift.shift(shift.shift(a) ^ b) ^ c;
+            }
+        }
+        for (; size >= 8; size -= 8, p += 8)
+        {
+            uint64_t v;
+            memcpy(&v, p, sizeof(v));
+            crc = __crc32cd(crc, v);
+        }
+        for (; size; --size, ++p)
+            crc = __crc32cb(crc, *p);
+        return crc;
+    }
+#else
+    inline bool crc32c_hardware_supported()
+    {
+        return false;
+    }
+
+    inline uint32_t crc32c_hardware(uint32_t crc, const uint8_t* p, size_t size)
+    {
+        return crc32c_software(crc, p, size);
+    }
+#endif
+
+    // 计算CRC32C, crc为之前数据的校验值, 可以分段累加: crc32c(crc32c(0, a, n), b, m) == crc32c(0, ab, n + m)
+    inline uint32_t crc32c(uint32_t crc, const void* data, size_t size)
+    {
+        static const bool hardware = crc32c_hardware_supported();
+        auto p = static_cast<const uint8_t*>(data);
+        crc = ~crc;
+        crc = hardware ? crc32c_hardware(crc, p, size) : crc32c_software(crc, p, size);
+        return ~crc;
+    }
+
+    // 转发写入到sink, 同时累加写入内容的校验值
+    // 编码产生大量很短的写入, 先攒到栈上的小块中, 攒满后对整块计算校验值再一次写入sink, 数据仍在L1缓存中
+    // 写完后调用finish()写出剩余的数据并得到校验值
+    template<typename sink_t>
+    class ChecksumSink
+    {
+    public:
+        typedef typename SinkFormat<sink_t>::type ZnFormat;
+        static const size_t BlockSize = Crc32cShift::Lane * 6;
+        explicit ChecksumSink(sink_t& sink, uint32_t crc = 0)
+            : sink_(sink), crc_(crc), written_(0), used_(0)
+        {}
+        void reserve(size_t size)
+        {
+            reserve_bytes(sink_, size);
+        }
+        // 常见的短写入只拷贝到小块中, 保持足够短以便内联到各个调用处
+        void write(const void* data, size_t size)
+        {
+            if (used_ + size <= BlockSize)
+            {
+                memcpy(block_ + used_, data, size);
+                used_ += size;
+                return;
+            }
+            write_block(data, size);
+        }
+        uint32_t finish()
+        {
+            flush();
+            return crc_;
+        }
+        size_t size() const { return written_ + used_; }
+        sink_t& sink() const { return sink_; }
+    private:
+        void flush()
+        {
+            if (!used_)
+                return;
+            crc_ = crc32c(crc_, block_, used_);
+            write_bytes(sink_, block_, used_);
+            written_ += used_;
+            used_ = 0;
+        }
+        void write_block(const void* data, size_t size)
+        {
+            flush();
+            if (size < BlockSize)
+            {
+                memcpy(block_, data, size);
+                used_ = size;
+                return;
+            }
+            crc_ = crc32c(crc_, data, size);
+            write_bytes(sink_, data, size);
+            written_ += size;
+        }
+        sink_t& sink_;
+        uint32_t crc_;
+        size_t written_;
+        size_t used_;
+        uint8_t block_[BlockSize];
+    };
+
+    // 直接写入内存时不需要中转, 写入后每满4KB对刚写入的部分计算校验值
+    template<>
+    class ChecksumSink<CursorSink>
+    {
+    public:
+        typedef FixedFormat ZnFormat;
+        static const size_t BlockSize = 4096;
+        explicit ChecksumSink(CursorSink& sink, uint32_t crc = 0)
+            : sink_(sink), crc_(crc), begin_(sink.cursor()), pending_(sink.cursor())
+        {}
+        void reserve(size_t size)
+        {}
+        void write(const void* data, size_t size)
+        {
+            sink_.write(data, size);
+            if (static_cast<size_t>(sink_.cursor() - pending_) >= BlockSize)
+                flush();
+        }
+        uint32_t finish()
+        {
+            flush();
+            return crc_;
+        }
+        size_t size() const { return static_cast<size_t>(sink_.cursor() - begin_); }
+        CursorSink& sink() const { return sink_; }
+    private:
+        void flush()
+        {
+            crc_ = crc32c(crc_, pending_, static_cast<size_t>(sink_.cursor() - pending_));
+            pending_ = sink_.cursor();
+        }
+        CursorSink& sink_;
+        uint32_t crc_;
+        const uint8_t* begin_;
+        const uint8_t* pending_;
+    };
+
+    inline void store_checksum(uint8_t* p, uint32_t crc)
+    {
+        for (size_t i = 0; i < sizeof(crc); ++i)
+            p[i] = static_cast<uint8_t>(crc >> (i * 8));
+    }
+
+    inline uint32_t load_checksum(const uint8_t* p)
+    {
+        uint32_t crc = 0;
+        for (size_t i = 0; i < sizeof(crc); ++i)
+            crc |= static_cast<uint32_t>(p[i]) << (i * 8);
+        return crc;
+    }
+
+    template<typename t, typename out_t>
+    inline void append_checked(const t& v, out_t& out)
+    {
+        FormatSink<typename t::ZnFormat, out_t> format(out);
+        ChecksumSink<FormatSink<typename t::ZnFormat, out_t>> sink(format);
+        v.serialize_to(sink);
+        uint8_t trailer[sizeof(uint32_t)];
+        store_checksum(trailer, sink.finish());
+        write_bytes(out, trailer, sizeof(trailer));
+    }
+
+    template<typename t>
+    inline void serialize_checked(const t& v, ZnSerializeBuffer& out, std::true_type)
+    {
+        // 定长格式先按长度一次扩容, 再直接写入
+        size_t offset = out.size();
+        size_t size = v.t::serialized_size();
+        out.resize(offset + size + sizeof(uint32_t));
+        CursorSink cursor(out.data() + offset);
+        ChecksumSink<CursorSink> sink(cursor);
+        v.serialize_to(sink);
+        uint32_t crc = sink.finish();
+        store_checksum(out.data() + offset + size, crc);
+    }
+
+    template<typename t>
+    inline void serialize_checked(const t& v, ZnSerializeBuffer& out, std::false_type)
+    {
+        append_checked(v, out);
+    }
+
+    // 按结构体声明的格式编码并在末尾附加校验值, 写入任意输出端
+    template<typename t, typename out_t>
+    inline void serialize_checked(const t& v, out_t& out)
+    {
+        append_checked(v, out);
+    }
+
+    template<typename t>
+    inline void serialize_checked(const t& v, ZnSerializeBuffer& out)
+    {
+        serialize_checked(v, out, std::is_same<typename t::ZnFormat, FixedFormat>());
+    }
+
+    // 帧[begin, end)的校验值是否正确
+    inline bool checksum_valid(const uint8_t* begin, const uint8_t* end)
+    {
+        if (end - begin < static_cast<ptrdiff_t>(sizeof(uint32_t)))
+            return false;
+        return crc32c(0, begin, static_cast<size_t>(end - begin) - sizeof(uint32_t)) == load_checksum(end - sizeof(uint32_t));
+    }
+
+    // 先校验整个帧, 校验失败或消息没有正好用完帧时抛出异常
+    template<typename t>
+    inline void deserialize_checked(const uint8_t* begin, const uint8_t* end, t& v)
+    {
+        if (!checksum_valid(begin, end))
+            throw Exception("deserialize failed, checksum mismatch");
+        if (v.deserialize(begin, end - sizeof(uint32_t)) != end - sizeof(uint32_t))
+            throw Exception("deserialize failed, message size mismatch");
+    }
+
+    template<typename t>
+    inline void deserialize_checked(const ZnSerializeBuffer& in, t& v)
+    {
+        deserialize_checked(in.data(), in.data() + in.size(), v);
+    }
+};
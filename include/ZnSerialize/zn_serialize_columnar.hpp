@@ -0,0 +1,308 @@
+/*
+ * 列式编码: ZN_STRUCT的序列按ZN_SERIALIZE的成员逐列存放, 同一成员的值连续排列, 便于压缩与按列扫描
+ * 格式: 行数, 之后按成员的顺序(先基类再成员)依次为每一列, 长度前缀与数值的编码跟随结构体声明的格式
+ *   可以整块拷贝的成员(数值, 枚举, 数值数组)   所有行的值依次存放, 按块收集后整块写入
+ *   std::string                               标记0 + 逐行的字符串; 不同的值不超过行数的一半时为标记1 + 字典 + 逐行的字典序号
+ *   嵌套的结构体                               按它的成员继续拆分为列
+ *   其他类型                                   逐行按普通格式写入
+*/
+#pragma once
+#include "zn_serialize.hpp"
+#include <functional>
+#include <unordered_map>
+
+namespace zn_serialize
+{
+    const uint32_t ColumnPlain = 0;
+    const uint32_t ColumnDictionary = 1;
+    const size_t ColumnBlockSize = 4096;
+    // 没有任何列的行不占字节, 无法用剩余长度检查行数, 只能限制一个上限
+    const size_t ColumnEmptyRowLimit = 1 << 20;
+
+    struct ColumnBulkTag {};
+    struct ColumnStringTag {};
+    struct ColumnStructTag {};
+    struct ColumnValueTag {};
+
+    template<typename format_t, typename t> struct ColumnTag
+    {
+        typedef typename std::conditional<IsZnStruct<t>::value, ColumnStructTag,
+            typename std::conditional<IsBulkFor<format_t, t>::value, ColumnBulkTag, ColumnValueTag>::type>::type type;
+    };
+    template<typename format_t> struct ColumnTag<format_t, std::string> { typedef ColumnStringTag type; };
+
+    // 一列由第一行中成员的地址与行的间隔确定, 第i行的值位于first + i * stride
+    template<typename t>
+    inline const t& column_at(const t* first, size_t stride, size_t i)
+    {
+        return *reinterpret_cast<const t*>(reinterpret_cast<const char*>(first) + i * stride);
+    }
+
+    template<typename t>
+    inline t& column_at(t* first, size_t stride, size_t i)
+    {
+        return *reinterpret_cast<t*>(reinterpret_cast<char*>(first) + i * stride);
+    }
+
+    // 数值每次收集一块后整块写入, 可移植格式在大端机器上按块交换字节序
+    template<typename t> struct ColumnBlock { static const size_t count = sizeof(t) < ColumnBlockSize ? ColumnBlockSize / sizeof(t) : 1; };
+
+    template<typename out_t, typename t>
+    inline void write_column(out_t& out, const t* first, size_t stride, size_t count, ColumnBulkTag)
+    {
+        t block[ColumnBlock<t>::count];
+        for (size_t i = 0; i < count;)
+        {
+            size_t n = count - i < ColumnBlock<t>::count ? count - i : ColumnBlock<t>::count;
+            for (size_t j = 0; j < n; ++j, ++i)
+                memcpy(&block[j], &column_at(first, stride, i), sizeof(t));
+            write_bulk(out, block, n);
+        }
+    }
+
+    template<typename format_t, typename t>
+    inline void read_column(Reader<format_t>& in, t* first, size_t stride, size_t count, ColumnBulkTag)
+    {
+        if (count > in.remain() / sizeof(t))
+            throw Exception("deserialize columns failed, out of memery");
+        t block[ColumnBlock<t>::count];
+        for (size_t i = 0; i < count;)
+        {
+            size_t n = count - i < ColumnBlock<t>::count ? count - i : ColumnBlock<t>::count;
+            read_bulk(in, block, n);
+            for (size_t j = 0; j < n; ++j, ++i)
+                memcpy(&column_at(first, stride, i), &block[j], sizeof(t));
+        }
+    }
+
+    template<typename out_t, typename t>
+    inline void write_column(out_t& out, const t* first, size_t stride, size_t count, ColumnValueTag)
+    {
+        for (size_t i = 0; i < count; ++i)
+            serialize(out, column_at(first, stride, i));
+    }
+
+    template<typename format_t, typename t>
+    inline void read_column(Reader<format_t>& in, t* first, size_t stride, size_t count, ColumnValueTag)
+    {
+        for (size_t i = 0; i < count; ++i)
+            deserialize(in, column_at(first, stride, i));
+    }
+
+    // 字典按字符串内容查找, 键指向行中的字符串, 不拷贝
+    struct ColumnStringHash
+    {
+        size_t operator()(const std::string* v) const { return std::hash<std::string>()(*v); }
+    };
+
+    struct ColumnStringEqual
+    {
+        bool operator()(const std::string* a, const std::string* b) const { return *a == *b; }
+    };
+
+    // 不同的值超过行数的一半时放弃字典, 逐行写入
+    template<typename out_t>
+    inline void write_column(out_t& out, const std::string* first, size_t stride, size_t count, ColumnStringTag)
+    {
+        std::unordered_map<const std::string*, uint32_t, ColumnStringHash, ColumnStringEqual> ids;
+        std::vector<const std::string*> dictionary;
+        std::vector<uint32_t> indices;
+        indices.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const std::string* v = &column_at(first, stride, i);
+            auto it = ids.find(v);
+            if (it == ids.end())
+            {
+                if (dictionary.size() >= count / 2)
+                {
+                    write_size(out, ColumnPlain);
+                    write_column(out, first, stride, count, ColumnValueTag());
+                    return;
+                }
+                it = ids.emplace(v, static_cast<uint32_t>(dictionary.size())).first;
+                dictionary.push_back(v);
+            }
+            indices.push_back(it->second);
+        }
+        write_size(out, ColumnDictionary);
+        write_size(out, static_cast<uint32_t>(dictionary.size()));
+        for (auto v : dictionary)
+            serialize(out, *v);
+        for (auto index : indices)
+            write_size(out, index);
+    }
+
+    template<typename format_t>
+    inline void read_column(Reader<format_t>& in, std::string* first, size_t stride, size_t count, ColumnStringTag)
+    {
+        uint32_t mode = read_size(in, "deserialize columns failed, out of memery");
+        if (mode == ColumnPlain)
+            return read_column(in, first, stride, count, ColumnValueTag());
+        if (mode != ColumnDictionary)
+            throw Exception("deserialize columns failed, unknown string column");
+        uint32_t size = read_size(in, "deserialize columns failed, out of memery");
+        if (size > in.remain())
+            throw Exception("deserialize columns failed, out of memery");
+        std::vector<std::string> dictionary(size);
+        for (auto& v : dictionary)
+            deserialize(in, v);
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t index = read_size(in, "deserialize columns failed, out of memery");
+            if (index >= size)
+                throw Exception("deserialize columns failed, invalid dictionary index");
+            column_at(first, stride, i) = dictionary[index];
+        }
+    }
+
+    template<typename out_t>
+    struct ColumnWriteVisitor
+    {
+        out_t& out;
+        size_t stride;
+        size_t count;
+        template<typename m>
+        void operator()(const m& v)
+        {
+            write_column(out, std::addressof(v), stride, count, typename ColumnTag<typename SinkFormat<out_t>::type, m>::type());
+        }
+    };
+
+    template<typename format_t>
+    struct ColumnReadVisitor
+    {
+        Reader<format_t>& in;
+        size_t stride;
+        size_t count;
+        template<typename m>
+        void operator()(m& v)
+        {
+            read_column(in, std::addressof(v), stride, count, typename ColumnTag<format_t, m>::type());
+        }
+    };
+
+    // 嵌套的结构体: 第一行中各成员的地址即为各列的起始位置, 行的间隔不变
+    template<typename out_t, typename t>
+    inline void write_column(out_t& out, const t* first, size_t stride, size_t count, ColumnStructTag)
+    {
+        ColumnWriteVisitor<out_t> visitor = { out, stride, count };
+        first->visit_members(visitor);
+    }
+
+    template<typename format_t, typename t>
+    inline void read_column(Reader<format_t>& in, t* first, size_t stride, size_t count, ColumnStructTag)
+    {
+        ColumnReadVisitor<format_t> visitor = { in, stride, count };
+        first->visit_members(visitor);
+    }
+
+    // 结构体拆分后的列数, 每一列每行至少占一个字节, 用于在分配行之前检查行数
+    template<typename t> inline size_t column_leaves(const t& v, std::false_type) { return 1; }
+    template<typename t> inline size_t column_leaves(const t& v, std::true_type);
+
+    struct ColumnLeafVisitor
+    {
+        size_t count;
+        template<typename m>
+        void operator()(const m& v)
+        {
+            count += column_leaves(v, IsZnStruct<m>());
+        }
+    };
+
+    template<typename t>
+    inline size_t column_leaves(const t& v, std::true_type)
+    {
+        ColumnLeafVisitor visitor = { 0 };
+        v.visit_members(visitor);
+        return visitor.count;
+    }
+
+    template<typename out_t, typename t, typename a>
+    inline void write_columns(out_t& out, const std::vector<t, a>& rows)
+    {
+        static_assert(IsZnStruct<t>::value, "columnar encoding only supports ZN_STRUCT rows");
+        if (rows.size() > std::numeric_limits<uint32_t>::max())
+            throw Exception("serialize columns failed, too many rows");
+        write_size(out, static_cast<uint32_t>(rows.size()));
+        if (!rows.empty())
+            write_column(out, rows.data(), sizeof(t), rows.size(), ColumnStructTag());
+    }
+
+    // 行追加到rows末尾, 复用模式下先清空
+    template<typename format_t, typename t, typename a>
+    inline void read_columns(Reader<format_t>& in, std::vector<t, a>& rows)
+    {
+        static_assert(IsZnStruct<t>::value, "columnar encoding only supports ZN_STRUCT rows");
+        static const size_t leaves = column_leaves(t(), std::true_type());
+        uint32_t count = read_size(in, "deserialize columns failed, out of memery");
+        if (in.reuse)
+            rows.clear();
+        if (!count)
+            return;
+        if (count > (leaves ? in.remain() : ColumnEmptyRowLimit))
+            throw Exception("deserialize columns failed, out of memery");
+        size_t offset = rows.size();
+        rows.resize(offset + count);
+        read_column(in, rows.data() + offset, sizeof(t), count, ColumnStructTag());
+    }
+
+    // 按结构体声明的格式把rows按列编码, 写入任意输出端
+    template<typename t, typename a, typename out_t>
+    inline void serialize_columns(const std::vector<t, a>& rows, out_t& out)
+    {
+        FormatSink<typename t::ZnFormat, out_t> sink(out);
+        write_columns(sink, rows);
+    }
+
+    template<typename t, typename a>
+    inline const uint8_t* deserialize_columns(const uint8_t* begin, const uint8_t* end, std::vector<t, a>& rows)
+    {
+        Reader<typename t::ZnFormat> in(begin, end);
+        read_columns(in, rows);
+        return in.cursor;
+    }
+
+    template<typename t, typename a>
+    inline const uint8_t* deserialize_columns(const ZnSerializeBuffer& in, std::vector<t, a>& rows)
+    {
+        return deserialize_columns(in.data(), in.data() + in.size(), rows);
+    }
+
+    // 按列编码的std::vector, 可以作为ZN_STRUCT的成员, 跟随外层的格式
+    template<typename t, typename a = std::allocator<t>>
+    class ColumnVector : public std::vector<t, a>
+    {
+    public:
+        using std::vector<t, a>::vector;
+        ColumnVector()
+        {}
+        ColumnVector(const std::vector<t, a>& v)
+            : std::vector<t, a>(v)
+        {}
+        ColumnVector(std::vector<t, a>&& v)
+            : std::vector<t, a>(std::move(v))
+        {}
+    };
+
+    template<typename t, typename a>
+    inline size_t serialized_size(const ColumnVector<t, a>& v)
+    {
+        CountSink<> count;
+        write_columns(count, v);
+        return count.size();
+    }
+
+    template<typename out_t, typename t, typename a>
+    inline void serialize(out_t& out, const ColumnVector<t, a>& v)
+    {
+        write_columns(out, v);
+    }
+
+    template<typename format_t, typename t, typename a>
+    inline void deserialize(Reader<format_t>& in, ColumnVector<t, a>& v)
+    {
+        read_columns(in, v);
+    }
+};
@@ -0,0 +1,385 @@
+/*
+ * 块压缩: 序列化之后压缩, 反序列化之前解压, 不依赖第三方库
+ * 帧格式: uint8_t 压缩方式 + uint32_t 原始长度 + 数据
+ *   CompressStored 数据为原始字节, 小于阈值或压缩后没有变小时使用
+ *   CompressLz     LZ77块格式: 每个序列为 标记字节(高4位字面量长度, 低4位匹配长度-4), 字面量长度的扩展字节, 字面量,
+ *                  uint16_t 匹配距离, 匹配长度的扩展字节; 长度为15时后跟扩展字节, 每个255继续; 最后一个序列只有字面量
+*/
+#pragma once
+#include "zn_serialize.hpp"
+
+namespace zn_serialize
+{
+    enum CompressMethod : uint8_t
+    {
+        CompressStored = 0,
+        CompressLz = 1
+    };
+
+    const size_t CompressHeaderSize = sizeof(uint8_t) + sizeof(uint32_t);
+    // 默认的压缩阈值, 更短的数据压缩收益很小, 原样存放
+    const size_t CompressThreshold = 128;
+
+    namespace lz
+    {
+        const size_t MinMatch = 4;
+        const size_t MaxDistance = 65535;
+        // 最后的若干字节总是作为字面量, 匹配的扩展不会读到末尾之外
+        const size_t LastLiterals = 5;
+        const size_t MatchLimit = 12;
+        // 解压时按8字节整块拷贝, 输出缓冲区末尾多留的空间
+        const size_t CopySlack = 16;
+        // 每个输入字节最多展开为255个输出字节(长度的扩展字节), 解压前按它检查头部中的原始长度
+        const size_t MaxExpansion = 255;
+
+        inline uint32_t read32(const uint8_t* p)
+        {
+            uint32_t v;
+            memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        inline uint64_t read64(const uint8_t* p)
+        {
+            uint64_t v;
+            memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        inline uint32_t hash(uint32_t v, unsigned bits)
+        {
+            return (v * 2654435761u) >> (32 - bits);
+        }
+
+        inline uint8_t* write_length(uint8_t* op, size_t length)
+        {
+            for (; length >= 255; length -= 255)
+                *op++ = 255;
+            *op++ = static_cast<uint8_t>(length);
+            return op;
+        }
+
+        inline uint8_t* write_sequence(uint8_t* op, const uint8_t* literals, size_t literal_length, size_t match_length)
+        {
+            uint8_t* token = op++;
+            *token = static_cast<uint8_t>((literal_length < 15 ? literal_length : 15) << 4);
+            if (literal_length >= 15)
+                op = write_length(op, literal_length - 15);
+            if (literal_length)
+                memcpy(op, literals, literal_length);
+            op += literal_length;
+            if (match_length)
+            {
+                match_length -= MinMatch;
+                *token |= static_cast<uint8_t>(match_length < 15 ? match_length : 15);
+            }
+            return op;
+        }
+
+        inline size_t bound(size_t size)
+        {
+            return size + size / 255 + 16;
+        }
+
+        // 压缩到dest, dest至少有bound(size)个字节, 返回压缩后的长度
+        inline size_t compress(const uint8_t* src, size_t size, uint8_t* dest)
+        {
+            uint8_t* op = dest;
+            const uint8_t* anchor = src;
+            if (size > MatchLimit)
+            {
+                // 哈希表的大小随输入变化, 短数据不需要清空整张表
+                unsigned bits = 8;
+                while (bits < 14 && (static_cast<size_t>(1) << bits) < size)
+                    ++bits;
+                static thread_local std::vector<uint32_t> table;
+                table.assign(static_cast<size_t>(1) << bits, 0);
+                const uint8_t* ip = src;
+                const uint8_t* mflimit = src + size - MatchLimit;
+                const uint8_t* matchlimit = src + size - LastLiterals;
+                for (;;)
+                {
+                    // 查找匹配, 连续未命中时逐渐加大步长, 快速跳过不可压缩的数据
+                    const uint8_t* ref;
+                    size_t attempts = 1 << 6;
+                    for (;;)
+                    {
+                        uint32_t h = hash(read32(ip), bits);
+                        ref = src + table[h];
+                        table[h] = static_cast<uint32_t>(ip - src);
+                        if (ref < ip && static_cast<size_t>(ip - ref) <= MaxDistance && read32(ref) == read32(ip))
+                            break;
+                        ip += attempts++ >> 6;
+                        if (ip > mflimit)
+                            goto last_literals;
+                    }
+                    while (ip > anchor && ref > src && ip[-1] == ref[-1])
+                    {
+                        --ip;
+                        --ref;
+                    }
+                    // 按8字节比较延长匹配
+                    const uint8_t* match = ip + MinMatch;
+                    const uint8_t* match_ref = ref + MinMatch;
+                    while (match + sizeof(uint64_t) <= matchlimit)
+                    {
+                        uint64_t diff = read64(match) ^ read64(match_ref);
+                        if (diff)
+                        {
+                            while (*match == *match_ref)
+                            {
+                                ++match;
+                                ++match_ref;
+                            }
+                            goto match_found;
+                        }
+                        match += sizeof(uint64_t);
+                        match_ref += sizeof(uint64_t);
+                    }
+                    while (match < matchlimit && *match == *match_ref)
+                    {
+                        ++match;
+                        ++match_ref;
+                    }
+                match_found:
+                    {
+                        size_t match_length = static_cast<size_t>(match - ip);
+                        op = write_sequence(op, anchor, static_cast<size_t>(ip - anchor), match_length);
+                        uint16_t distance = static_cast<uint16_t>(ip - ref);
+                        *op++ = static_cast<uint8_t>(distance);
+                        *op++ = static_cast<uint8_t>(distance >> 8);
+                        if (match_length - MinMatch >= 15)
+                            op = write_length(op, match_length - MinMatch - 15);
+                        ip = match;
+                        anchor = ip;
+                    }
+                    if (ip > mflimit)
+                        break;
+                    table[hash(read32(ip - 2), bits)] = static_cast<uint32_t>(ip - 2 - src);
+                }
+            }
+        last_literals:
+            op = write_sequence(op, anchor, static_cast<size_t>(src + size - anchor), 0);
+            return static_cast<size_t>(op - dest);
+        }
+
+        inline size_t read_length(const uint8_t*& ip, const uint8_t* iend, size_t length)
+        {
+            if (length != 15)
+                return length;
+            for (;;)
+            {
+                if (ip == iend)
+                    throw Exception("decompress failed, corrupt data");
+                uint8_t byte = *ip++;
+                length += byte;
+                if (byte != 255)
+                    return length;
+            }
+        }
+
+        // 解压[src, src + size)到dest, dest有size_out + CopySlack个字节, 解压后的长度必须正好为size_out
+        inline void decompress(const uint8_t* src, size_t size, uint8_t* dest, size_t size_out)
+        {
+            const uint8_t* ip = src;
+            const uint8_t* iend = src + size;
+            uint8_t* op = dest;
+            uint8_t* oend = dest + size_out;
+            for (;;)
+            {
+                if (ip == iend)
+                    throw Exception("decompress failed, corrupt data");
+                uint8_t token = *ip++;
+                size_t literal_length = read_length(ip, iend, token >> 4);
+                if (literal_length > static_cast<size_t>(iend - ip) || literal_length > static_cast<size_t>(oend - op))
+                    throw Exception("decompress failed, corrupt data");
+                // 短字面量按固定的16字节拷贝, 输入足够长时不越界, 输出有CopySlack
+                if (literal_length <= 16 && iend - ip >= 16)
+                    memcpy(op, ip, 16);
+                else
+                    memcpy(op, ip, literal_length);
+                ip += literal_length;
+                op += literal_length;
+                if (ip == iend)
+                    break;
+                if (iend - ip < 2)
+                    throw Exception("decompress failed, corrupt data");
+                size_t distance = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+                ip += 2;
+                size_t match_length = read_length(ip, iend, token & 15) + MinMatch;
+                if (distance == 0 || distance > static_cast<size_t>(op - dest) || match_length > static_cast<size_t>(oend - op))
+                    throw Exception("decompress failed, corrupt data");
+                const uint8_t* ref = op - distance;
+                uint8_t* match_end = op + match_length;
+                if (distance < sizeof(uint64_t))
+                {
+                    // 重叠的短距离(如连续的0): 先逐字节拷贝, 之后按距离的整数倍整块拷贝
+                    size_t step = distance;
+                    while (step < sizeof(uint64_t))
+                        step += distance;
+                    for (size_t i = 0; i < step && op < match_end; ++i)
+                        *op++ = *ref++;
+                    ref = op - step;
+                }
+                // 输出末尾留有CopySlack, 最后一块可以越过match_end
+                if (op - ref >= 16)
+                {
+                    while (op < match_end)
+                    {
+                        memcpy(op, ref, 16);
+                        op += 16;
+                        ref += 16;
+                    }
+                }
+                else
+                {
+                    while (op < match_end)
+                    {
+                        memcpy(op, ref, sizeof(uint64_t));
+                        op += sizeof(uint64_t);
+                        ref += sizeof(uint64_t);
+                    }
+                }
+                op = match_end;
+            }
+            if (op != oend)
+                throw Exception("decompress failed, size mismatch");
+        }
+    }
+
+    // 压缩[data, data + size)并追加到out末尾, 短于threshold或压缩后没有变小时原样存放
+    inline void compress(const uint8_t* data, size_t size, ZnSerializeBuffer& out, size_t threshold = CompressThreshold)
+    {
+        if (size > 0xFFFFFFFF)
+            throw Exception("compress failed, data too large");
+        size_t offset = out.size();
+        uint32_t raw_size = static_cast<uint32_t>(size);
+        if (size >= threshold)
+        {
+            out.resize(offset + CompressHeaderSize + lz::bound(size));
+            size_t compressed = lz::compress(data, size, out.data() + offset + CompressHeaderSize);
+            if (compressed < size)
+            {
+                out[offset] = CompressLz;
+                memcpy(out.data() + offset + sizeof(uint8_t), &raw_size, sizeof(raw_size));
+                out.resize(offset + CompressHeaderSize + compressed);
+                return;
+            }
+        }
+        out.resize(offset + CompressHeaderSize + size);
+        out[offset] = CompressStored;
+        memcpy(out.data() + offset + sizeof(uint8_t), &raw_size, sizeof(raw_size));
+        if (size)
+            memcpy(out.data() + offset + CompressHeaderSize, data, size);
+    }
+
+    inline void compress(const ZnSerializeBuffer& in, ZnSerializeBuffer& out, size_t threshold = CompressThreshold)
+    {
+        compress(in.data(), in.size(), out, threshold);
+    }
+
+    // 解压一帧并追加到out末尾, 帧必须正好占满[begin, end)
+    inline void decompress(const uint8_t* begin, const uint8_t* end, ZnSerializeBuffer& out)
+    {
+        if (static_cast<size_t>(end - begin) < CompressHeaderSize)
+            throw Exception("decompress failed, out of memery");
+        uint8_t method = begin[0];
+        uint32_t raw_size;
+        memcpy(&raw_size, begin + sizeof(uint8_t), sizeof(raw_size));
+        const uint8_t* data = begin + CompressHeaderSize;
+        size_t size = static_cast<size_t>(end - data);
+        size_t offset = out.size();
+        if (method == CompressStored)
+        {
+            if (size != raw_size)
+                throw Exception("decompress failed, size mismatch");
+            out.insert(out.end(), data, end);
+        }
+        else if (method == CompressLz)
+        {
+            if (raw_size > size * lz::MaxExpansion + lz::CopySlack)
+                throw Exception("decompress failed, corrupt data");
+            out.resize(offset + raw_size + lz::CopySlack);
+            try
+            {
+                lz::decompress(data, size, out.data() + offset, raw_size);
+            }
+            catch (...)
+            {
+                out.resize(offset);
+                throw;
+            }
+            out.resize(offset + raw_size);
+        }
+        else
+            throw Exception("decompress failed, unknown method");
+    }
+
+    inline void decompress(const ZnSerializeBuffer& in, ZnSerializeBuffer& out)
+    {
+        decompress(in.data(), in.data() + in.size(), out);
+    }
+
+    // 序列化ZN_STRUCT后压缩, 追加到out末尾, buffer用于存放压缩前的数据, 反复调用时可以复用
+    template<typename t>
+    inline void serialize_compressed(const t& v, ZnSerializeBuffer& out, ZnSerializeBuffer& buffer, size_t threshold = CompressThreshold)
+    {
+        buffer.clear();
+        v.serialize(buffer);
+        compress(buffer, out, threshold);
+    }
+
+    template<typename t>
+    inline void serialize_compressed(const t& v, ZnSerializeBuffer& out, size_t threshold = CompressThreshold)
+    {
+        ZnSerializeBuffer buffer;
+        serialize_compressed(v, out, buffer, threshold);
+    }
+
+    // 解压后反序列化ZN_STRUCT, 原样存放的数据直接解码, 不经过拷贝
+    // 压缩的数据解压到buffer中, 视图(StringView/ArrayView)成员指向buffer或输入, 两者都需要在使用视图期间有效
+    template<typename t>
+    inline void deserialize_compressed(const uint8_t* begin, const uint8_t* end, t& v, ZnSerializeBuffer& buffer)
+    {
+        const uint8_t* data_begin;
+        const uint8_t* data_end;
+        uint32_t raw_size;
+        if (static_cast<size_t>(end - begin) >= CompressHeaderSize && begin[0] == CompressStored)
+        {
+            memcpy(&raw_size, begin + sizeof(uint8_t), sizeof(raw_size));
+            data_begin = begin + CompressHeaderSize;
+            data_end = end;
+            if (static_cast<size_t>(data_end - data_begin) != raw_size)
+                throw Exception("decompress failed, size mismatch");
+        }
+        else
+        {
+            buffer.clear();
+            decompress(begin, end, buffer);
+            data_begin = buffer.data();
+            data_end = buffer.data() + buffer.size();
+        }
+        if (v.deserialize(data_begin, data_end) != data_end)
+            throw Exception("deserialize compressed failed, size mismatch");
+    }
+
+    // 不传buffer时解压到临时空间, 返回前释放, 不支持含有视图成员的结构体
+    template<typename t>
+    inline void deserialize_compressed(const uint8_t* begin, const uint8_t* end, t& v)
+    {
+        ZnSerializeBuffer buffer;
+        deserialize_compressed(begin, end, v, buffer);
+    }
+
+    template<typename t>
+    inline void deserialize_compressed(const ZnSerializeBuffer& in, t& v)
+    {
+        deserialize_compressed(in.data(), in.data() + in.size(), v);
+    }
+
+    template<typename t>
+    inline void deserialize_compressed(const ZnSerializeBuffer& in, t& v, ZnSerializeBuffer& buffer)
+    {
+        deserialize_compressed(in.data(), in.data() + in.size(), v, buffer);
+    }
+};
@@ -0,0 +1,393 @@
+/*
+ * 增量编码: 与上一次的快照比较, 只发送变化的成员
+ * 格式: 每个结构体先写成员位图(按ZN_SERIALIZE的顺序, 基类成员在前, 每个成员一位, 低位在前), 再依次写出位为1的成员
+ *   嵌套的ZN_STRUCT成员递归写入它自己的增量, 其他成员写入完整的值; 没有任何变化时位图全为0
+*/
+#pragma once
+#include "zn_serialize.hpp"
+#include <cstddef>
+#include <iterator>
+
+namespace zn_serialize
+{
+    // 成员相对于结构体起始地址的偏移, 同一类型的所有对象都相同, 每个类型只计算一次
+    struct MemberOffsetVisitor
+    {
+        const char* base;
+        std::vector<ptrdiff_t> offsets;
+        template<typename t>
+        void operator()(const t& v)
+        {
+            offsets.push_back(reinterpret_cast<const char*>(std::addressof(v)) - base);
+        }
+    };
+
+    template<typename t>
+    inline const std::vector<ptrdiff_t>& member_offsets(const t& v)
+    {
+        struct Compute
+        {
+            static std::vector<ptrdiff_t> get(const t& v)
+            {
+                MemberOffsetVisitor visitor;
+                visitor.base = reinterpret_cast<const char*>(std::addressof(v));
+                v.visit_members(visitor);
+                return visitor.offsets;
+            }
+        };
+        static const std::vector<ptrdiff_t> offsets = Compute::get(v);
+        return offsets;
+    }
+
+    template<typename t>
+    inline const t& member_at(const void* base, ptrdiff_t offset)
+    {
+        return *reinterpret_cast<const t*>(static_cast<const char*>(base) + offset);
+    }
+
+    // 判断两个值是否相同; 容器与元组逐个元素比较, 因此元素不需要operator==
+    // 没有专门重载的类型按默认格式的序列化结果比较
+    // 先声明全部重载, 嵌套的容器与元组在定义之前也能找到
+    template<typename t> inline bool values_equal(const t& a, const t& b);
+    template<typename k, typename t> inline bool values_equal(const std::pair<const k, t>& a, const std::pair<const k, t>& b);
+    template<typename...t> inline bool values_equal(const std::tuple<t...>& a, const std::tuple<t...>& b);
+    template<typename tr, typename a> inline bool values_equal(const std::basic_string<char, tr, a>& x, const std::basic_string<char, tr, a>& y);
+    template<typename tr, typename a> inline bool values_equal(const std::basic_string<wchar_t, tr, a>& x, const std::basic_string<wchar_t, tr, a>& y);
+    template<typename t> inline bool values_equal(const std::shared_ptr<t>& a, const std::shared_ptr<t>& b);
+    template<typename t, size_t s> inline bool values_equal(const std::array<t, s>& a, const std::array<t, s>& b);
+    template<typename t, typename a> inline bool values_equal(const std::vector<t, a>& x, const std::vector<t, a>& y);
+    template<typename t, typename a> inline bool values_equal(const std::deque<t, a>& x, const std::deque<t, a>& y);
+    template<typename t, typename a> inline bool values_equal(const std::list<t, a>& x, const std::list<t, a>& y);
+    template<typename t, typename c, typename a> inline bool values_equal(const std::set<t, c, a>& x, const std::set<t, c, a>& y);
+    template<typename t, typename c, typename a> inline bool values_equal(const std::multiset<t, c, a>& x, const std::multiset<t, c, a>& y);
+    template<typename k, typename t, typename c, typename a> inline bool values_equal(const std::map<k, t, c, a>& x, const std::map<k, t, c, a>& y);
+    template<typename k, typename t, typename c, typename a> inline bool values_equal(const std::multimap<k, t, c, a>& x, const std::multimap<k, t, c, a>& y);
+    template<typename t, typename h, typename e, typename a> inline bool values_equal(const std::unordered_set<t, h, e, a>& x, const std::unordered_set<t, h, e, a>& y);
+    template<typename t, typename h, typename e, typename a> inline bool values_equal(const std::unordered_multiset<t, h, e, a>& x, const std::unordered_multiset<t, h, e, a>& y);
+    template<typename k, typename t, typename h, typename e, typename a> inline bool values_equal(const std::unordered_map<k, t, h, e, a>& x, const std::unordered_map<k, t, h, e, a>& y);
+    template<typename k, typename t, typename h, typename e, typename a> inline bool values_equal(const std::unordered_multimap<k, t, h, e, a>& x, const std::unordered_multimap<k, t, h, e, a>& y);
+    template<typename t, size_t s> inline bool values_equal(const t(&a)[s], const t(&b)[s]);
+    template<typename t> inline bool values_equal(const t& a, const t& b, Struct*);
+    template<typename t> inline bool values_equal(const t& a, const t& b, t*);
+
+    template<typename t>
+    inline bool values_equal(const t& a, const t& b, std::true_type)
+    {
+        return a == b;
+    }
+
+    template<typename t>
+    inline bool values_equal(const t& a, const t& b, std::false_type)
+    {
+        ZnSerializeBuffer x, y;
+        serialize(x, a);
+        serialize(y, b);
+        return x == y;
+    }
+
+    template<typename t>
+    inline bool values_equal_range(const t& a, const t& b)
+    {
+        if (a.size() != b.size())
+            return false;
+        auto j = b.begin();
+        for (auto i = a.begin(); i != a.end(); ++i, ++j)
+        {
+            if (!values_equal(*i, *j))
+                return false;
+        }
+        return true;
+    }
+
+    template<typename k, typename t>
+    inline bool values_equal(const std::pair<const k, t>& a, const std::pair<const k, t>& b)
+    {
+        return values_equal(a.first, b.first) && values_equal(a.second, b.second);
+    }
+
+    template<size_t i, typename...t>
+    inline bool values_equal_tuple(const std::tuple<t...>& a, const std::tuple<t...>& b, std::true_type)
+    {
+        return true;
+    }
+
+    template<size_t i, typename...t>
+    inline bool values_equal_tuple(const std::tuple<t...>& a, const std::tuple<t...>& b, std::false_type)
+    {
+        return values_equal(std::get<i>(a), std::get<i>(b)) && values_equal_tuple<i + 1>(a, b, std::integral_constant<bool, i + 1 == sizeof...(t)>());
+    }
+
+    template<typename...t>
+    inline bool values_equal(const std::tuple<t...>& a, const std::tuple<t...>& b)
+    {
+        return values_equal_tuple<0>(a, b, std::integral_constant<bool, sizeof...(t) == 0>());
+    }
+
+    template<typename tr, typename a>
+    inline bool values_equal(const std::basic_string<char, tr, a>& x, const std::basic_string<char, tr, a>& y) { return x == y; }
+    template<typename tr, typename a>
+    inline bool values_equal(const std::basic_string<wchar_t, tr, a>& x, const std::basic_string<wchar_t, tr, a>& y) { return x == y; }
+    template<typename t>
+    inline bool values_equal(const std::shared_ptr<t>& a, const std::shared_ptr<t>& b) { return a == b || (a && b && values_equal(*a, *b)); }
+    template<typename t, size_t s>
+    inline bool values_equal(const std::array<t, s>& a, const std::array<t, s>& b) { return values_equal_range(a, b); }
+    template<typename t, typename a>
+    inline bool values_equal(const std::vector<t, a>& x, const std::vector<t, a>& y) { return values_equal_range(x, y); }
+    template<typename t, typename a>
+    inline bool values_equal(const std::deque<t, a>& x, const std::deque<t, a>& y) { return values_equal_range(x, y); }
+    template<typename t, typename a>
+    inline bool values_equal(const std::list<t, a>& x, const std::list<t, a>& y) { return values_equal_range(x, y); }
+    template<typename t, typename c, typename a>
+    inline bool values_equal(const std::set<t, c, a>& x, const std::set<t, c, a>& y) { return values_equal_range(x, y); }
+    template<typename t, typename c, typename a>
+    inline bool values_equal(const std::multiset<t, c, a>& x, const std::multiset<t, c, a>& y) { return values_equal_range(x, y); }
+    template<typename k, typename t, typename c, typename a>
+    inline bool values_equal(const std::map<k, t, c, a>& x, const std::map<k, t, c, a>& y) { return values_equal_range(x, y); }
+    template<typename k, typename t, typename c, typename a>
+    inline bool values_equal(const std::multimap<k, t, c, a>& x, const std::multimap<k, t, c, a>& y) { return values_equal_range(x, y); }
+
+    // 无序容器的遍历顺序不确定, 按键查找比较
+    template<typename t, typename h, typename e, typename a>
+    inline bool values_equal(const std::unordered_set<t, h, e, a>& x, const std::unordered_set<t, h, e, a>& y)
+    {
+        if (x.size() != y.size())
+            return false;
+        for (const auto& i : x)
+        {
+            if (!y.count(i))
+                return false;
+        }
+        return true;
+    }
+
+    template<typename k, typename t, typename h, typename e, typename a>
+    inline bool values_equal(const std::unordered_map<k, t, h, e, a>& x, const std::unordered_map<k, t, h, e, a>& y)
+    {
+        if (x.size() != y.size())
+            return false;
+        for (const auto& i : x)
+        {
+            auto it = y.find(i.first);
+            if (it == y.end() || !values_equal(i.second, it->second))
+                return false;
+        }
+        return true;
+    }
+
+    template<typename t, typename h, typename e, typename a>
+    inline bool values_equal(const std::unordered_multiset<t, h, e, a>& x, const std::unordered_multiset<t, h, e, a>& y)
+    {
+        if (x.size() != y.size())
+            return false;
+        for (const auto& i : x)
+        {
+            if (x.count(i) != y.count(i))
+                return false;
+        }
+        return true;
+    }
+
+    // 相同键的元素相邻, 逐组比较, 组内的值按任意顺序一一对应
+    template<typename k, typename t, typename h, typename e, typename a>
+    inline bool values_equal(const std::unordered_multimap<k, t, h, e, a>& x, const std::unordered_multimap<k, t, h, e, a>& y)
+    {
+        if (x.size() != y.size())
+            return false;
+        for (auto it = x.begin(); it != x.end();)
+        {
+            auto xr = x.equal_range(it->first);
+            auto yr = y.equal_range(it->first);
+            std::vector<bool> matched(static_cast<size_t>(std::distance(yr.first, yr.second)));
+            if (static_cast<size_t>(std::distance(xr.first, xr.second)) != matched.size())
+                return false;
+            for (auto i = xr.first; i != xr.second; ++i)
+            {
+                size_t n = 0;
+                auto j = yr.first;
+                for (; j != yr.second && (matched[n] || !values_equal(i->second, j->second)); ++j, ++n);
+                if (j == yr.second)
+                    return false;
+                matched[n] = true;
+            }
+            it = xr.second;
+        }
+        return true;
+    }
+
+    template<typename t, size_t s>
+    inline bool values_equal(const t(&a)[s], const t(&b)[s])
+    {
+        for (size_t i = 0; i < s; ++i)
+        {
+            if (!values_equal(a[i], b[i]))
+                return false;
+        }
+        return true;
+    }
+
+    template<typename t>
+    struct MembersEqualVisitor
+    {
+        const void* other;
+        const std::vector<ptrdiff_t>& offsets;
+        size_t index;
+        bool equal;
+        template<typename m>
+        void operator()(const m& v)
+        {
+            if (equal && !values_equal(v, member_at<m>(other, offsets[index])))
+                equal = false;
+            ++index;
+        }
+    };
+
+    template<typename t>
+    inline bool values_equal(const t& a, const t& b, Struct*)
+    {
+        MembersEqualVisitor<t> visitor = { std::addressof(b), member_offsets(a), 0, true };
+        a.visit_members(visitor);
+        return visitor.equal;
+    }
+
+    template<typename t>
+    inline bool values_equal(const t& a, const t& b, t*)
+    {
+        return values_equal(a, b, std::integral_constant<bool, std::is_arithmetic<t>::value || std::is_enum<t>::value>());
+    }
+
+    template<typename t>
+    inline bool values_equal(const t& a, const t& b)
+    {
+        return values_equal(a, b, static_cast<typename GetZnStructPtr<t>::Ptr>(nullptr));
+    }
+
+    template<typename format_t, typename t>
+    inline bool write_delta(ZnSerializeBuffer& out, const t& baseline, const t& current);
+
+    template<typename format_t>
+    struct DeltaWriteVisitor
+    {
+        ZnSerializeBuffer& out;
+        const void* baseline;
+        const std::vector<ptrdiff_t>& offsets;
+        size_t mask;
+        size_t index;
+        bool changed;
+        template<typename m>
+        void operator()(const m& v)
+        {
+            if (write_member(v, member_at<m>(baseline, offsets[index]), static_cast<typename GetZnStructPtr<m>::Ptr>(nullptr)))
+            {
+                out[mask + index / 8] |= static_cast<uint8_t>(1 << (index % 8));
+                changed = true;
+            }
+            ++index;
+        }
+        // 嵌套的结构体写入它的增量, 没有变化时撤销
+        template<typename m>
+        bool write_member(const m& v, const m& base, Struct*)
+        {
+            size_t size = out.size();
+            if (write_delta<format_t>(out, base, v))
+                return true;
+            out.resize(size);
+            return false;
+        }
+        template<typename m>
+        bool write_member(const m& v, const m& base, m*)
+        {
+            if (values_equal(v, base))
+                return false;
+            FormatSink<format_t, ZnSerializeBuffer> sink(out);
+            serialize(sink, v);
+            return true;
+        }
+    };
+
+    // 追加current相对于baseline的增量, 返回是否有成员变化
+    template<typename format_t, typename t>
+    inline bool write_delta(ZnSerializeBuffer& out, const t& baseline, const t& current)
+    {
+        const auto& offsets = member_offsets(current);
+        size_t mask = out.size();
+        out.resize(mask + (offsets.size() + 7) / 8, 0);
+        DeltaWriteVisitor<format_t> visitor = { out, std::addressof(baseline), offsets, mask, 0, false };
+        current.visit_members(visitor);
+        return visitor.changed;
+    }
+
+    template<typename format_t, typename t>
+    inline void read_delta(Reader<format_t>& in, t& v);
+
+    // 完整的值覆盖原有的值, 容器与字符串按复用模式解码
+    template<typename format_t, typename t>
+    inline void assign_member(Reader<format_t>& in, t& v)
+    {
+        deserialize(in, v);
+    }
+
+    // 快照中的shared_ptr可能与其他对象共享, 解码到新的对象中
+    template<typename format_t, typename t>
+    inline void assign_member(Reader<format_t>& in, std::shared_ptr<t>& v)
+    {
+        v = std::make_shared<t>();
+        deserialize(in, *v);
+    }
+
+    template<typename format_t>
+    struct DeltaReadVisitor
+    {
+        Reader<format_t>& in;
+        const uint8_t* mask;
+        size_t index;
+        template<typename m>
+        void operator()(m& v)
+        {
+            if (mask[index / 8] & (1 << (index % 8)))
+                read_member(v, static_cast<typename GetZnStructPtr<m>::Ptr>(nullptr));
+            ++index;
+        }
+        template<typename m>
+        void read_member(m& v, Struct*)
+        {
+            read_delta(in, v);
+        }
+        template<typename m>
+        void read_member(m& v, m*)
+        {
+            assign_member(in, v);
+        }
+    };
+
+    template<typename format_t, typename t>
+    inline void read_delta(Reader<format_t>& in, t& v)
+    {
+        size_t count = member_offsets(v).size();
+        auto mask = read_bytes(in, (count + 7) / 8, "apply delta failed, out of memery");
+        DeltaReadVisitor<format_t> visitor = { in, mask, 0 };
+        v.visit_members(visitor);
+    }
+
+    // 把current相对于baseline的增量追加到out末尾, 成员的值按结构体的格式编码, 返回是否有成员变化
+    template<typename t>
+    inline bool serialize_delta(const t& baseline, const t& current, ZnSerializeBuffer& out)
+    {
+        return write_delta<typename t::ZnFormat>(out, baseline, current);
+    }
+
+    // 把增量应用到v上, v必须与生成增量时的baseline相同, 返回增量之后的位置
+    template<typename t>
+    inline const uint8_t* apply_delta(const uint8_t* begin, const uint8_t* end, t& v)
+    {
+        Reader<typename t::ZnFormat> in(begin, end, true);
+        read_delta(in, v);
+        return in.cursor;
+    }
+
+    template<typename t>
+    inline void apply_delta(const ZnSerializeBuffer& in, t& v)
+    {
+        if (apply_delta(in.data(), in.data() + in.size(), v) != in.data() + in.size())
+            throw Exception("apply delta failed, size mismatch");
+    }
+};
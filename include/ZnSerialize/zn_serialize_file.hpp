@@ -0,0 +1,345 @@
+/*
+ * 记录文件: 只追加写入的消息存档, 带有每条记录的偏移索引, 读取时映射整个文件, 按序号直接从映射的内存解码
+ * 文件格式(本机字节序):
+ *   文件头   uint32_t magic, uint32_t version
+ *   记录     uint32_t 长度 + 消息字节, 依次连续存放
+ *   索引     uint64_t 每条记录的偏移
+ *   文件尾   uint64_t 索引的偏移, uint64_t 记录数, uint32_t magic, uint32_t version
+ * 关闭写入端时才写入索引与文件尾; 没有正常关闭的文件打开时按长度前缀逐条扫描恢复索引, 末尾不完整的记录被忽略
+*/
+#pragma once
+#include "zn_serialize.hpp"
+#include <stdio.h>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace zn_serialize
+{
+    const uint32_t RecordFileMagic = 0x46524E5A;    // "ZNRF"
+    const uint32_t RecordIndexMagic = 0x49524E5A;   // "ZNRI"
+    const uint32_t RecordFileVersion = 1;
+    const size_t RecordFileHeaderSize = sizeof(uint32_t) * 2;
+    const size_t RecordFileFooterSize = sizeof(uint64_t) * 2 + sizeof(uint32_t) * 2;
+
+    // 只读映射整个文件, 打开时不读取文件内容
+    class MappedFile
+    {
+    public:
+        MappedFile()
+            : data_(nullptr), size_(0)
+#ifdef _WIN32
+            , file_(INVALID_HANDLE_VALUE), mapping_(nullptr)
+#endif
+        {}
+        explicit MappedFile(const std::string& path)
+            : MappedFile()
+        {
+            open(path);
+        }
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        ~MappedFile()
+        {
+            close();
+        }
+        void open(const std::string& path)
+        {
+            close();
+#ifdef _WIN32
+            file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file_ == INVALID_HANDLE_VALUE)
+                throw Exception("map file failed, can not open file");
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(file_, &size))
+            {
+                close();
+                throw Exception("map file failed, can not get file size");
+            }
+            size_ = static_cast<size_t>(size.QuadPart);
+            if (size_)
+            {
+                mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                data_ = mapping_ ? static_cast<const uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+                if (!data_)
+                {
+                    close();
+                    throw Exception("map file failed, can not map file");
+                }
+            }
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw Exception("map file failed, can not open file");
+            struct stat st;
+            if (fstat(fd, &st) != 0)
+            {
+                ::close(fd);
+                throw Exception("map file failed, can not get file size");
+            }
+            size_ = static_cast<size_t>(st.st_size);
+            if (size_)
+            {
+                void* p = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+                if (p == MAP_FAILED)
+                {
+                    ::close(fd);
+                    size_ = 0;
+                    throw Exception("map file failed, can not map file");
+                }
+                data_ = static_cast<const uint8_t*>(p);
+            }
+            // 映射建立后不再需要文件描述符
+            ::close(fd);
+#endif
+        }
+        void close()
+        {
+#ifdef _WIN32
+            if (data_)
+                UnmapViewOfFile(data_);
+            if (mapping_)
+                CloseHandle(mapping_);
+            if (file_ != INVALID_HANDLE_VALUE)
+                CloseHandle(file_);
+            mapping_ = nullptr;
+            file_ = INVALID_HANDLE_VALUE;
+#else
+            if (data_)
+                munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+            data_ = nullptr;
+            size_ = 0;
+        }
+        const uint8_t* data() const { return data_; }
+        size_t size() const { return size_; }
+    private:
+        const uint8_t* data_;
+        size_t size_;
+#ifdef _WIN32
+        HANDLE file_;
+        HANDLE mapping_;
+#endif
+    };
+
+    template<typename t>
+    inline t load_unaligned(const uint8_t* p)
+    {
+        t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    // 从文件内容得到每条记录的偏移, 返回最后一条记录之后的位置(追加写入的位置)
+    // 有完整的文件尾时直接使用索引, 否则从头逐条扫描
+    inline uint64_t load_record_index(const uint8_t* data, size_t size, std::vector<uint64_t>& offsets)
+    {
+        offsets.clear();
+        if (size < RecordFileHeaderSize || load_unaligned<uint32_t>(data) != RecordFileMagic)
+            throw Exception("open record file failed, bad header");
+        if (load_unaligned<uint32_t>(data + sizeof(uint32_t)) != RecordFileVersion)
+            throw Exception("open record file failed, unsupported version");
+        if (size >= RecordFileHeaderSize + RecordFileFooterSize)
+        {
+            auto footer = data + size - RecordFileFooterSize;
+            uint64_t index = load_unaligned<uint64_t>(footer);
+            uint64_t count = load_unaligned<uint64_t>(footer + sizeof(uint64_t));
+            if (load_unaligned<uint32_t>(footer + sizeof(uint64_t) * 2) == RecordIndexMagic
+                && index >= RecordFileHeaderSize && index <= size - RecordFileFooterSize
+                && count <= (size - RecordFileFooterSize - index) / sizeof(uint64_t)
+                && size - RecordFileFooterSize - index == count * sizeof(uint64_t))
+            {
+                offsets.resize(static_cast<size_t>(count));
+                if (count)
+                    memcpy(offsets.data(), data + index, static_cast<size_t>(count) * sizeof(uint64_t));
+                return index;
+            }
+        }
+        uint64_t offset = RecordFileHeaderSize;
+        while (size - offset >= sizeof(uint32_t))
+        {
+            uint32_t length = load_unaligned<uint32_t>(data + offset);
+            if (length > size - offset - sizeof(uint32_t))
+                break;
+            offsets.push_back(offset);
+            offset += sizeof(uint32_t) + length;
+        }
+        return offset;
+    }
+
+    // 只追加的记录写入端, append为true时在已有文件的末尾继续写入(文件不存在时新建)
+    class RecordWriter
+    {
+    public:
+        explicit RecordWriter(const std::string& path, bool append = false)
+            : file_(nullptr), position_(0)
+        {
+            if (append)
+            {
+                file_ = fopen(path.c_str(), "r+b");
+                if (file_)
+                {
+                    try
+                    {
+                        {
+                            MappedFile mapped(path);
+                            position_ = load_record_index(mapped.data(), mapped.size(), offsets_);
+                        }
+                        // 去掉旧的索引与末尾不完整的记录
+                        if (!truncate(position_) || !seek(position_))
+                            throw Exception("open record file failed, can not seek");
+                    }
+                    catch (...)
+                    {
+                        fclose(file_);
+                        file_ = nullptr;
+                        throw;
+                    }
+                    return;
+                }
+            }
+            file_ = fopen(path.c_str(), "wb");
+            if (!file_)
+                throw Exception("open record file failed, can not create file");
+            uint32_t header[2] = { RecordFileMagic, RecordFileVersion };
+            write(header, sizeof(header));
+            position_ = sizeof(header);
+        }
+        RecordWriter(const RecordWriter&) = delete;
+        RecordWriter& operator=(const RecordWriter&) = delete;
+        ~RecordWriter()
+        {
+            try
+            {
+                close();
+            }
+            catch (const Exception&)
+            {}
+        }
+        // 写入一条ZN_STRUCT消息, 返回它的序号
+        template<typename t>
+        size_t append(const t& v)
+        {
+            buffer_.resize(sizeof(uint32_t));
+            v.serialize(buffer_);
+            uint32_t length = static_cast<uint32_t>(buffer_.size() - sizeof(uint32_t));
+            memcpy(buffer_.data(), &length, sizeof(length));
+            return append_frame();
+        }
+        // 写入已经序列化的消息
+        size_t append(const uint8_t* data, size_t size)
+        {
+            buffer_.resize(sizeof(uint32_t) + size);
+            uint32_t length = static_cast<uint32_t>(size);
+            memcpy(buffer_.data(), &length, sizeof(length));
+            if (size)
+                memcpy(buffer_.data() + sizeof(uint32_t), data, size);
+            return append_frame();
+        }
+        void flush()
+        {
+            if (file_ && fflush(file_) != 0)
+                throw Exception("write record file failed, can not flush");
+        }
+        // 写入索引与文件尾后关闭, 之后不能再写入; 以append = true重新打开时接在最后一条记录之后继续写入
+        void close()
+        {
+            if (!file_)
+                return;
+            uint64_t footer[2] = { position_, static_cast<uint64_t>(offsets_.size()) };
+            uint32_t magic[2] = { RecordIndexMagic, RecordFileVersion };
+            if (!offsets_.empty())
+                write(offsets_.data(), offsets_.size() * sizeof(uint64_t));
+            write(footer, sizeof(footer));
+            write(magic, sizeof(magic));
+            int result = fclose(file_);
+            file_ = nullptr;
+            if (result != 0)
+                throw Exception("write record file failed, can not close");
+        }
+        size_t size() const { return offsets_.size(); }
+    private:
+        size_t append_frame()
+        {
+            if (!file_)
+                throw Exception("write record file failed, file closed");
+            write(buffer_.data(), buffer_.size());
+            offsets_.push_back(position_);
+            position_ += buffer_.size();
+            return offsets_.size() - 1;
+        }
+        void write(const void* data, size_t size)
+        {
+            if (fwrite(data, 1, size, file_) != size)
+                throw Exception("write record file failed, can not write");
+        }
+        bool truncate(uint64_t size)
+        {
+#ifdef _WIN32
+            return _chsize_s(_fileno(file_), static_cast<__int64>(size)) == 0;
+#else
+            return ftruncate(fileno(file_), static_cast<off_t>(size)) == 0;
+#endif
+        }
+        bool seek(uint64_t position)
+        {
+#ifdef _WIN32
+            return _fseeki64(file_, static_cast<__int64>(position), SEEK_SET) == 0;
+#else
+            return fseeko(file_, static_cast<off_t>(position), SEEK_SET) == 0;
+#endif
+        }
+        FILE* file_;
+        uint64_t position_;
+        std::vector<uint64_t> offsets_;
+        ZnSerializeBuffer buffer_;
+    };
+
+    // 记录文件的读取端, 打开时只映射文件并读取索引, 记录按需从映射的内存解码
+    class RecordReader
+    {
+    public:
+        explicit RecordReader(const std::string& path)
+            : file_(path)
+        {
+            end_ = load_record_index(file_.data(), file_.size(), offsets_);
+        }
+        size_t size() const { return offsets_.size(); }
+        // 第i条记录的字节范围, 指向映射的内存, 读取端关闭前有效
+        std::pair<const uint8_t*, const uint8_t*> record(size_t i) const
+        {
+            if (i >= offsets_.size())
+                throw Exception("read record failed, index out of range");
+            // 索引来自文件, 损坏时不能越界读取
+            uint64_t offset = offsets_[i];
+            if (offset < RecordFileHeaderSize || offset > end_ || end_ - offset < sizeof(uint32_t))
+                throw Exception("read record failed, bad index");
+            auto p = file_.data() + offset;
+            uint32_t length = load_unaligned<uint32_t>(p);
+            if (length > end_ - offset - sizeof(uint32_t))
+                throw Exception("read record failed, bad index");
+            return std::make_pair(p + sizeof(uint32_t), p + sizeof(uint32_t) + length);
+        }
+        // 把第i条记录解码到ZN_STRUCT v
+        template<typename t>
+        void read(size_t i, t& v) const
+        {
+            auto range = record(i);
+            if (v.deserialize(range.first, range.second) != range.second)
+                throw Exception("read record failed, record size mismatch");
+        }
+    private:
+        MappedFile file_;
+        uint64_t end_;
+        std::vector<uint64_t> offsets_;
+    };
+};
@@ -0,0 +1,583 @@
+/*
+ * 带索引的编码: 结构体与元素不定长的容器前面带有偏移表, 读取时可以直接定位到任意成员或元素, 不需要解码整条消息
+ * 格式(本机字节序):
+ *   结构体   uint32_t 成员数n, n + 1个uint32_t偏移(相对于结构体的起始位置, 最后一个为总长度), 之后依次为各成员
+ *            成员按ZN_SERIALIZE的顺序, 基类成员在前; 嵌套的结构体与容器递归使用带索引的编码
+ *   序列     元素可以整块拷贝时为 uint32_t 元素数 + 依次存放的元素, 第i个元素位于固定位置
+ *            否则为 uint32_t 元素数n, n + 1个uint32_t偏移, 之后依次为各元素
+ *   映射     uint32_t 元素数n, 2n + 1个uint32_t偏移(依次为每个元素的键与值), 之后依次为键与值
+ *   其他类型(标量, 字符串, 元组, 数组等)按定长格式编码
+*/
+#pragma once
+#include "zn_serialize.hpp"
+#include <cstddef>
+
+namespace zn_serialize
+{
+    struct IndexedLeafTag {};
+    struct IndexedStructTag {};
+    struct IndexedSequenceTag {};
+    struct IndexedMapTag {};
+
+    template<typename t> struct IndexedTag { typedef typename std::conditional<IsZnStruct<t>::value, IndexedStructTag, IndexedLeafTag>::type type; };
+    template<typename t, typename a> struct IndexedTag<std::vector<t, a>> { typedef IndexedSequenceTag type; };
+    template<typename t, typename a> struct IndexedTag<std::deque<t, a>> { typedef IndexedSequenceTag type; };
+    template<typename t, typename a> struct IndexedTag<std::list<t, a>> { typedef IndexedSequenceTag type; };
+    template<typename t, typename c, typename a> struct IndexedTag<std::set<t, c, a>> { typedef IndexedSequenceTag type; };
+    template<typename t, typename c, typename a> struct IndexedTag<std::multiset<t, c, a>> { typedef IndexedSequenceTag type; };
+    template<typename k, typename t, typename c, typename a> struct IndexedTag<std::map<k, t, c, a>> { typedef IndexedMapTag type; };
+    template<typename k, typename t, typename c, typename a> struct IndexedTag<std::multimap<k, t, c, a>> { typedef IndexedMapTag type; };
+    template<typename t, typename h, typename e, typename a> struct IndexedTag<std::unordered_set<t, h, e, a>> { typedef IndexedSequenceTag type; };
+    template<typename t, typename h, typename e, typename a> struct IndexedTag<std::unordered_multiset<t, h, e, a>> { typedef IndexedSequenceTag type; };
+    template<typename k, typename t, typename h, typename e, typename a> struct IndexedTag<std::unordered_map<k, t, h, e, a>> { typedef IndexedMapTag type; };
+    template<typename k, typename t, typename h, typename e, typename a> struct IndexedTag<std::unordered_multimap<k, t, h, e, a>> { typedef IndexedMapTag type; };
+
+    inline uint32_t load_indexed(const uint8_t* p)
+    {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    // 写入偏移表: 先占位, 每写入一项之前记录它的偏移, 最后记录总长度
+    class IndexedTableWriter
+    {
+    public:
+        IndexedTableWriter(ZnSerializeBuffer& out, size_t count, size_t entries)
+            : out_(out), start_(out.size()), entries_(entries)
+        {
+            if (count > std::numeric_limits<uint32_t>::max())
+                throw Exception("serialize indexed failed, too many items");
+            out.resize(start_ + sizeof(uint32_t) * (entries + 2));
+            uint32_t size = static_cast<uint32_t>(count);
+            memcpy(out.data() + start_, &size, sizeof(size));
+        }
+        void mark(size_t i)
+        {
+            size_t offset = out_.size() - start_;
+            if (offset > std::numeric_limits<uint32_t>::max())
+                throw Exception("serialize indexed failed, message too large");
+            uint32_t v = static_cast<uint32_t>(offset);
+            memcpy(out_.data() + start_ + sizeof(uint32_t) * (i + 1), &v, sizeof(v));
+        }
+        void finish()
+        {
+            mark(entries_);
+        }
+    private:
+        ZnSerializeBuffer& out_;
+        size_t start_;
+        size_t entries_;
+    };
+
+    // 读取偏移表, 偏移来自输入, 每次取用时检查不越界
+    class IndexedTable
+    {
+    public:
+        IndexedTable(const uint8_t* begin, const uint8_t* end, size_t per_item)
+            : begin_(begin)
+        {
+            size_t size = static_cast<size_t>(end - begin);
+            if (size < sizeof(uint32_t))
+                throw Exception("read indexed failed, out of memery");
+            count_ = load_indexed(begin);
+            uint64_t header = sizeof(uint32_t) * (static_cast<uint64_t>(count_) * per_item + 2);
+            if (header > size)
+                throw Exception("read indexed failed, bad offset table");
+            header_ = static_cast<uint32_t>(header);
+            entries_ = static_cast<size_t>(count_) * per_item;
+            total_ = offset(entries_);
+            if (total_ < header_ || total_ > size)
+                throw Exception("read indexed failed, bad offset table");
+        }
+        uint32_t count() const { return count_; }
+        const uint8_t* end() const { return begin_ + total_; }
+        // 第i项的字节范围
+        std::pair<const uint8_t*, const uint8_t*> range(size_t i) const
+        {
+            uint32_t first = offset(i);
+            uint32_t last = offset(i + 1);
+            if (first < header_ || first > last || last > total_)
+                throw Exception("read indexed failed, bad offset");
+            return std::make_pair(begin_ + first, begin_ + last);
+        }
+    private:
+        uint32_t offset(size_t i) const { return load_indexed(begin_ + sizeof(uint32_t) * (i + 1)); }
+        const uint8_t* begin_;
+        uint32_t count_;
+        uint32_t header_;
+        uint32_t total_;
+        size_t entries_;
+    };
+
+    // 结构体成员相对于对象起始地址的偏移(ZN_SERIALIZE的顺序), 用于把成员指针换算为序号, 每个类型只计算一次
+    template<typename t>
+    struct IndexedMembers
+    {
+        struct OffsetVisitor
+        {
+            const char* base;
+            std::vector<ptrdiff_t> offsets;
+            template<typename m>
+            void operator()(const m& v)
+            {
+                offsets.push_back(reinterpret_cast<const char*>(std::addressof(v)) - base);
+            }
+        };
+        static const t& instance()
+        {
+            static const t v = t();
+            return v;
+        }
+        static const std::vector<ptrdiff_t>& offsets()
+        {
+            struct Compute
+            {
+                static std::vector<ptrdiff_t> get()
+                {
+                    OffsetVisitor visitor;
+                    visitor.base = reinterpret_cast<const char*>(std::addressof(instance()));
+                    instance().visit_members(visitor);
+                    return visitor.offsets;
+                }
+            };
+            static const std::vector<ptrdiff_t> offsets = Compute::get();
+            return offsets;
+        }
+        template<typename m, typename c>
+        static size_t index(m c::*member)
+        {
+            const c& object = instance();
+            ptrdiff_t offset = reinterpret_cast<const char*>(std::addressof(object.*member)) - reinterpret_cast<const char*>(std::addressof(instance()));
+            auto& all = offsets();
+            for (size_t i = 0; i < all.size(); ++i)
+            {
+                if (all[i] == offset)
+                    return i;
+            }
+            throw Exception("read indexed failed, member not serialized");
+        }
+    };
+
+    template<typename t, typename tag_t = typename IndexedTag<t>::type> struct IndexedCodec;
+
+    template<typename t>
+    inline void serialize_indexed_value(ZnSerializeBuffer& out, const t& v)
+    {
+        IndexedCodec<t>::write(out, v);
+    }
+
+    template<typename t>
+    inline void deserialize_indexed_value(const uint8_t* begin, const uint8_t* end, t& v)
+    {
+        IndexedCodec<t>::read(begin, end, v);
+    }
+
+    // 其他类型按定长格式编码, 必须正好用完给定的范围
+    template<typename t>
+    struct IndexedCodec<t, IndexedLeafTag>
+    {
+        static void write(ZnSerializeBuffer& out, const t& v)
+        {
+            serialize(out, v);
+        }
+        static void read(const uint8_t* begin, const uint8_t* end, t& v)
+        {
+            Reader<> in(begin, end);
+            deserialize(in, v);
+            if (in.cursor != end)
+                throw Exception("read indexed failed, value size mismatch");
+        }
+    };
+
+    template<typename t>
+    struct IndexedCodec<std::shared_ptr<t>, IndexedLeafTag>
+    {
+        static void write(ZnSerializeBuffer& out, const std::shared_ptr<t>& v)
+        {
+            serialize_indexed_value(out, *v);
+        }
+        static void read(const uint8_t* begin, const uint8_t* end, std::shared_ptr<t>& v)
+        {
+            if (!v)
+                v = std::make_shared<t>();
+            deserialize_indexed_value(begin, end, *v);
+        }
+    };
+
+    template<typename t>
+    struct IndexedCodec<t, IndexedStructTag>
+    {
+        struct WriteVisitor
+        {
+            ZnSerializeBuffer& out;
+            IndexedTableWriter& table;
+            size_t i;
+            template<typename m>
+            void operator()(const m& v)
+            {
+                table.mark(i++);
+                serialize_indexed_value(out, v);
+            }
+        };
+        struct ReadVisitor
+        {
+            const IndexedTable& table;
+            size_t i;
+            template<typename m>
+            void operator()(m& v)
+            {
+                auto range = table.range(i++);
+                deserialize_indexed_value(range.first, range.second, v);
+            }
+        };
+        static void write(ZnSerializeBuffer& out, const t& v)
+        {
+            size_t count = IndexedMembers<t>::offsets().size();
+            IndexedTableWriter table(out, count, count);
+            WriteVisitor visitor = { out, table, 0 };
+            v.visit_members(visitor);
+            table.finish();
+        }
+        static IndexedTable open(const uint8_t* begin, const uint8_t* end)
+        {
+            IndexedTable table(begin, end, 1);
+            if (table.count() != IndexedMembers<t>::offsets().size())
+                throw Exception("read indexed failed, member count mismatch");
+            return table;
+        }
+        static void read(const uint8_t* begin, const uint8_t* end, t& v)
+        {
+            IndexedTable table = open(begin, end);
+            if (table.end() != end)
+                throw Exception("read indexed failed, value size mismatch");
+            ReadVisitor visitor = { table, 0 };
+            v.visit_members(visitor);
+        }
+    };
+
+    // 元素可以整块拷贝的序列, 不需要偏移表
+    template<typename t>
+    struct IndexedBulk
+    {
+        typedef typename t::value_type value_type;
+        static void write(ZnSerializeBuffer& out, const t& v)
+        {
+            if (v.size() > std::numeric_limits<uint32_t>::max())
+                throw Exception("serialize indexed failed, too many items");
+            write_size(out, static_cast<uint32_t>(v.size()), FixedFormat());
+            size_t offset = out.size();
+            out.resize(offset + v.size() * sizeof(value_type));
+            uint8_t* p = out.data() + offset;
+            for (auto it = v.begin(); it != v.end(); ++it, p += sizeof(value_type))
+            {
+                value_type item = *it;
+                memcpy(p, &item, sizeof(item));
+            }
+        }
+        // 返回元素数, 检查所有元素都在范围内
+        static uint32_t open(const uint8_t* begin, const uint8_t* end)
+        {
+            size_t size = static_cast<size_t>(end - begin);
+            if (size < sizeof(uint32_t))
+                throw Exception("read indexed failed, out of memery");
+            uint32_t count = load_indexed(begin);
+            if (count > (size - sizeof(uint32_t)) / sizeof(value_type))
+                throw Exception("read indexed failed, out of memery");
+            return count;
+        }
+        static void read(const uint8_t* begin, const uint8_t* end, t& v)
+        {
+            uint32_t count = open(begin, end);
+            if (sizeof(uint32_t) + count * sizeof(value_type) != static_cast<size_t>(end - begin))
+                throw Exception("read indexed failed, value size mismatch");
+            v.clear();
+            const uint8_t* p = begin + sizeof(uint32_t);
+            for (uint32_t i = 0; i < count; ++i, p += sizeof(value_type))
+            {
+                value_type item;
+                memcpy(&item, p, sizeof(item));
+                v.insert(v.end(), item);
+            }
+        }
+    };
+
+    template<typename t>
+    struct IndexedItems
+    {
+        typedef typename t::value_type value_type;
+        static void write(ZnSerializeBuffer& out, const t& v)
+        {
+            IndexedTableWriter table(out, v.size(), v.size());
+            size_t i = 0;
+            for (auto& item : v)
+            {
+                table.mark(i++);
+                serialize_indexed_value(out, item);
+            }
+            table.finish();
+        }
+        static void read(const uint8_t* begin, const uint8_t* end, t& v)
+        {
+            IndexedTable table(begin, end, 1);
+            if (table.end() != end)
+                throw Exception("read indexed failed, value size mismatch");
+            v.clear();
+            for (uint32_t i = 0; i < table.count(); ++i)
+            {
+                auto range = table.range(i);
+                value_type item;
+                deserialize_indexed_value(range.first, range.second, item);
+                v.insert(v.end(), std::move(item));
+            }
+        }
+    };
+
+    template<typename t>
+    struct IndexedCodec<t, IndexedSequenceTag>
+        : public std::conditional<IsBulk<typename t::value_type>::value, IndexedBulk<t>, IndexedItems<t>>::type
+    {};
+
+    template<typename t>
+    struct IndexedCodec<t, IndexedMapTag>
+    {
+        static void write(ZnSerializeBuffer& out, const t& v)
+        {
+            IndexedTableWriter table(out, v.size(), v.size() * 2);
+            size_t i = 0;
+            for (auto& item : v)
+            {
+                table.mark(i++);
+                serialize_indexed_value(out, item.first);
+                table.mark(i++);
+                serialize_indexed_value(out, item.second);
+            }
+            table.finish();
+        }
+        static void read(const uint8_t* begin, const uint8_t* end, t& v)
+        {
+            IndexedTable table(begin, end, 2);
+            if (table.end() != end)
+                throw Exception("read indexed failed, value size mismatch");
+            v.clear();
+            for (uint32_t i = 0; i < table.count(); ++i)
+            {
+                typename t::key_type key;
+                typename t::mapped_type item;
+                auto range = table.range(i * 2);
+                deserialize_indexed_value(range.first, range.second, key);
+                range = table.range(i * 2 + 1);
+                deserialize_indexed_value(range.first, range.second, item);
+                v.emplace_hint(v.end(), std::move(key), std::move(item));
+            }
+        }
+    };
+
+    // 只读视图: 指向带索引编码中的一个值, 按需定位成员或元素, 使用期间输入的字节流必须有效
+    template<typename t, typename tag_t = typename IndexedTag<t>::type> class IndexedView;
+
+    template<typename t>
+    class IndexedValue
+    {
+    public:
+        IndexedValue(const uint8_t* begin, const uint8_t* end)
+            : begin_(begin), end_(end)
+        {}
+        const uint8_t* begin() const { return begin_; }
+        const uint8_t* end() const { return end_; }
+        // 解码整个值
+        void decode(t& v) const
+        {
+            deserialize_indexed_value(begin_, end_, v);
+        }
+        t decode() const
+        {
+            t v;
+            decode(v);
+            return v;
+        }
+    protected:
+        const uint8_t* begin_;
+        const uint8_t* end_;
+    };
+
+    template<typename t>
+    class IndexedView<t, IndexedLeafTag> : public IndexedValue<t>
+    {
+    public:
+        IndexedView(const uint8_t* begin, const uint8_t* end)
+            : IndexedValue<t>(begin, end)
+        {}
+    };
+
+    template<typename t>
+    class IndexedView<t, IndexedStructTag> : public IndexedValue<t>
+    {
+    public:
+        IndexedView(const uint8_t* begin, const uint8_t* end)
+            : IndexedValue<t>(begin, IndexedCodec<t>::open(begin, end).end())
+            , table_(this->begin_, this->end_, 1)
+        {}
+        size_t size() const { return table_.count(); }
+        // 按成员指针取成员, 可以是基类的成员: view.get(&Child::name).decode()
+        template<typename m, typename c>
+        IndexedView<m> get(m c::*field) const
+        {
+            static_assert(std::is_base_of<c, t>::value, "member must belong to the struct or its bases");
+            return member<m>(IndexedMembers<t>::index(field));
+        }
+        // 第n个成员(ZN_SERIALIZE的顺序, 基类成员在前), 类型由调用者给出
+        template<typename m>
+        IndexedView<m> member(size_t n) const
+        {
+            if (n >= table_.count())
+                throw Exception("read indexed failed, member out of range");
+            auto range = table_.range(n);
+            return IndexedView<m>(range.first, range.second);
+        }
+    private:
+        IndexedTable table_;
+    };
+
+    template<typename t, bool is_bulk = IsBulk<typename t::value_type>::value>
+    class IndexedSequenceView : public IndexedValue<t>
+    {
+    public:
+        typedef typename t::value_type value_type;
+        IndexedSequenceView(const uint8_t* begin, const uint8_t* end)
+            : IndexedValue<t>(begin, end)
+            , size_(IndexedBulk<t>::open(begin, end))
+        {
+            this->end_ = begin + sizeof(uint32_t) + size_ * sizeof(value_type);
+        }
+        size_t size() const { return size_; }
+        IndexedView<value_type> operator[](size_t i) const
+        {
+            if (i >= size_)
+                throw Exception("read indexed failed, index out of range");
+            auto p = this->begin_ + sizeof(uint32_t) + i * sizeof(value_type);
+            return IndexedView<value_type>(p, p + sizeof(value_type));
+        }
+    private:
+        uint32_t size_;
+    };
+
+    template<typename t>
+    class IndexedSequenceView<t, false> : public IndexedValue<t>
+    {
+    public:
+        typedef typename t::value_type value_type;
+        IndexedSequenceView(const uint8_t* begin, const uint8_t* end)
+            : IndexedValue<t>(begin, IndexedTable(begin, end, 1).end())
+            , table_(this->begin_, this->end_, 1)
+        {}
+        size_t size() const { return table_.count(); }
+        IndexedView<value_type> operator[](size_t i) const
+        {
+            if (i >= table_.count())
+                throw Exception("read indexed failed, index out of range");
+            auto range = table_.range(i);
+            return IndexedView<value_type>(range.first, range.second);
+        }
+    private:
+        IndexedTable table_;
+    };
+
+    template<typename t>
+    class IndexedView<t, IndexedSequenceTag> : public IndexedSequenceView<t>
+    {
+    public:
+        IndexedView(const uint8_t* begin, const uint8_t* end)
+            : IndexedSequenceView<t>(begin, end)
+        {}
+    };
+
+    template<typename t>
+    class IndexedView<t, IndexedMapTag> : public IndexedValue<t>
+    {
+    public:
+        typedef typename t::key_type key_type;
+        typedef typename t::mapped_type mapped_type;
+        IndexedView(const uint8_t* begin, const uint8_t* end)
+            : IndexedValue<t>(begin, IndexedTable(begin, end, 2).end())
+            , table_(this->begin_, this->end_, 2)
+        {}
+        size_t size() const { return table_.count(); }
+        IndexedView<key_type> key(size_t i) const
+        {
+            auto range = item(i, 0);
+            return IndexedView<key_type>(range.first, range.second);
+        }
+        IndexedView<mapped_type> mapped(size_t i) const
+        {
+            auto range = item(i, 1);
+            return IndexedView<mapped_type>(range.first, range.second);
+        }
+        // 键按容器的顺序存放, 二分查找只解码O(log n)个键; 返回第一个不小于key的元素的序号, 没有相等的键时返回size()
+        size_t find(const key_type& key) const
+        {
+            typename t::key_compare less;
+            size_t first = 0, count = table_.count();
+            while (count > 0)
+            {
+                size_t step = count / 2;
+                if (less(this->key(first + step).decode(), key))
+                {
+                    first += step + 1;
+                    count -= step + 1;
+                }
+                else
+                    count = step;
+            }
+            if (first < table_.count() && !less(key, this->key(first).decode()))
+                return first;
+            return table_.count();
+        }
+    private:
+        std::pair<const uint8_t*, const uint8_t*> item(size_t i, size_t which) const
+        {
+            if (i >= table_.count())
+                throw Exception("read indexed failed, index out of range");
+            return table_.range(i * 2 + which);
+        }
+        IndexedTable table_;
+    };
+
+    // ZN_STRUCT按带索引的编码追加到out的末尾
+    template<typename t>
+    inline void serialize_indexed(const t& v, ZnSerializeBuffer& out)
+    {
+        static_assert(IsZnStruct<t>::value, "serialize_indexed requires a ZN_STRUCT");
+        IndexedCodec<t>::write(out, v);
+    }
+
+    // 解码整条带索引的消息, 返回消息之后的位置
+    template<typename t>
+    inline const uint8_t* deserialize_indexed(const uint8_t* begin, const uint8_t* end, t& v)
+    {
+        static_assert(IsZnStruct<t>::value, "deserialize_indexed requires a ZN_STRUCT");
+        const uint8_t* message_end = IndexedCodec<t>::open(begin, end).end();
+        IndexedCodec<t>::read(begin, message_end, v);
+        return message_end;
+    }
+
+    template<typename t>
+    inline const uint8_t* deserialize_indexed(const ZnSerializeBuffer& in, t& v)
+    {
+        return deserialize_indexed(in.data(), in.data() + in.size(), v);
+    }
+
+    // 打开一条带索引的消息, 只检查偏移表, 不解码任何成员
+    template<typename t>
+    inline IndexedView<t> indexed_view(const uint8_t* begin, const uint8_t* end)
+    {
+        static_assert(IsZnStruct<t>::value, "indexed_view requires a ZN_STRUCT");
+        return IndexedView<t>(begin, end);
+    }
+
+    template<typename t>
+    inline IndexedView<t> indexed_view(const ZnSerializeBuffer& in)
+    {
+        return indexed_view<t>(in.data(), in.data() + in.size());
+    }
+};
@@ -0,0 +1,219 @@
+/*
+ * 投影解码: 只解码指定的成员, 其他成员按长度前缀与固定长度跳过, 不构造任何对象
+ * 元素可以整块拷贝的容器(如std::vector<int>)在跳过时只需移动一次位置
+*/
+#pragma once
+#include "zn_serialize.hpp"
+
+namespace zn_serialize
+{
+    // 跳过一个t类型的值, 特化Skipper可以支持自定义类型, 没有特化的类型解码到临时对象后丢弃
+    template<typename t, bool is_struct = IsZnStruct<t>::value, bool is_value = std::is_arithmetic<t>::value || std::is_enum<t>::value>
+    struct Skipper
+    {
+        template<typename format_t>
+        static void skip(Reader<format_t>& in)
+        {
+            t v;
+            deserialize(in, v);
+        }
+    };
+
+    template<typename format_t, typename t>
+    inline void skip_value(Reader<format_t>& in)
+    {
+        Skipper<t>::skip(in);
+    }
+
+    template<typename t>
+    struct Skipper<t, false, true>
+    {
+        template<typename format_t>
+        static void skip(Reader<format_t>& in)
+        {
+            skip(in, std::integral_constant<bool, IsVarint<t>::value && std::is_same<format_t, CompactFormat>::value>());
+        }
+    private:
+        template<typename format_t>
+        static void skip(Reader<format_t>& in, std::true_type)
+        {
+            read_varint(in, "skip value failed, out of memery");
+        }
+        template<typename format_t>
+        static void skip(Reader<format_t>& in, std::false_type)
+        {
+            read_bytes(in, sizeof(t), "skip value failed, out of memery");
+        }
+    };
+
+    // count个连续的t, 可以整块拷贝时直接跳过count * sizeof(t)个字节
+    template<typename format_t, typename t>
+    inline void skip_items(Reader<format_t>& in, size_t count, std::true_type)
+    {
+        if (count > in.remain() / sizeof(t))
+            throw Exception("skip container failed, out of memery");
+        in.cursor += count * sizeof(t);
+    }
+
+    template<typename format_t, typename t>
+    inline void skip_items(Reader<format_t>& in, size_t count, std::false_type)
+    {
+        for (size_t i = 0; i < count; ++i)
+            skip_value<format_t, t>(in);
+    }
+
+    template<typename format_t, typename t>
+    inline void skip_items(Reader<format_t>& in, size_t count)
+    {
+        skip_items<format_t, t>(in, count, IsBulkFor<format_t, t>());
+    }
+
+    // 字符串与视图: 长度前缀之后为原始字节
+    struct SkipBytes
+    {
+        template<typename format_t>
+        static void skip(Reader<format_t>& in)
+        {
+            uint32_t size = read_size(in, "skip string failed, out of memery");
+            read_bytes(in, size, "skip string failed, out of memery");
+        }
+    };
+
+    template<typename tr, typename a> struct Skipper<std::basic_string<char, tr, a>, false, false> : public SkipBytes {};
+    template<typename tr, typename a> struct Skipper<std::basic_string<wchar_t, tr, a>, false, false> : public SkipBytes {};
+    template<> struct Skipper<StringView, false, false> : public SkipBytes {};
+
+    template<typename t>
+    struct SkipSequence
+    {
+        template<typename format_t>
+        static void skip(Reader<format_t>& in)
+        {
+            skip_items<format_t, t>(in, read_size(in, "skip container failed, out of memery"));
+        }
+    };
+
+    template<typename t> struct Skipper<ArrayView<t>, false, false> : public SkipSequence<t> {};
+    template<typename t, typename a> struct Skipper<std::vector<t, a>, false, false> : public SkipSequence<t> {};
+    template<typename t, typename a> struct Skipper<std::deque<t, a>, false, false> : public SkipSequence<t> {};
+    template<typename t, typename a> struct Skipper<std::list<t, a>, false, false> : public SkipSequence<t> {};
+    template<typename t, typename c, typename a> struct Skipper<std::set<t, c, a>, false, false> : public SkipSequence<t> {};
+    template<typename t, typename c, typename a> struct Skipper<std::multiset<t, c, a>, false, false> : public SkipSequence<t> {};
+    template<typename t, typename h, typename e, typename a> struct Skipper<std::unordered_set<t, h, e, a>, false, false> : public SkipSequence<t> {};
+    template<typename t, typename h, typename e, typename a> struct Skipper<std::unordered_multiset<t, h, e, a>, false, false> : public SkipSequence<t> {};
+
+    template<typename k, typename t>
+    struct SkipMap
+    {
+        template<typename format_t>
+        static void skip(Reader<format_t>& in)
+        {
+            uint32_t size = read_size(in, "skip map failed, out of memery");
+            for (uint32_t i = 0; i < size; ++i)
+            {
+                skip_value<format_t, k>(in);
+                skip_value<format_t, t>(in);
+            }
+        }
+    };
+
+    template<typename k, typename t, typename c, typename a> struct Skipper<std::map<k, t, c, a>, false, false> : public SkipMap<k, t> {};
+    template<typename k, typename t, typename c, typename a> struct Skipper<std::multimap<k, t, c, a>, false, false> : public SkipMap<k, t> {};
+    template<typename k, typename t, typename h, typename e, typename a> struct Skipper<std::unordered_map<k, t, h, e, a>, false, false> : public SkipMap<k, t> {};
+    template<typename k, typename t, typename h, typename e, typename a> struct Skipper<std::unordered_multimap<k, t, h, e, a>, false, false> : public SkipMap<k, t> {};
+
+    template<typename t, size_t s>
+    struct Skipper<t[s], false, false>
+    {
+        template<typename format_t>
+        static void skip(Reader<format_t>& in)
+        {
+            skip_items<format_t, t>(in, s);
+        }
+    };
+
+    template<typename t, size_t s> struct Skipper<std::array<t, s>, false, false> : public Skipper<t[s], false, false> {};
+    template<typename t> struct Skipper<std::shared_ptr<t>, false, false> : public Skipper<t> {};
+
+    template<typename...t>
+    struct Skipper<std::tuple<t...>, false, false>
+    {
+        template<typename format_t>
+        static void skip(Reader<format_t>& in)
+        {
+            int expand[] = { 0, (skip_value<format_t, t>(in), 0)... };
+            (void)expand;
+        }
+    };
+
+    template<typename format_t>
+    struct SkipVisitor
+    {
+        Reader<format_t>& in;
+        template<typename m>
+        void operator()(const m*)
+        {
+            skip_value<format_t, m>(in);
+        }
+    };
+
+    // 结构体先跳过基类, 再按ZN_SERIALIZE中成员的类型逐个跳过, 不构造对象
+    template<typename t>
+    struct Skipper<t, true, false>
+    {
+        template<typename format_t>
+        static void skip(Reader<format_t>& in)
+        {
+            SkipVisitor<format_t> visitor = { in };
+            visit_types(visitor, typename t::ZnParents());
+            t::visit_member_types(visitor);
+        }
+    };
+
+    template<typename format_t, size_t count>
+    struct ProjectVisitor
+    {
+        Reader<format_t>& in;
+        const void* (&fields)[count];
+        template<typename m>
+        void operator()(m& v)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (fields[i] == std::addressof(v))
+                {
+                    deserialize(in, v);
+                    return;
+                }
+            }
+            skip_value<format_t, m>(in);
+        }
+    };
+
+    // 只解码v中由成员指针指定的成员(可以是基类的成员), 其他成员跳过, 返回消息之后的位置
+    // deserialize_fields(begin, end, child, &Child::name, &Normal::a)
+    template<typename t, typename...members_t, typename...classes_t>
+    inline const uint8_t* deserialize_fields(const uint8_t* begin, const uint8_t* end, t& v, members_t classes_t::*...members)
+    {
+        const void* fields[sizeof...(members) + 1] = { std::addressof(static_cast<classes_t&>(v).*members)..., nullptr };
+        Reader<typename t::ZnFormat> in(begin, end);
+        ProjectVisitor<typename t::ZnFormat, sizeof...(members) + 1> visitor = { in, fields };
+        v.visit_members(visitor);
+        return in.cursor;
+    }
+
+    template<typename t, typename...members_t, typename...classes_t>
+    inline void deserialize_fields(const ZnSerializeBuffer& in, t& v, members_t classes_t::*...members)
+    {
+        deserialize_fields(in.data(), in.data() + in.size(), v, members...);
+    }
+
+    // 跳过一条完整的消息, 返回消息之后的位置
+    template<typename t>
+    inline const uint8_t* skip_message(const uint8_t* begin, const uint8_t* end)
+    {
+        Reader<typename t::ZnFormat> in(begin, end);
+        skip_value<typename t::ZnFormat, t>(in);
+        return in.cursor;
+    }
+};
@@ -0,0 +1,320 @@
+/*
+ * 环形缓冲区: 生产者按消息的准确长度预留空间, 直接编码到缓冲区中后提交, 消费者原地读取连续的记录, 中间不分配内存也不拷贝
+ * 记录格式(本机字节序, 8字节对齐): uint32_t 记录总长度 + uint32_t 消息长度 + 消息字节
+ *   记录不会跨越缓冲区末尾, 末尾剩余空间不足时先写入一条填充记录, 消息从缓冲区开头写入
+ * SpscRing: 单生产者单消费者, 提交时发布写入位置
+ * MpscRing: 多生产者单消费者, 生产者用CAS预留空间, 提交时发布记录头的长度, 消费者按顺序读到第一条未提交的记录为止
+ *   消费者释放时把读过的区域清零, 记录头不为0即表示已提交
+*/
+#pragma once
+#include "zn_serialize.hpp"
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace zn_serialize
+{
+    const uint32_t RingPadding = 0xFFFFFFFF;
+    const size_t RingHeaderSize = sizeof(uint32_t) * 2;
+    const size_t RingAlignment = 8;
+    const size_t RingCacheLine = 64;
+
+    // 预留的空间, 生产者写入[data, data + size)后提交
+    struct RingSlot
+    {
+        uint8_t* data;
+        size_t size;
+        uint64_t end;
+    };
+
+    // 一条已提交的消息, 释放之前一直有效
+    struct RingRecord
+    {
+        const uint8_t* begin;
+        const uint8_t* end;
+        uint64_t next;
+        size_t size() const { return static_cast<size_t>(end - begin); }
+    };
+
+    template<bool multi_producer>
+    class RingBuffer
+    {
+    public:
+        // capacity向上取整为2的幂, 单条消息最长为容量的一半减去记录头
+        explicit RingBuffer(size_t capacity)
+            : capacity_(RingCacheLine), tail_(0), head_cache_(0), head_(0), read_(0), tail_cache_(0)
+        {
+            // 先检查再取整, 过大的capacity取整时会溢出
+            if (capacity / 2 > UINT32_MAX)
+                throw Exception("ring buffer capacity too large");
+            while (capacity_ < capacity)
+                capacity_ <<= 1;
+            if (capacity_ / 2 > UINT32_MAX)
+                throw Exception("ring buffer capacity too large");
+            mask_ = capacity_ - 1;
+            storage_.reset(new uint64_t[capacity_ / sizeof(uint64_t)]());
+            data_ = reinterpret_cast<uint8_t*>(storage_.get());
+        }
+        RingBuffer(const RingBuffer&) = delete;
+        RingBuffer& operator=(const RingBuffer&) = delete;
+        size_t capacity() const { return static_cast<size_t>(capacity_); }
+        size_t max_message_size() const { return static_cast<size_t>(capacity_ / 2 - RingHeaderSize); }
+
+        // 生产者: 预留size个字节, 空间不足时返回false, 超过max_message_size时抛出异常
+        // SpscRing同时只能有一个未提交的预留, MpscRing每个生产者线程各一个
+        bool try_reserve(size_t size, RingSlot& slot)
+        {
+            if (size > max_message_size())
+                throw Exception("serialize failed, message larger than ring buffer");
+            uint64_t length = record_length(size);
+            uint64_t position, pad;
+            if (!claim(length, position, pad, Multi()))
+                return false;
+            if (pad)
+                write_padding(position - pad, pad);
+            uint8_t* p = data_ + (position & mask_);
+            store_word(p + sizeof(uint32_t), static_cast<uint32_t>(size));
+            slot.data = p + RingHeaderSize;
+            slot.size = size;
+            slot.end = position + length;
+            return true;
+        }
+        // 生产者: 提交后消费者可以读到这条消息
+        void commit(const RingSlot& slot)
+        {
+            publish(slot.data - RingHeaderSize, static_cast<uint32_t>(record_length(slot.size)), slot.end, Multi());
+        }
+        // 生产者: 放弃预留的空间, 消费者跳过它
+        void cancel(const RingSlot& slot)
+        {
+            store_word(slot.data - sizeof(uint32_t), RingPadding);
+            commit(slot);
+        }
+
+        // 生产者: 按结构体声明的格式编码, 空间不足时返回false
+        template<typename t>
+        bool try_push(const t& v)
+        {
+            return push_sized(v, message_size(v));
+        }
+        // 生产者: 空间不足时让出线程后重试
+        template<typename t>
+        void push(const t& v)
+        {
+            size_t size = message_size(v);
+            while (!push_sized(v, size))
+                std::this_thread::yield();
+        }
+
+        // 消费者: 读取下一条已提交的消息, 没有时返回false
+        // 可以连续读取多条, 释放某一条时它和它之前读过的消息一起释放
+        bool try_read(RingRecord& record)
+        {
+            for (;;)
+            {
+                uint8_t* p = data_ + (read_ & mask_);
+                uint32_t length = committed_length(p, Multi());
+                if (!length)
+                    return false;
+                uint32_t size = load_word(p + sizeof(uint32_t));
+                read_ += length;
+                if (size != RingPadding)
+                {
+                    record.begin = p + RingHeaderSize;
+                    record.end = record.begin + size;
+                    record.next = read_;
+                    return true;
+                }
+            }
+        }
+        // 消费者: 释放record及之前的消息, 空间交还给生产者
+        void release(const RingRecord& record)
+        {
+            release_to(record.next, Multi());
+        }
+
+        // 消费者: 解码下一条消息, 没有时返回false, 消息没有正好用完时抛出异常
+        template<typename t>
+        bool try_pop(t& v)
+        {
+            RingRecord record;
+            if (!try_read(record))
+                return false;
+            bool matched = v.deserialize(record.begin, record.end) == record.end;
+            release(record);
+            if (!matched)
+                throw Exception("deserialize failed, message size mismatch");
+            return true;
+        }
+        // 消费者: 没有消息时让出线程后重试
+        template<typename t>
+        void pop(t& v)
+        {
+            while (!try_pop(v))
+                std::this_thread::yield();
+        }
+        // 消费者: 对已提交的消息(最多limit条)依次调用fn(begin, end), 最后一次性释放, 返回处理的条数
+        template<typename fn_t>
+        size_t consume(fn_t fn, size_t limit = SIZE_MAX)
+        {
+            RingRecord record;
+            size_t count = 0;
+            while (count < limit && try_read(record))
+            {
+                fn(record.begin, record.end);
+                ++count;
+            }
+            if (count)
+                release(record);
+            return count;
+        }
+    private:
+        typedef std::integral_constant<bool, multi_producer> Multi;
+
+        static uint64_t record_length(size_t size)
+        {
+            return (RingHeaderSize + size + RingAlignment - 1) & ~static_cast<uint64_t>(RingAlignment - 1);
+        }
+        static std::atomic<uint32_t>& length_word(uint8_t* p)
+        {
+            static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "atomic uint32_t must have the same size as uint32_t");
+            return *reinterpret_cast<std::atomic<uint32_t>*>(p);
+        }
+        static void store_word(uint8_t* p, uint32_t v)
+        {
+            memcpy(p, &v, sizeof(v));
+        }
+        static uint32_t load_word(const uint8_t* p)
+        {
+            uint32_t v;
+            memcpy(&v, p, sizeof(v));
+            return v;
+        }
+        // 末尾放不下时从开头写入, 容量的一半以内的记录在缓冲区为空时总能放下
+        uint64_t padding(uint64_t tail, uint64_t length) const
+        {
+            uint64_t offset = tail & mask_;
+            return offset + length > capacity_ ? capacity_ - offset : 0;
+        }
+        void write_padding(uint64_t position, uint64_t pad)
+        {
+            uint8_t* p = data_ + (position & mask_);
+            store_word(p + sizeof(uint32_t), RingPadding);
+            length_word(p).store(static_cast<uint32_t>(pad), std::memory_order_release);
+        }
+
+        // 写入位置只由唯一的生产者修改, 提交时才发布
+        bool claim(uint64_t length, uint64_t& position, uint64_t& pad, std::false_type)
+        {
+            uint64_t tail = tail_.load(std::memory_order_relaxed);
+            pad = padding(tail, length);
+            if (tail + pad + length - head_cache_ > capacity_)
+            {
+                head_cache_ = head_.load(std::memory_order_acquire);
+                if (tail + pad + length - head_cache_ > capacity_)
+                    return false;
+            }
+            position = tail + pad;
+            return true;
+        }
+        // 先读释放位置再读写入位置, 保证读到的写入位置不小于释放位置
+        bool claim(uint64_t length, uint64_t& position, uint64_t& pad, std::true_type)
+        {
+            for (;;)
+            {
+                uint64_t head = head_.load(std::memory_order_acquire);
+                uint64_t tail = tail_.load(std::memory_order_relaxed);
+                pad = padding(tail, length);
+                if (tail + pad + length - head > capacity_)
+                    return false;
+                if (tail_.compare_exchange_weak(tail, tail + pad + length, std::memory_order_relaxed))
+                {
+                    position = tail + pad;
+                    return true;
+                }
+            }
+        }
+        void publish(uint8_t* p, uint32_t length, uint64_t end, std::false_type)
+        {
+            length_word(p).store(length, std::memory_order_relaxed);
+            tail_.store(end, std::memory_order_release);
+        }
+        void publish(uint8_t* p, uint32_t length, uint64_t end, std::true_type)
+        {
+            length_word(p).store(length, std::memory_order_release);
+        }
+
+        uint32_t committed_length(uint8_t* p, std::false_type)
+        {
+            if (read_ == tail_cache_)
+            {
+                tail_cache_ = tail_.load(std::memory_order_acquire);
+                if (read_ == tail_cache_)
+                    return 0;
+            }
+            return length_word(p).load(std::memory_order_relaxed);
+        }
+        // 读过但还没释放的记录没有清零, 读满一圈时停下
+        uint32_t committed_length(uint8_t* p, std::true_type)
+        {
+            if (read_ - head_.load(std::memory_order_relaxed) == capacity_)
+                return 0;
+            return length_word(p).load(std::memory_order_acquire);
+        }
+        void release_to(uint64_t next, std::false_type)
+        {
+            head_.store(next, std::memory_order_release);
+        }
+        // 清零之后生产者才能重新预留这段空间
+        void release_to(uint64_t next, std::true_type)
+        {
+            uint64_t head = head_.load(std::memory_order_relaxed);
+            while (head != next)
+            {
+                uint64_t offset = head & mask_;
+                uint64_t count = next - head < capacity_ - offset ? next - head : capacity_ - offset;
+                memset(data_ + offset, 0, static_cast<size_t>(count));
+                head += count;
+            }
+            head_.store(next, std::memory_order_release);
+        }
+
+        template<typename t>
+        bool push_sized(const t& v, size_t size)
+        {
+            RingSlot slot;
+            if (!try_reserve(size, slot))
+                return false;
+            try
+            {
+                CursorSink cursor(slot.data);
+                FormatSink<typename t::ZnFormat, CursorSink> sink(cursor);
+                v.serialize_to(sink);
+            }
+            catch (...)
+            {
+                cancel(slot);
+                throw;
+            }
+            commit(slot);
+            return true;
+        }
+
+        // 只读的成员, 生产者的成员, 消费者的成员各占独立的缓存行
+        std::unique_ptr<uint64_t[]> storage_;
+        uint8_t* data_;
+        uint64_t capacity_;
+        uint64_t mask_;
+        char producer_pad_[RingCacheLine];
+        std::atomic<uint64_t> tail_;
+        uint64_t head_cache_;
+        char consumer_pad_[RingCacheLine];
+        std::atomic<uint64_t> head_;
+        uint64_t read_;
+        uint64_t tail_cache_;
+        char end_pad_[RingCacheLine];
+    };
+
+    typedef RingBuffer<false> SpscRing;
+    typedef RingBuffer<true> MpscRing;
+};
@@ -0,0 +1,812 @@
+/*
+ * 流式反序列化: 数据分块到达时逐块解码, 不需要等待完整的消息
+ * 解码器记录当前在类型树中的位置, 每块数据只处理一次
+*/
+#pragma once
+#include "zn_serialize.hpp"
+
+namespace zn_serialize
+{
+    enum class StreamStatus
+    {
+        NeedMore,   // 数据不足, 等待下一块
+        Done,       // 解码完成
+        Error       // 数据错误或类型不支持, 见StreamDecoder::error()
+    };
+
+    struct StreamOptions
+    {
+        StreamOptions()
+            : max_length(0xFFFFFFFF)
+        {}
+        // 字符串与容器长度前缀的上限, 超出视为数据错误, 避免错误的数据导致无限等待
+        // 字符串与数值vector随着数据的到达逐步扩大, 长度前缀本身不会导致分配内存
+        uint32_t max_length;
+    };
+
+    struct StreamState
+    {
+        virtual ~StreamState() {}
+        // 消费[p, end)中的字节, 返回true表示这个值已经完整解码
+        virtual bool feed(const uint8_t*& p, const uint8_t* end) = 0;
+    };
+
+    // 特化StreamStateOf可以支持自定义类型, 需要提供:
+    //   StreamStateOf(t& v, const StreamOptions& options)
+    //   static bool try_decode(const uint8_t*& p, const uint8_t* end, t& v, const StreamOptions& options)
+    //     数据足够时直接解码并返回true, 否则不消费任何字节并返回false
+    //   bool feed(const uint8_t*& p, const uint8_t* end)
+    template<typename t, bool is_struct = IsZnStruct<t>::value>
+    class StreamStateOf;
+
+    // 按字节拷贝到目标内存, 可以跨越多个数据块
+    class BytesState
+    {
+    public:
+        BytesState()
+            : dest_(nullptr), size_(0), done_(0)
+        {}
+        BytesState(void* dest, size_t size)
+            : dest_(static_cast<uint8_t*>(dest)), size_(size), done_(0)
+        {}
+        bool feed(const uint8_t*& p, const uint8_t* end)
+        {
+            size_t count = size_ - done_;
+            if (count > static_cast<size_t>(end - p))
+                count = static_cast<size_t>(end - p);
+            if (count)
+                memcpy(dest_ + done_, p, count);
+            done_ += count;
+            p += count;
+            return done_ == size_;
+        }
+    private:
+        uint8_t* dest_;
+        size_t size_;
+        size_t done_;
+    };
+
+    // 按到达的字节逐步扩大容器(字符串, 数值vector)并追加写入, 字节可以跨越多个数据块, 也可以只到达元素的一部分
+    template<typename container_t>
+    class GrowState
+    {
+        typedef typename container_t::value_type value_type;
+    public:
+        GrowState()
+            : v_(nullptr), offset_(0), size_(0), done_(0)
+        {}
+        GrowState(container_t& v, size_t size)
+            : v_(&v), offset_(v.size() * sizeof(value_type)), size_(size), done_(0)
+        {}
+        bool feed(const uint8_t*& p, const uint8_t* end)
+        {
+            size_t count = size_ - done_;
+            if (count > static_cast<size_t>(end - p))
+                count = static_cast<size_t>(end - p);
+            if (count)
+            {
+                v_->resize((offset_ + done_ + count + sizeof(value_type) - 1) / sizeof(value_type));
+                memcpy(reinterpret_cast<uint8_t*>(&(*v_)[0]) + offset_ + done_, p, count);
+                done_ += count;
+                p += count;
+            }
+            return done_ == size_;
+        }
+    private:
+        container_t* v_;
+        size_t offset_;
+        size_t size_;
+        size_t done_;
+    };
+
+    // uint32_t长度前缀
+    class LengthState
+    {
+    public:
+        LengthState()
+            : value_(0), done_(0)
+        {}
+        bool feed(const uint8_t*& p, const uint8_t* end, const StreamOptions& options)
+        {
+            while (done_ < sizeof(value_) && p < end)
+                bytes_[done_++] = *p++;
+            if (done_ < sizeof(value_))
+                return false;
+            memcpy(&value_, bytes_, sizeof(value_));
+            check(value_, options);
+            return true;
+        }
+        uint32_t value() const { return value_; }
+        static bool try_decode(const uint8_t*& p, const uint8_t* end, uint32_t& value, const StreamOptions& options)
+        {
+            if (static_cast<size_t>(end - p) < sizeof(value))
+                return false;
+            memcpy(&value, p, sizeof(value));
+            check(value, options);
+            p += sizeof(value);
+            return true;
+        }
+        static void check(uint32_t value, const StreamOptions& options)
+        {
+            if (value > options.max_length)
+                throw Exception("stream deserialize failed, length out of limit");
+        }
+    private:
+        uint32_t value_;
+        size_t done_;
+        uint8_t bytes_[sizeof(uint32_t)];
+    };
+
+    // 依次解码一组成员, 当前成员数据足够时直接解码, 不足时为它创建状态等待后续数据
+    struct MemberFeeder
+    {
+        MemberFeeder(const uint8_t*& p, const uint8_t* end, const StreamOptions& options, size_t index)
+            : p(p), end(end), options(options), index(index), position(0)
+        {}
+        template<typename m>
+        void operator()(m& member)
+        {
+            if (state || position++ < index)
+                return;
+            if (StreamStateOf<m>::try_decode(p, end, member, options))
+                ++index;
+            else
+                state.reset(new StreamStateOf<m>(member, options));
+        }
+        const uint8_t*& p;
+        const uint8_t* end;
+        const StreamOptions& options;
+        size_t index;
+        size_t position;
+        std::unique_ptr<StreamState> state;
+    };
+
+    template<size_t i, size_t n>
+    struct VisitTuple
+    {
+        template<typename tuple_t, typename visitor_t>
+        void operator()(tuple_t& tuple, visitor_t& visitor)
+        {
+            visitor(std::get<i>(tuple));
+            VisitTuple<i + 1, n>()(tuple, visitor);
+        }
+    };
+
+    template<size_t n>
+    struct VisitTuple<n, n>
+    {
+        template<typename tuple_t, typename visitor_t>
+        void operator()(tuple_t& tuple, visitor_t& visitor)
+        {}
+    };
+
+    template<typename t, typename visitor_t>
+    inline void visit_fields(t& v, visitor_t& visitor)
+    {
+        v.visit_members(visitor);
+    }
+
+    template<typename visitor_t, typename...t>
+    inline void visit_fields(std::tuple<t...>& v, visitor_t& visitor)
+    {
+        VisitTuple<0, sizeof...(t)>()(v, visitor);
+    }
+
+    template<typename visitor_t, typename k, typename t>
+    inline void visit_fields(std::pair<k, t>& v, visitor_t& visitor)
+    {
+        visitor(v.first);
+        visitor(v.second);
+    }
+
+    // 结构体, tuple, pair: 按顺序解码各个成员
+    template<typename t>
+    class FieldsState : public StreamState
+    {
+    public:
+        FieldsState(t& v, const StreamOptions& options)
+            : v_(v), options_(options), index_(0)
+        {}
+        static bool try_decode(const uint8_t*& p, const uint8_t* end, t& v, const StreamOptions& options)
+        {
+            return false;
+        }
+        bool feed(const uint8_t*& p, const uint8_t* end)
+        {
+            for (;;)
+            {
+                if (current_)
+                {
+                    if (!current_->feed(p, end))
+                        return false;
+                    current_.reset();
+                    ++index_;
+                }
+                MemberFeeder feeder(p, end, options_, index_);
+                visit_fields(v_, feeder);
+                index_ = feeder.index;
+                if (!feeder.state)
+                    return true;
+                current_ = std::move(feeder.state);
+            }
+        }
+    private:
+        t& v_;
+        const StreamOptions& options_;
+        size_t index_;
+        std::unique_ptr<StreamState> current_;
+    };
+
+    // 按内存直接拷贝的值
+    template<typename t>
+    class ValueState : public StreamState
+    {
+        static_assert(std::is_trivially_copyable<t>::value, "no stream decoder for this type, specialize zn_serialize::StreamStateOf");
+    public:
+        ValueState(t& v, const StreamOptions& options)
+            : bytes_(&v, sizeof(t))
+        {}
+        static bool try_decode(const uint8_t*& p, const uint8_t* end, t& v, const StreamOptions& options)
+        {
+            if (static_cast<size_t>(end - p) < sizeof(t))
+                return false;
+            memcpy(&v, p, sizeof(t));
+            p += sizeof(t);
+            return true;
+        }
+        bool feed(const uint8_t*& p, const uint8_t* end)
+        {
+            return bytes_.feed(p, end);
+        }
+    private:
+        BytesState bytes_;
+    };
+
+    template<typename t>
+    class StreamStateOf<t, false> : public ValueState<t>
+    {
+    public:
+        StreamStateOf(t& v, const StreamOptions& options)
+            : ValueState<t>(v, options)
+        {}
+    };
+
+    template<typename t>
+    class StreamStateOf<t, true> : public FieldsState<t>
+    {
+    public:
+        StreamStateOf(t& v, const StreamOptions& options)
+            : FieldsState<t>(v, options)
+        {}
+    };
+
+    template<typename...t>
+    class StreamStateOf<std::tuple<t...>, false> : public FieldsState<std::tuple<t...>>
+    {
+    public:
+        StreamStateOf(std::tuple<t...>& v, const StreamOptions& options)
+            : FieldsState<std::tuple<t...>>(v, options)
+        {}
+    };
+
+    template<typename k, typename t>
+    class StreamStateOf<std::pair<k, t>, false> : public FieldsState<std::pair<k, t>>
+    {
+    public:
+        StreamStateOf(std::pair<k, t>& v, const StreamOptions& options)
+            : FieldsState<std::pair<k, t>>(v, options)
+        {}
+    };
+
+    // std::string, std::wstring: 长度前缀为字节数
+    template<typename char_t>
+    class StreamStateOf<std::basic_string<char_t>, false> : public StreamState
+    {
+    public:
+        StreamStateOf(std::basic_string<char_t>& v, const StreamOptions& options)
+            : v_(v), options_(options), has_length_(false)
+        {}
+        static bool try_decode(const uint8_t*& p, const uint8_t* end, std::basic_string<char_t>& v, const StreamOptions& options)
+        {
+            auto q = p;
+            uint32_t size = 0;
+            if (!LengthState::try_decode(q, end, size, options) || static_cast<size_t>(end - q) < size)
+                return false;
+            v.assign(reinterpret_cast<const char_t*>(q), reinterpret_cast<const char_t*>(q + size));
+            p = q + size;
+            return true;
+        }
+        bool feed(const uint8_t*& p, const uint8_t* end)
+        {
+            if (!has_length_)
+            {
+                if (!length_.feed(p, end, options_))
+                    return false;
+                has_length_ = true;
+                v_.clear();
+                bytes_ = GrowState<std::basic_string<char_t>>(v_, length_.value() / sizeof(char_t) * sizeof(char_t));
+                skip_ = length_.value() % sizeof(char_t);
+            }
+            if (!bytes_.feed(p, end))
+                return false;
+            // 与deserialize一致, 忽略不足一个字符的尾部字节
+            for (; skip_ && p < end; --skip_)
+                ++p;
+            return skip_ == 0;
+        }
+    private:
+        std::basic_string<char_t>& v_;
+        const StreamOptions& options_;
+        LengthState length_;
+        bool has_length_;
+        GrowState<std::basic_string<char_t>> bytes_;
+        size_t skip_;
+    };
+
+    template<typename t>
+    class StreamStateOf<std::shared_ptr<t>, false> : public StreamState
+    {
+    public:
+        StreamStateOf(std::shared_ptr<t>& v, const StreamOptions& options)
+            : state_(get(v), options)
+        {}
+        static bool try_decode(const uint8_t*& p, const uint8_t* end, std::shared_ptr<t>& v, const StreamOptions& options)
+        {
+            return StreamStateOf<t>::try_decode(p, end, get(v), options);
+        }
+        bool feed(const uint8_t*& p, const uint8_t* end)
+        {
+            return state_.feed(p, end);
+        }
+    private:
+        static t& get(std::shared_ptr<t>& v)
+        {
+            if (!v)
+                v = std::make_shared<t>();
+            return *v;
+        }
+        StreamStateOf<t> state_;
+    };
+
+    // 定长数组: 可整块拷贝的元素直接按字节拷贝, 否则逐个解码
+    template<typename t>
+    class ArrayState : public StreamState
+    {
+    public:
+        ArrayState(t* v, size_t size, const StreamOptions& options)
+            : v_(v), size_(size), options_(options), index_(0), bytes_(v, IsBulk<t>::value ? size * sizeof(t) : 0)
+        {}
+        static bool try_decode(const uint8_t*& p, const uint8_t* end, t* v, size_t size, const StreamOptions& options)
+        {
+            if (!IsBulk<t>::value || static_cast<size_t>(end - p) < size * sizeof(t))
+                return false;
+            memcpy(v, p, size * sizeof(t));
+            p += size * sizeof(t);
+            return true;
+        }
+        bool feed(const uint8_t*& p, const uint8_t* end)
+        {
+            if (IsBulk<t>::value)
+                return bytes_.feed(p, end);
+            for (;;)
+            {
+                if (current_)
+                {
+                    if (!current_->feed(p, end))
+                        return false;
+                    current_.reset();
+                    ++index_;
+                }
+                for (; index_ < size_ && StreamStateOf<t>::try_decode(p, end, v_[index_], options_); ++index_)
+                    ;
+                if (index_ == size_)
+                    return true;
+                current_.reset(new StreamStateOf<t>(v_[index_], options_));
+            }
+        }
+    private:
+        t* v_;
+        size_t size_;
+        const StreamOptions& options_;
+        size_t index_;
+        BytesState bytes_;
+        std::unique_ptr<StreamState> current_;
+    };
+
+    template<typename t, size_t s>
+    class StreamStateOf<t[s], false> : public ArrayState<t>
+    {
+    public:
+        StreamStateOf(t(&v)[s], const StreamOptions& options)
+            : ArrayState<t>(v, s, options)
+        {}
+        static bool try_decode(const uint8_t*& p, const uint8_t* end, t(&v)[s], const StreamOptions& options)
+        {
+            return ArrayState<t>::try_decode(p, end, v, s, options);
+        }
+    };
+
+    template<typename t, size_t s>
+    class StreamStateOf<std::array<t, s>, false> : public ArrayState<t>
+    {
+    public:
+        StreamStateOf(std::array<t, s>& v, const StreamOptions& options)
+            : ArrayState<t>(v.data(), s, options)
+        {}
+        static bool try_decode(const uint8_t*& p, const uint8_t* end, std::array<t, s>& v, const StreamOptions& options)
+        {
+            return ArrayState<t>::try_decode(p, end, v.data(), s, options);
+        }
+    };
+
+    // 可整块拷贝元素的std::vector: 读到长度后按到达的字节扩大vector, 直接拷贝到vector的内存
+    template<typename t>
+    class BulkVectorState : public StreamState
+    {
+    public:
+        BulkVectorState(std::vector<t>& v, const StreamOptions& options)
+            : v_(v), options_(options), has_length_(false)
+        {}
+        static bool try_decode(const uint8_t*& p, const uint8_t* end, std::vector<t>& v, const StreamOptions& options)
+        {
+            auto q = p;
+            uint32_t size = 0;
+            if (!LengthState::try_decode(q, end, size, options) || static_cast<size_t>(end - q) / sizeof(t) < size)
+                return false;
+            p = deserialize(p, end, v);
+            return true;
+        }
+        bool feed(const uint8_t*& p, const uint8_t* end)
+        {
+            if (!has_length_)
+            {
+                if (!length_.feed(p, end, options_))
+                    return false;
+                has_length_ = true;
+                bytes_ = GrowState<std::vector<t>>(v_, length_.value() * sizeof(t));
+            }
+            return bytes_.feed(p, end);
+        }
+    private:
+        std::vector<t>& v_;
+        const StreamOptions& options_;
+        LengthState length_;
+        bool has_length_;
+        GrowState<std::vector<t>> bytes_;
+    };
+
+    // 逐个解码元素的容器, inserter_t负责准备元素与放入容器
+    template<typename container_t, typename inserter_t>
+    class ContainerState : public StreamState
+    {
+        typedef typename inserter_t::item_type item_type;
+    public:
+        ContainerState(container_t& v, const StreamOptions& options)
+            : v_(v), options_(options), has_length_(false), remain_(0), item_(nullptr)
+        {}
+        static bool try_decode(const uint8_t*& p, const uint8_t* end, container_t& v, const StreamOptions& options)
+        {
+            return false;
+        }
+        bool feed(const uint8_t*& p, const uint8_t* end)
+        {
+            if (!has_length_)
+            {
+                if (!length_.feed(p, end, options_))
+                    return false;
+                has_length_ = true;
+                remain_ = length_.value();
+            }
+            for (;;)
+            {
+                if (current_)
+                {
+                    if (!current_->feed(p, end))
+                        return false;
+                    current_.reset();
+                    inserter_.commit(v_, *item_);
+                }
+                for (; remain_; --remain_)
+                {
+                    item_ = &inserter_.prepare(v_);
+                    if (!StreamStateOf<item_type>::try_decode(p, end, *item_, options_))
+                        break;
+                    inserter_.commit(v_, *item_);
+                }
+                if (!remain_)
+                    return true;
+                --remain_;
+                current_.reset(new StreamStateOf<item_type>(*item_, options_));
+            }
+        }
+    private:
+        container_t& v_;
+        const StreamOptions& options_;
+        LengthState length_;
+        bool has_length_;
+        uint32_t remain_;
+        inserter_t inserter_;
+        item_type* item_;
+        std::unique_ptr<StreamState> current_;
+    };
+
+    // vector, deque, list: 直接在容器末尾构造元素再解码
+    template<typename container_t>
+    struct BackInserter
+    {
+        typedef typename container_t::value_type item_type;
+        item_type& prepare(container_t& v)
+        {
+            v.push_back(item_type());
+            return v.back();
+        }
+        void commit(container_t& v, item_type& item)
+        {}
+    };
+
+    // std::vector<bool>的元素不能取引用, 先解码到临时变量
+    template<>
+    struct BackInserter<std::vector<bool>>
+    {
+        typedef bool item_type;
+        item_type& prepare(std::vector<bool>& v)
+        {
+            item = false;
+            return item;
+        }
+        void commit(std::vector<bool>& v, item_type& item)
+        {
+            v.push_back(item);
+        }
+        item_type item;
+    };
+
+    // set, map: 先解码到临时元素, 完成后再插入到末尾, 有序的输入重建为线性时间
+    template<typename container_t, typename item_t>
+    struct TempInserter
+    {
+        typedef item_t item_type;
+        item_type& prepare(container_t& v)
+        {
+            item = item_type();
+            return item;
+        }
+        void commit(container_t& v, item_type& item)
+        {
+            v.insert(v.end(), std::move(item));
+        }
+        item_type item;
+    };
+
+    template<typename t>
+    class StreamStateOf<std::vector<t>, false>
+        : public std::conditional<IsBulkSequence<std::vector<t>>::value, BulkVectorState<t>, ContainerState<std::vector<t>, BackInserter<std::vector<t>>>>::type
+    {
+        typedef typename std::conditional<IsBulkSequence<std::vector<t>>::value, BulkVectorState<t>, ContainerState<std::vector<t>, BackInserter<std::vector<t>>>>::type base_t;
+    public:
+        StreamStateOf(std::vector<t>& v, const StreamOptions& options)
+            : base_t(v, options)
+        {}
+    };
+
+    template<typename t>
+    class StreamStateOf<std::deque<t>, false> : public ContainerState<std::deque<t>, BackInserter<std::deque<t>>>
+    {
+    public:
+        StreamStateOf(std::deque<t>& v, const StreamOptions& options)
+            : ContainerState<std::deque<t>, BackInserter<std::deque<t>>>(v, options)
+        {}
+    };
+
+    template<typename t>
+    class StreamStateOf<std::list<t>, false> : public ContainerState<std::list<t>, BackInserter<std::list<t>>>
+    {
+    public:
+        StreamStateOf(std::list<t>& v, const StreamOptions& options)
+            : ContainerState<std::list<t>, BackInserter<std::list<t>>>(v, options)
+        {}
+    };
+
+    template<typename t>
+    class StreamStateOf<std::set<t>, false> : public ContainerState<std::set<t>, TempInserter<std::set<t>, t>>
+    {
+    public:
+        StreamStateOf(std::set<t>& v, const StreamOptions& options)
+            : ContainerState<std::set<t>, TempInserter<std::set<t>, t>>(v, options)
+        {}
+    };
+
+    template<typename t>
+    class StreamStateOf<std::multiset<t>, false> : public ContainerState<std::multiset<t>, TempInserter<std::multiset<t>, t>>
+    {
+    public:
+        StreamStateOf(std::multiset<t>& v, const StreamOptions& options)
+            : ContainerState<std::multiset<t>, TempInserter<std::multiset<t>, t>>(v, options)
+        {}
+    };
+
+    template<typename k, typename t>
+    class StreamStateOf<std::map<k, t>, false> : public ContainerState<std::map<k, t>, TempInserter<std::map<k, t>, std::pair<k, t>>>
+    {
+    public:
+        StreamStateOf(std::map<k, t>& v, const StreamOptions& options)
+            : ContainerState<std::map<k, t>, TempInserter<std::map<k, t>, std::pair<k, t>>>(v, options)
+        {}
+    };
+
+    template<typename k, typename t>
+    class StreamStateOf<std::multimap<k, t>, false> : public ContainerState<std::multimap<k, t>, TempInserter<std::multimap<k, t>, std::pair<k, t>>>
+    {
+    public:
+        StreamStateOf(std::multimap<k, t>& v, const StreamOptions& options)
+            : ContainerState<std::multimap<k, t>, TempInserter<std::multimap<k, t>, std::pair<k, t>>>(v, options)
+        {}
+    };
+
+    template<typename t>
+    class StreamStateOf<std::unordered_set<t>, false> : public ContainerState<std::unordered_set<t>, TempInserter<std::unordered_set<t>, t>>
+    {
+    public:
+        StreamStateOf(std::unordered_set<t>& v, const StreamOptions& options)
+            : ContainerState<std::unordered_set<t>, TempInserter<std::unordered_set<t>, t>>(v, options)
+        {}
+    };
+
+    template<typename t>
+    class StreamStateOf<std::unordered_multiset<t>, false> : public ContainerState<std::unordered_multiset<t>, TempInserter<std::unordered_multiset<t>, t>>
+    {
+    public:
+        StreamStateOf(std::unordered_multiset<t>& v, const StreamOptions& options)
+            : ContainerState<std::unordered_multiset<t>, TempInserter<std::unordered_multiset<t>, t>>(v, options)
+        {}
+    };
+
+    template<typename k, typename t>
+    class StreamStateOf<std::unordered_map<k, t>, false> : public ContainerState<std::unordered_map<k, t>, TempInserter<std::unordered_map<k, t>, std::pair<k, t>>>
+    {
+    public:
+        StreamStateOf(std::unordered_map<k, t>& v, const StreamOptions& options)
+            : ContainerState<std::unordered_map<k, t>, TempInserter<std::unordered_map<k, t>, std::pair<k, t>>>(v, options)
+        {}
+    };
+
+    template<typename k, typename t>
+    class StreamStateOf<std::unordered_multimap<k, t>, false> : public ContainerState<std::unordered_multimap<k, t>, TempInserter<std::unordered_multimap<k, t>, std::pair<k, t>>>
+    {
+    public:
+        StreamStateOf(std::unordered_multimap<k, t>& v, const StreamOptions& options)
+            : ContainerState<std::unordered_multimap<k, t>, TempInserter<std::unordered_multimap<k, t>, std::pair<k, t>>>(v, options)
+        {}
+    };
+
+    // 与deserialize一致, 不支持的容器解码时报错
+    template<typename container_t>
+    class UnsupportedState : public StreamState
+    {
+    public:
+        UnsupportedState(container_t& v, const StreamOptions& options)
+        {
+            throw Exception("stream deserialize failed, type not allowed");
+        }
+        static bool try_decode(const uint8_t*& p, const uint8_t* end, container_t& v, const StreamOptions& options)
+        {
+            throw Exception("stream deserialize failed, type not allowed");
+        }
+        bool feed(const uint8_t*& p, const uint8_t* end)
+        {
+            return false;
+        }
+    };
+
+    template<typename t>
+    class StreamStateOf<std::stack<t>, false> : public UnsupportedState<std::stack<t>>
+    {
+    public:
+        StreamStateOf(std::stack<t>& v, const StreamOptions& options)
+            : UnsupportedState<std::stack<t>>(v, options)
+        {}
+    };
+
+    template<typename t>
+    class StreamStateOf<std::queue<t>, false> : public UnsupportedState<std::queue<t>>
+    {
+    public:
+        StreamStateOf(std::queue<t>& v, const StreamOptions& options)
+            : UnsupportedState<std::queue<t>>(v, options)
+        {}
+    };
+
+    template<typename t>
+    class StreamStateOf<std::priority_queue<t>, false> : public UnsupportedState<std::priority_queue<t>>
+    {
+    public:
+        StreamStateOf(std::priority_queue<t>& v, const StreamOptions& options)
+            : UnsupportedState<std::priority_queue<t>>(v, options)
+        {}
+    };
+
+    // 视图指向输入的字节流, 而流式解码的数据块用完即释放, 故不支持(只声明不定义, 使用时编译报错)
+    template<>
+    class StreamStateOf<StringView, false>;
+    template<typename t>
+    class StreamStateOf<ArrayView<t>, false>;
+
+    // 流式解码只支持默认格式(FixedFormat)
+    template<typename t, bool is_struct = IsZnStruct<t>::value> struct IsFixedMessage : public std::true_type {};
+    template<typename t> struct IsFixedMessage<t, true> : public std::is_same<typename t::ZnFormat, FixedFormat> {};
+
+    // 流式解码器, 每收到一块数据调用一次feed
+    // 返回Done时, consumed()为本块中属于该消息的字节数, 剩余的字节属于下一条消息
+    template<typename t>
+    class StreamDecoder
+    {
+        static_assert(IsFixedMessage<t>::value, "StreamDecoder only supports FixedFormat");
+    public:
+        explicit StreamDecoder(t& target, const StreamOptions& options = StreamOptions())
+            : target_(target), options_(options), status_(StreamStatus::NeedMore), consumed_(0)
+        {}
+        StreamDecoder(const StreamDecoder&) = delete;
+        StreamDecoder& operator=(const StreamDecoder&) = delete;
+
+        StreamStatus feed(const void* data, size_t size)
+        {
+            consumed_ = 0;
+            if (status_ != StreamStatus::NeedMore)
+                return status_;
+            auto begin = static_cast<const uint8_t*>(data);
+            auto p = begin;
+            try
+            {
+                if (!state_)
+                    state_.reset(new StreamStateOf<t>(target_, options_));
+                if (state_->feed(p, begin + size))
+                {
+                    state_.reset();
+                    status_ = StreamStatus::Done;
+                }
+            }
+            catch (const Exception& e)
+            {
+                fail(e.what());
+            }
+            catch (const std::exception& e)
+            {
+                fail(e.what());
+            }
+            catch (...)
+            {
+                fail("stream deserialize failed, unknown error");
+            }
+            consumed_ = static_cast<size_t>(p - begin);
+            return status_;
+        }
+        StreamStatus feed(const ZnSerializeBuffer& buffer)
+        {
+            return feed(buffer.data(), buffer.size());
+        }
+        // 重新开始解码下一条消息, 与deserialize一致, 容器成员会追加而不是覆盖
+        void reset()
+        {
+            state_.reset();
+            status_ = StreamStatus::NeedMore;
+            consumed_ = 0;
+            error_.clear();
+        }
+        StreamStatus status() const { return status_; }
+        size_t consumed() const { return consumed_; }
+        const std::string& error() const { return error_; }
+    private:
+        void fail(const char* message)
+        {
+            state_.reset();
+            status_ = StreamStatus::Error;
+            error_ = message;
+        }
+        t& target_;
+        StreamOptions options_;
+        StreamStatus status_;
+        size_t consumed_;
+        std::string error_;
+        std::unique_ptr<StreamState> state_;
+    };
+};
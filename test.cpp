@@ -1,4 +1,25 @@
 ﻿#include<ZnSerialize/zn_serialize.hpp>
+#include<ZnSerialize/zn_serialize_stream.hpp>
+#include<ZnSerialize/zn_serialize_batch.hpp>
+#include<ZnSerialize/zn_serialize_arena.hpp>
+#include<ZnSerialize/zn_serialize_file.hpp>
+#include<ZnSerialize/zn_serialize_compress.hpp>
+#include<ZnSerialize/zn_serialize_delta.hpp>
+#include<ZnSerialize/zn_serialize_projection.hpp>
+#include<ZnSerialize/zn_serialize_indexed.hpp>
+#include<ZnSerialize/zn_serialize_checksum.hpp>
+#include<ZnSerialize/zn_serialize_ring.hpp>
+#include<ZnSerialize/zn_serialize_columnar.hpp>
+
+// 调用fn, 抛出zn_serialize::Exception时返回true
+template<typename f>
+bool throws(f fn)
+{
+    try { fn(); }
+    catch (const zn_serialize::Exception&) { return true; }
+    return false;
+}
+
 // 普通序列化
 ZN_STRUCT(Normal)
 {
@@ -144,6 +165,1393 @@ void test6()
     child.deserialize(buf);
 }
 
+#include<cassert>
+// 预先计算序列化长度, 序列化时只分配一次内存
+void test7(Child& child)
+{
+    ZnSerializeBuffer buf;
+    child.serialize(buf);
+    assert(buf.size() == child.serialized_size());
+    assert(buf.capacity() == buf.size());
+    assert(zn_serialize::serialized_size(child.name, child.a) == sizeof(uint32_t) + child.name.size() + sizeof(int));
+    Child new_child;
+    new_child.deserialize(buf);
+    ZnSerializeBuffer new_buf;
+    new_child.serialize(new_buf);
+    assert(buf == new_buf);
+}
+
+// 数值类型的连续序列整块拷贝
+ZN_STRUCT(Numeric)
+{
+    std::vector<int> vector;
+    std::deque<double> deque;
+    std::list<short> list;
+    std::vector<bool> flags;
+    int array[3][4];
+    std::array<float, 5> std_array;
+    std::vector<std::array<int, 2>> pairs;
+    ZN_SERIALIZE(vector, deque, list, flags, array, std_array, pairs);
+};
+
+void test8()
+{
+    Numeric numeric;
+    for (int i = 0; i < 100000; ++i)
+        numeric.vector.push_back(i);
+    for (int i = 0; i < 1000; ++i)
+        numeric.deque.push_back(i * 0.5);
+    numeric.list.assign(10, 7);
+    numeric.flags.assign(9, true);
+    for (int i = 0; i < 12; ++i)
+        numeric.array[i / 4][i % 4] = i;
+    numeric.std_array.fill(1.5f);
+    numeric.pairs.assign(3, std::array<int, 2>{{1, 2}});
+    ZnSerializeBuffer buf;
+    numeric.serialize(buf);
+    assert(buf.size() == numeric.serialized_size());
+    Numeric new_numeric;
+    new_numeric.deserialize(buf);
+    assert(new_numeric.vector == numeric.vector);
+    assert(new_numeric.deque == numeric.deque);
+    assert(new_numeric.list == numeric.list);
+    assert(new_numeric.flags == numeric.flags);
+    assert(memcmp(new_numeric.array, numeric.array, sizeof(numeric.array)) == 0);
+    assert(new_numeric.std_array == numeric.std_array);
+    assert(new_numeric.pairs == numeric.pairs);
+    // 截断的数据不能越界读取
+    Numeric broken;
+    assert(throws([&] { broken.deserialize(buf.data(), buf.data() + 1000); }));
+}
+
+// 序列化到不同的输出端
+void test9(Child& child)
+{
+    ZnSerializeBuffer buf;
+    child.serialize(buf);
+    // 固定容量的内存
+    uint8_t stack[4096];
+    zn_serialize::SpanSink span(stack, sizeof(stack));
+    child.serialize(span);
+    assert(span.size() == buf.size() && memcmp(stack, buf.data(), buf.size()) == 0);
+    zn_serialize::SpanSink small(stack, 16);
+    assert(throws([&] { child.serialize(small); }));
+    // 分块存储
+    zn_serialize::ChunkSink chunks(64);
+    zn_serialize::serialize(chunks, child.name, child);
+    assert(chunks.chunks().size() > 1);
+    ZnSerializeBuffer joined;
+    chunks.copy_to(joined);
+    ZnSerializeBuffer direct;
+    zn_serialize::serialize(direct, child.name, child);
+    assert(joined == direct);
+    // 追加写入时接在已有数据之后, 长度正好
+    zn_serialize::serialize(direct, child.name, child);
+    assert(direct.size() == joined.size() * 2 && memcmp(direct.data() + joined.size(), joined.data(), joined.size()) == 0);
+    std::string name;
+    Child new_child;
+    zn_serialize::deserialize(joined, name, new_child);
+    assert(name == child.name && new_child.name == child.name);
+}
+
+// 视图与std::string/std::vector的格式相同, 反序列化时直接指向字节流
+ZN_STRUCT(Message)
+{
+    int id;
+    std::string text;
+    std::vector<double> values;
+    ZN_SERIALIZE(id, text, values);
+};
+
+ZN_STRUCT(MessageView)
+{
+    int id;
+    zn_serialize::StringView text;
+    zn_serialize::ArrayView<double> values;
+    ZN_SERIALIZE(id, text, values);
+};
+
+void test10()
+{
+    Message message;
+    message.znset(7, "zero copy", std::vector<double>{1.5, 2.5, 3.5});
+    ZnSerializeBuffer buf;
+    message.serialize(buf);
+    MessageView view;
+    view.deserialize(buf);
+    assert(view.id == 7 && view.text.str() == message.text);
+    assert(view.text.data() >= reinterpret_cast<const char*>(buf.data()) && view.text.end() <= reinterpret_cast<const char*>(buf.data() + buf.size()));
+    assert(view.values.size() == 3 && view.values[2] == 3.5);
+    std::vector<double> values;
+    view.values.copy_to(values);
+    assert(values == message.values);
+    // 视图也可以序列化, 结果与原始类型一致
+    ZnSerializeBuffer view_buf;
+    view.serialize(view_buf);
+    assert(view_buf == buf);
+}
+
+// 数据分块到达时流式解码
+template<typename t>
+void stream_decode(const ZnSerializeBuffer& buf, t& target, size_t chunk)
+{
+    zn_serialize::StreamDecoder<t> decoder(target);
+    size_t offset = 0;
+    zn_serialize::StreamStatus status = zn_serialize::StreamStatus::NeedMore;
+    while (status == zn_serialize::StreamStatus::NeedMore)
+    {
+        size_t size = std::min(chunk, buf.size() - offset);
+        status = decoder.feed(buf.data() + offset, size);
+        offset += decoder.consumed();
+        chunk = chunk % 13 + 1;
+    }
+    assert(status == zn_serialize::StreamStatus::Done && offset == buf.size());
+}
+
+void test11(Child& child)
+{
+    ZnSerializeBuffer buf;
+    child.serialize(buf);
+    for (size_t chunk = 1; chunk < 20; ++chunk)
+    {
+        Child new_child;
+        stream_decode(buf, new_child, chunk);
+        ZnSerializeBuffer new_buf;
+        new_child.serialize(new_buf);
+        assert(new_buf == buf);
+    }
+    Numeric numeric;
+    numeric.vector.assign(1000, 3);
+    numeric.deque.assign(10, 0.5);
+    numeric.flags.assign(3, true);
+    numeric.std_array.fill(2.5f);
+    numeric.pairs.assign(2, std::array<int, 2>{{3, 4}});
+    buf.clear();
+    numeric.serialize(buf);
+    Numeric new_numeric;
+    stream_decode(buf, new_numeric, 7);
+    assert(new_numeric.vector == numeric.vector && new_numeric.pairs == numeric.pairs);
+    // 一块数据中包含多条消息
+    ZnSerializeBuffer two;
+    child.serialize(two);
+    child.serialize(two);
+    Child first, second;
+    zn_serialize::StreamDecoder<Child> decoder(first);
+    zn_serialize::StreamStatus first_status = decoder.feed(two);
+    assert(first_status == zn_serialize::StreamStatus::Done && decoder.consumed() == two.size() / 2);
+    (void)first_status;
+    zn_serialize::StreamDecoder<Child> next(second);
+    zn_serialize::StreamStatus second_status = next.feed(two.data() + decoder.consumed(), two.size() - decoder.consumed());
+    assert(second_status == zn_serialize::StreamStatus::Done);
+    (void)second_status;
+    // 长度超出限制视为错误, 不抛出异常
+    zn_serialize::StreamOptions options;
+    options.max_length = 4;
+    Child limited;
+    zn_serialize::StreamDecoder<Child> strict(limited, options);
+    zn_serialize::StreamStatus strict_status = strict.feed(buf);
+    assert(strict_status == zn_serialize::StreamStatus::Error && !strict.error().empty());
+    (void)strict_status;
+    // 默认不限制长度, 字符串随着数据的到达扩大, 声明的长度不会预先分配
+    ZnSerializeBuffer header(sizeof(int) + sizeof(double) + sizeof(float), 0);
+    uint32_t huge = 0xFFFFFFF0;
+    header.insert(header.end(), reinterpret_cast<uint8_t*>(&huge), reinterpret_cast<uint8_t*>(&huge) + sizeof(huge));
+    header.insert(header.end(), 3, 'x');
+    Normal partial;
+    zn_serialize::StreamDecoder<Normal> growing(partial);
+    zn_serialize::StreamStatus status = growing.feed(header);
+    assert(status == zn_serialize::StreamStatus::NeedMore && partial.d == "xxx" && partial.d.capacity() < 1024);
+    (void)status;
+}
+
+#ifndef ZN_SERIALIZE_VIRTUAL
+// 默认没有虚函数, 嵌套与继承的序列化在编译期确定
+static_assert(!std::is_polymorphic<Normal>::value && !std::is_polymorphic<Child>::value, "ZN_STRUCT should not have vtable");
+#endif
+
+// 需要多态时以zn_serialize::Struct为基类
+ZN_STRUCT(Shape, zn_serialize::Struct)
+{
+    int id;
+    ZN_SERIALIZE(id);
+};
+
+ZN_STRUCT(Circle, Shape)
+{
+    double radius;
+    ZN_SERIALIZE(radius);
+};
+
+void test12()
+{
+    Circle circle;
+    circle.id = 1;
+    circle.radius = 2.5;
+    const zn_serialize::Struct& shape = circle;
+    ZnSerializeBuffer buf;
+    shape.serialize(buf);
+    assert(buf.size() == sizeof(int) + sizeof(double) && shape.serialized_size() == buf.size());
+    ZnSerializeBuffer free_buf;
+    zn_serialize::serialize(free_buf, shape);
+    assert(free_buf == buf);
+    Circle new_circle;
+    zn_serialize::Struct& new_shape = new_circle;
+    new_shape.deserialize(buf);
+    assert(new_circle.id == 1 && new_circle.radius == 2.5);
+}
+
+// 紧凑格式: 整数与长度前缀变长编码, 在结构体中声明ZnFormat即默认使用
+enum Level : int32_t { Low = 1, High = 300 };
+
+ZN_STRUCT(Counter)
+{
+    typedef zn_serialize::CompactFormat ZnFormat;
+    uint32_t id;
+    int64_t delta;
+    Level level;
+    std::vector<int> values;
+    std::vector<double> weights;
+    std::string name;
+    std::map<uint16_t, std::string> tags;
+    ZN_SERIALIZE(id, delta, level, values, weights, name, tags);
+};
+
+ZN_STRUCT(Limits)
+{
+    int8_t a;
+    int16_t b;
+    int32_t c;
+    int64_t d;
+    uint64_t e;
+    wchar_t f;
+    bool g;
+    int h[2];
+    ZN_SERIALIZE(a, b, c, d, e, f, g, h);
+};
+
+void test13(const Child& child)
+{
+    Counter counter;
+    counter.znset(5u, int64_t(-3), Low, std::vector<int>{1, -1, 300}, std::vector<double>{0.5}, std::string("ab"), std::map<uint16_t, std::string>{{7, "x"}});
+    ZnSerializeBuffer buf;
+    counter.serialize(buf);
+    // id, delta, level各1字节, values为1+1+1+2, weights为1+8, name为1+2, tags为1+1+1+1
+    assert(buf.size() == 3 + 5 + 9 + 3 + 4 && buf.size() < counter.serialized_size());
+    Counter new_counter;
+    new_counter.deserialize(buf);
+    assert(new_counter.id == 5 && new_counter.delta == -3 && new_counter.level == Low && new_counter.values == counter.values);
+    assert(new_counter.weights == counter.weights && new_counter.name == "ab" && new_counter.tags == counter.tags);
+
+    Limits limits;
+    limits.znset(int8_t(-128), int16_t(-32768), INT32_MIN, INT64_MIN, UINT64_MAX, wchar_t(0x10FFFF), true);
+    limits.h[0] = INT32_MAX;
+    limits.h[1] = -64;
+    // 按调用选择格式: 输出端与输入端指定CompactFormat
+    ZnSerializeBuffer compact;
+    zn_serialize::FormatSink<zn_serialize::CompactFormat, ZnSerializeBuffer> out(compact);
+    limits.serialize(out);
+    zn_serialize::CountSink<zn_serialize::CompactFormat> count;
+    limits.serialize_to(count);
+    assert(count.size() == compact.size() && compact.size() == 1 + 3 + 5 + 10 + 10 + 4 + 1 + 5 + 1);
+    Limits new_limits;
+    zn_serialize::Reader<zn_serialize::CompactFormat> in(compact);
+    new_limits.deserialize_from(in);
+    assert(in.cursor == in.end && memcmp(&new_limits.a, &limits.a, 1) == 0 && new_limits.b == limits.b && new_limits.c == limits.c);
+    assert(new_limits.d == limits.d && new_limits.e == limits.e && new_limits.f == limits.f && new_limits.g && new_limits.h[0] == INT32_MAX && new_limits.h[1] == -64);
+
+    // 同一个结构体两种格式往返的结果一致
+    compact.clear();
+    child.serialize(out);
+    Child new_child;
+    zn_serialize::Reader<zn_serialize::CompactFormat> child_in(compact);
+    new_child.deserialize_from(child_in);
+    ZnSerializeBuffer expected, actual;
+    child.serialize(expected);
+    new_child.serialize(actual);
+    assert(child_in.cursor == child_in.end && expected == actual && compact.size() < expected.size());
+
+    // 截断与超出范围的变长整数
+    assert(throws([&] { new_counter.deserialize(buf.data(), buf.data() + 10); }));
+    const uint8_t big[] = { 0xFF, 0xFF, 0x04 };
+    int16_t small = 0;
+    zn_serialize::Reader<zn_serialize::CompactFormat> big_in(big, big + sizeof(big));
+    assert(throws([&] { zn_serialize::deserialize(big_in, small); }));
+    (void)small;
+}
+
+// 批量序列化: 计算各帧偏移后在线程池上并行编解码
+void test14(const Child& child)
+{
+    std::vector<Child> children(100, child);
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+        children[i].name = std::string(i, 'n');
+        children[i].a = static_cast<int>(i);
+    }
+    zn_serialize::WorkerPool pool(4);
+    ZnSerializeBuffer framed;
+    zn_serialize::serialize_batch(pool, children.begin(), children.end(), framed);
+    ZnSerializeBuffer expected;
+    for (const auto& i : children)
+    {
+        uint32_t size = static_cast<uint32_t>(i.serialized_size());
+        zn_serialize::write_bytes(expected, &size, sizeof(size));
+        i.serialize(expected);
+    }
+    assert(framed == expected);
+    std::vector<ZnSerializeBuffer> buffers;
+    zn_serialize::serialize_batch(pool, children.begin(), children.end(), buffers);
+    assert(buffers.size() == children.size());
+    ZnSerializeBuffer single;
+    children[42].serialize(single);
+    assert(buffers[42] == single);
+
+    std::vector<Child> decoded;
+    zn_serialize::deserialize_batch(pool, framed, decoded);
+    assert(decoded.size() == children.size() && decoded[42].name == children[42].name && decoded[99].a == 99);
+    ZnSerializeBuffer again;
+    zn_serialize::serialize_batch(pool, decoded.begin(), decoded.end(), again);
+    assert(again == framed);
+
+    // 声明了紧凑格式的结构体按自身格式编码每一帧
+    std::vector<Counter> counters(10);
+    for (size_t i = 0; i < counters.size(); ++i)
+        counters[i].znset(static_cast<uint32_t>(i), int64_t(-1), High, std::vector<int>(i, -5));
+    ZnSerializeBuffer compact;
+    zn_serialize::serialize_batch(pool, counters.begin(), counters.end(), compact);
+    std::vector<Counter> new_counters;
+    zn_serialize::deserialize_batch(pool, compact, new_counters);
+    assert(new_counters.size() == 10 && new_counters[7].values == counters[7].values && new_counters[9].level == High);
+
+    // 错误在调用线程重新抛出
+    framed.resize(framed.size() - 1);
+    assert(throws([&] { zn_serialize::deserialize_batch(pool, framed, decoded); }));
+    expected.clear();
+    for (const auto& i : children)
+    {
+        uint32_t size = static_cast<uint32_t>(i.serialized_size() + 1);
+        zn_serialize::write_bytes(expected, &size, sizeof(size));
+        i.serialize(expected);
+        expected.push_back(0);
+    }
+    decoded.clear();
+    assert(throws([&] { zn_serialize::deserialize_batch(pool, expected, decoded); }));
+}
+
+// 内存池反序列化: 字符串与容器节点都从Arena分配, 格式与标准容器相同
+ZN_STRUCT(Record)
+{
+    std::string name;
+    std::vector<int> values;
+    std::list<std::string> lines;
+    std::map<std::string, Used> index;
+    ZN_SERIALIZE(name, values, lines, index);
+};
+
+ZN_STRUCT(ArenaRecord)
+{
+    zn_serialize::arena::string name;
+    zn_serialize::arena::vector<int> values;
+    zn_serialize::arena::list<zn_serialize::arena::string> lines;
+    zn_serialize::arena::map<zn_serialize::arena::string, Used> index;
+    ZN_SERIALIZE(name, values, lines, index);
+};
+
+void test15()
+{
+    Record record;
+    record.name = "a name longer than the small string buffer";
+    record.values.assign(100, 7);
+    record.lines.assign(10, "a line longer than the small string buffer");
+    Used used;
+    used.n1.a = 3;
+    record.index["a key longer than the small string buffer"] = used;
+    record.index["another key longer than the small string buffer"] = used;
+    ZnSerializeBuffer buf;
+    record.serialize(buf);
+
+    zn_serialize::Arena arena(1024);
+    {
+        zn_serialize::ArenaScope scope(arena);
+        ArenaRecord arena_record;
+        arena_record.deserialize(buf);
+        assert(arena_record.name.get_allocator().arena() == &arena && arena.used() > 0 && arena.blocks() > 1);
+        assert(arena_record.name == record.name.c_str() && arena_record.values.size() == 100 && arena_record.lines.size() == 10);
+        assert(arena_record.index.size() == 2 && arena_record.index.begin()->second.n1.a == 3);
+        ZnSerializeBuffer new_buf;
+        arena_record.serialize(new_buf);
+        assert(new_buf == buf);
+    }
+    // 整体释放, 保留第一块复用
+    arena.clear();
+    assert(arena.used() == 0 && arena.blocks() == 1);
+    // 没有内存池时与标准分配器一样
+    ArenaRecord heap_record;
+    heap_record.deserialize(buf);
+    assert(heap_record.name.get_allocator().arena() == nullptr && arena.used() == 0 && heap_record.lines.back() == record.lines.back().c_str());
+}
+
+// 复用模式: 反复解码到同一个对象时保留已分配的空间
+ZN_STRUCT(Reused)
+{
+    std::vector<int> ids;
+    std::vector<std::string> names;
+    std::list<Normal> items;
+    std::set<std::string> tags;
+    std::map<int, std::string> index;
+    ZN_SERIALIZE(ids, names, items, tags, index);
+};
+
+void test16(Normal& normal)
+{
+    Reused first;
+    first.ids.assign(64, 1);
+    first.names.assign(8, "a name longer than the small string buffer");
+    first.items.assign(3, normal);
+    first.tags.insert("tag");
+    first.index[1] = "one";
+    Reused second;
+    second.ids.assign(16, 2);
+    second.names.assign(4, "short");
+    second.items.assign(1, normal);
+    second.items.front().d = "changed";
+    second.index[2] = "two";
+    ZnSerializeBuffer first_buf, second_buf;
+    first.serialize(first_buf);
+    second.serialize(second_buf);
+
+    Reused target;
+    zn_serialize::deserialize_reuse(first_buf, target);
+    const int* ids = target.ids.data();
+    const char* name = target.names[0].data();
+    zn_serialize::deserialize_reuse(second_buf, target);
+    ZnSerializeBuffer buf;
+    target.serialize(buf);
+    assert(buf == second_buf && target.ids.capacity() >= 64 && target.ids.data() == ids && target.names[0].data() == name);
+    (void)name;
+    for (int i = 0; i < 3; ++i)
+    {
+        zn_serialize::deserialize_reuse(first_buf, target);
+        zn_serialize::deserialize_reuse(second_buf, target);
+    }
+    buf.clear();
+    target.serialize(buf);
+    assert(buf == second_buf && target.ids.data() == ids && target.tags.empty() && target.index.size() == 1);
+    (void)ids;
+
+    // 默认模式仍然追加
+    Reused appended;
+    appended.deserialize(first_buf);
+    appended.deserialize(second_buf);
+    assert(appended.ids.size() == 80 && appended.items.size() == 4 && appended.index.size() == 2);
+
+    // 错误的长度前缀不会导致按长度分配
+    ZnSerializeBuffer broken(first_buf.begin(), first_buf.begin() + sizeof(uint32_t) + 64 * sizeof(int));
+    uint32_t huge = 0xFFFFFFF0;
+    zn_serialize::write_bytes(broken, &huge, sizeof(huge));
+    assert(throws([&] { zn_serialize::deserialize_reuse(broken, target); }));
+}
+
+// 测试性能统计, ZnSerializeProfileTest全局定义了ZN_SERIALIZE_PROFILE
+void test17(const Child& child)
+{
+    zn_serialize::profile_reset();
+    ZnSerializeBuffer buf;
+    child.serialize(buf);
+    Child new_child;
+    new_child.deserialize(buf);
+    // 线程退出后它的计数仍然保留
+    std::thread([&] { Child other; other.deserialize(buf); }).join();
+    auto records = zn_serialize::profile_snapshot();
+#ifdef ZN_SERIALIZE_PROFILE
+    bool found_child = false, found_vector = false;
+    for (const auto& record : records)
+    {
+        if (!record.container && (record.name == "Child" || record.name == "struct Child"))
+        {
+            found_child = true;
+            assert(record.serialize.count == 1 && record.serialize.bytes == buf.size());
+            assert(record.deserialize.count == 2 && record.deserialize.bytes == 2 * buf.size());
+        }
+        if (record.container && record.name.find("vector<std::shared_ptr<Used>") != std::string::npos)
+        {
+            found_vector = true;
+            assert(record.serialize.elements == child.vector.size());
+            assert(record.deserialize.elements == 2 * child.vector.size());
+        }
+    }
+    assert(found_child && found_vector);
+    (void)found_child;
+    (void)found_vector;
+    zn_serialize::profile_reset();
+    records = zn_serialize::profile_snapshot();
+    for (size_t i = 0; i < records.size(); ++i)
+        assert(records[i].serialize.count == 0 && records[i].deserialize.count == 0);
+#else
+    assert(records.empty());
+#endif
+}
+
+// 测试记录文件: 按序号读取, 追加写入, 以及没有正常关闭时的恢复
+void test18(Normal normal)
+{
+    {
+        zn_serialize::RecordWriter writer("records");
+        for (int i = 0; i < 100; ++i)
+        {
+            normal.a = i;
+            size_t index = writer.append(normal);
+            assert(index == static_cast<size_t>(i));
+            (void)index;
+        }
+    }
+    {
+        zn_serialize::RecordWriter writer("records", true);
+        assert(writer.size() == 100);
+        normal.a = 100;
+        writer.append(normal);
+    }
+    Normal record;
+    {
+        zn_serialize::RecordReader reader("records");
+        assert(reader.size() == 101);
+        reader.read(42, record);
+        assert(record.a == 42 && record.d == normal.d && record.e == normal.e);
+        reader.read(100, record);
+        assert(record.a == 100);
+        assert(throws([&] { reader.record(101); }));
+    }
+    // 去掉索引与文件尾, 并截断最后一条记录, 相当于写入时进程崩溃
+    std::ifstream ifs("records", std::fstream::binary);
+    ZnSerializeBuffer file((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    ifs.close();
+    file.resize(file.size() - zn_serialize::RecordFileFooterSize - 101 * sizeof(uint64_t) - 3);
+    {
+        std::ofstream ofs("records", std::fstream::binary | std::fstream::trunc);
+        ofs.write(reinterpret_cast<const char*>(file.data()), file.size());
+    }
+    {
+        zn_serialize::RecordReader reader("records");
+        assert(reader.size() == 100);
+        reader.read(99, record);
+        assert(record.a == 99);
+    }
+    {
+        zn_serialize::RecordWriter writer("records", true);
+        assert(writer.size() == 100);
+        normal.a = 200;
+        writer.append(normal);
+    }
+    {
+        zn_serialize::RecordReader reader("records");
+        assert(reader.size() == 101);
+        reader.read(100, record);
+        assert(record.a == 200);
+    }
+    std::remove("records");
+    // 伪造的文件尾: 记录数乘以8后溢出, 恰好等于索引区长度, 应当当作没有索引逐条扫描
+    uint32_t header[2] = { zn_serialize::RecordFileMagic, zn_serialize::RecordFileVersion };
+    uint64_t footer[2] = { zn_serialize::RecordFileHeaderSize, uint64_t(1) << 61 };
+    uint32_t magic[2] = { zn_serialize::RecordIndexMagic, zn_serialize::RecordFileVersion };
+    ZnSerializeBuffer forged(sizeof(header) + sizeof(footer) + sizeof(magic));
+    memcpy(forged.data(), header, sizeof(header));
+    memcpy(forged.data() + sizeof(header), footer, sizeof(footer));
+    memcpy(forged.data() + sizeof(header) + sizeof(footer), magic, sizeof(magic));
+    std::vector<uint64_t> offsets;
+    zn_serialize::load_record_index(forged.data(), forged.size(), offsets);
+    assert(offsets.size() <= 1);
+}
+
+// 测试块压缩: 可压缩的数据变小并能还原, 短数据与不可压缩的数据原样存放, 损坏的数据抛出异常
+void test19(const Child& child)
+{
+    ZnSerializeBuffer raw;
+    child.serialize(raw);
+    ZnSerializeBuffer compressed, restored;
+    zn_serialize::compress(raw, compressed);
+    assert(compressed.size() < raw.size());
+    zn_serialize::decompress(compressed, restored);
+    assert(restored == raw);
+
+    Child new_child;
+    compressed.clear();
+    zn_serialize::serialize_compressed(child, compressed);
+    zn_serialize::deserialize_compressed(compressed, new_child);
+    ZnSerializeBuffer buf;
+    new_child.serialize(buf);
+    assert(buf == raw);
+
+    // 视图成员指向调用者传入的buffer, 解压的数据在buffer被修改前有效
+    Message message;
+    message.id = 5;
+    message.text = std::string(500, 'z');
+    message.values.assign(64, 1.5);
+    ZnSerializeBuffer scratch;
+    compressed.clear();
+    zn_serialize::serialize_compressed(message, compressed, scratch);
+    assert(compressed[0] == zn_serialize::CompressLz);
+    MessageView view;
+    zn_serialize::deserialize_compressed(compressed, view, scratch);
+    const uint8_t* text = reinterpret_cast<const uint8_t*>(view.text.data());
+    assert(text >= scratch.data() && text + view.text.size() <= scratch.data() + scratch.size());
+    (void)text;
+    assert(view.id == 5 && view.text == zn_serialize::StringView(message.text) && view.values.size() == 64 && view.values[63] == 1.5);
+
+    // 大量的0, 不同的长度与重复的周期
+    for (size_t size = 0; size < 300; size += 7)
+    {
+        ZnSerializeBuffer data(size * 37, 0);
+        for (size_t i = 0; i < data.size(); i += size % 13 + 1)
+            data[i] = static_cast<uint8_t>(i / 5);
+        compressed.clear();
+        restored.clear();
+        zn_serialize::compress(data, compressed, 0);
+        zn_serialize::decompress(compressed, restored);
+        assert(restored == data);
+    }
+
+    ZnSerializeBuffer small(100, 0);
+    compressed.clear();
+    zn_serialize::compress(small, compressed);
+    assert(compressed.size() == zn_serialize::CompressHeaderSize + small.size() && compressed[0] == zn_serialize::CompressStored);
+    ZnSerializeBuffer noise(4096);
+    uint32_t seed = 1;
+    for (auto& byte : noise)
+    {
+        seed = seed * 1103515245 + 12345;
+        byte = static_cast<uint8_t>(seed >> 16);
+    }
+    compressed.clear();
+    zn_serialize::compress(noise, compressed);
+    assert(compressed[0] == zn_serialize::CompressStored);
+
+    compressed.clear();
+    zn_serialize::compress(raw, compressed);
+    compressed.resize(compressed.size() - 1);
+    assert(throws([&] { zn_serialize::decompress(compressed, restored); }));
+
+    // 头部声明的原始长度超过数据可能展开的长度时, 不分配内存直接抛出异常
+    const uint8_t corrupt[] = { zn_serialize::CompressLz, 0xFF, 0xFF, 0xFF, 0xFF, 0x00 };
+    Child decoded;
+    assert(throws([&] { zn_serialize::deserialize_compressed(corrupt, corrupt + sizeof(corrupt), decoded); }));
+    (void)corrupt;
+}
+
+// 测试增量编码: 只写入变化的成员, 应用到快照上得到新的对象
+void test20(const Child& child)
+{
+    Child baseline = child;
+    ZnSerializeBuffer delta;
+    bool changed = zn_serialize::serialize_delta(baseline, child, delta);
+    assert(!changed);
+    Child current = child;
+    current.name = "renamed";
+    current.a += 1;
+    current.map.begin()->second.n2.d = "changed";
+    current.deque.push_back(current.deque.front());
+    delta.clear();
+    changed = zn_serialize::serialize_delta(baseline, current, delta);
+    assert(changed);
+    (void)changed;
+    ZnSerializeBuffer full;
+    current.serialize(full);
+    assert(delta.size() < full.size());
+    zn_serialize::apply_delta(delta, baseline);
+    ZnSerializeBuffer applied;
+    baseline.serialize(applied);
+    assert(applied == full);
+}
+
+// 没有默认构造函数的结构体也可以跳过
+ZN_STRUCT(Labeled, Normal)
+{
+    std::string label;
+    explicit Labeled(const std::string& label) : label(label) {}
+    ZN_SERIALIZE(label);
+};
+
+// 测试投影解码: 只解码指定的成员, 其余跳过
+void test21(const Child& child)
+{
+    ZnSerializeBuffer buf;
+    child.serialize(buf);
+    Child projected;
+    const uint8_t* projected_end = zn_serialize::deserialize_fields(buf.data(), buf.data() + buf.size(), projected, &Child::name, &Normal::a, &Container::map);
+    assert(projected_end == buf.data() + buf.size());
+    (void)projected_end;
+    assert(projected.name == child.name && projected.a == child.a && projected.map.size() == child.map.size());
+    assert(projected.vector.empty() && projected.deque.empty() && projected.d.empty());
+    const uint8_t* skipped_end = zn_serialize::skip_message<Child>(buf.data(), buf.data() + buf.size());
+    assert(skipped_end == buf.data() + buf.size());
+    (void)skipped_end;
+    Labeled labeled("label");
+    labeled.d = "base";
+    buf.clear();
+    labeled.serialize(buf);
+    assert(zn_serialize::skip_message<Labeled>(buf.data(), buf.data() + buf.size()) == buf.data() + buf.size());
+
+    Numeric numeric;
+    numeric.vector.assign(100000, 3);
+    numeric.deque.assign(10, 0.5);
+    numeric.list.assign(10, 7);
+    numeric.flags.assign(9, true);
+    for (int i = 0; i < 12; ++i)
+        numeric.array[i / 4][i % 4] = i;
+    numeric.std_array.fill(1.5f);
+    numeric.pairs.assign(3, std::array<int, 2>{{1, 2}});
+    buf.clear();
+    numeric.serialize(buf);
+    Numeric new_numeric;
+    zn_serialize::deserialize_fields(buf, new_numeric, &Numeric::pairs);
+    assert(new_numeric.pairs == numeric.pairs && new_numeric.vector.empty() && new_numeric.flags.empty());
+
+    // 紧凑格式的变长整数逐个跳过
+    Counter counter;
+    counter.znset(5u, int64_t(-3), Low, std::vector<int>{1, -1, 300}, std::vector<double>{0.5}, std::string("ab"), std::map<uint16_t, std::string>{{7, "x"}});
+    buf.clear();
+    counter.serialize(buf);
+    Counter new_counter;
+    new_counter.id = 0;
+    zn_serialize::deserialize_fields(buf, new_counter, &Counter::tags, &Counter::id);
+    assert(new_counter.id == 5 && new_counter.tags == counter.tags && new_counter.values.empty() && new_counter.name.empty());
+
+    buf.resize(buf.size() - 1);
+    assert(throws([&] { zn_serialize::deserialize_fields(buf, new_counter, &Counter::id); }));
+}
+
+// 测试带索引的编码: 按需读取成员与元素, 不解码整条消息
+void test22(const Child& child)
+{
+    ZnSerializeBuffer buf;
+    zn_serialize::serialize_indexed(child, buf);
+    Child new_child;
+    const uint8_t* indexed_end = zn_serialize::deserialize_indexed(buf, new_child);
+    assert(indexed_end == buf.data() + buf.size());
+    (void)indexed_end;
+    ZnSerializeBuffer x, y;
+    child.serialize(x);
+    new_child.serialize(y);
+    assert(x == y);
+
+    auto view = zn_serialize::indexed_view<Child>(buf);
+    assert(view.get(&Child::name).decode() == child.name);
+    assert(view.get(&Normal::a).decode() == child.a);
+    assert(view.get(&Normal::e).decode() == child.e);
+    auto map = view.get(&Container::map);
+    assert(map.size() == child.map.size());
+    size_t i = map.find("used");
+    assert(i < map.size() && map.key(i).decode() == "used");
+    assert(map.mapped(i).get(&Used::n2).get(&Normal::d).decode() == child.map.find("used")->second.n2.d);
+    (void)i;
+    assert(map.find("missing") == map.size());
+    auto vector = view.get(&Container::vector);
+    assert(vector.size() == child.vector.size() && vector[1].decode()->n1.a == child.vector[1]->n1.a);
+    (void)vector;
+
+    Numeric numeric;
+    numeric.vector.assign(1000, 3);
+    numeric.vector[999] = 7;
+    numeric.flags.assign(5, true);
+    numeric.pairs.assign(3, std::array<int, 2>{{1, 2}});
+    buf.clear();
+    zn_serialize::serialize_indexed(numeric, buf);
+    auto numbers = zn_serialize::indexed_view<Numeric>(buf).get(&Numeric::vector);
+    assert(numbers.size() == 1000 && numbers[999].decode() == 7);
+    (void)numbers;
+    assert(zn_serialize::indexed_view<Numeric>(buf).member<std::vector<bool>>(3)[4].decode());
+
+    buf.resize(buf.size() - 1);
+    assert(throws([&] { zn_serialize::indexed_view<Numeric>(buf); }));
+}
+
+// 测试可移植格式: 固定小端序, 宽字符串固定为UTF-16
+void test23(const Child& child)
+{
+    ZnSerializeBuffer buf;
+    zn_serialize::FormatSink<zn_serialize::PortableFormat, ZnSerializeBuffer> out(buf);
+    zn_serialize::serialize(out, uint32_t(0x01020304), std::wstring(L"a\U0001F600"));
+    const uint8_t expected[] = { 4, 3, 2, 1, 6, 0, 0, 0, 'a', 0, 0x3D, 0xD8, 0x00, 0xDE };
+    assert(buf == ZnSerializeBuffer(expected, expected + sizeof(expected)));
+    (void)expected;
+    uint32_t value = 0;
+    std::wstring text;
+    zn_serialize::Reader<zn_serialize::PortableFormat> in(buf);
+    zn_serialize::deserialize_values(in, value, text);
+    assert(value == 0x01020304 && text == L"a\U0001F600" && in.remain() == 0);
+
+    buf.clear();
+    child.serialize_to(out);
+    Child new_child;
+    zn_serialize::Reader<zn_serialize::PortableFormat> child_in(buf);
+    new_child.deserialize_from(child_in);
+    ZnSerializeBuffer x, y;
+    child.serialize(x);
+    new_child.serialize(y);
+    assert(x == y && child_in.remain() == 0);
+
+    Numeric numeric;
+    numeric.vector.assign(3000, -5);
+    numeric.deque.assign(700, 0.25);
+    for (int i = 0; i < 12; ++i)
+        numeric.array[i / 4][i % 4] = i * 1000;
+    numeric.std_array.fill(2.5f);
+    numeric.pairs.assign(5, std::array<int, 2>{{1, -2}});
+    buf.clear();
+    numeric.serialize_to(out);
+    Numeric new_numeric;
+    zn_serialize::Reader<zn_serialize::PortableFormat> numeric_in(buf);
+    new_numeric.deserialize_from(numeric_in);
+    assert(new_numeric.vector == numeric.vector && new_numeric.deque == numeric.deque && new_numeric.pairs == numeric.pairs);
+    assert(new_numeric.array[2][3] == 11000 && new_numeric.std_array == numeric.std_array);
+
+    // 大端机器上使用的交换字节序的函数
+    std::vector<std::array<uint16_t, 2>> halves(300, std::array<uint16_t, 2>{{0x0102, 0x0304}});
+    zn_serialize::swap_items(halves.data(), halves.size());
+    assert(halves[299][0] == 0x0201 && halves[299][1] == 0x0403);
+    uint64_t wide[] = { 0x0102030405060708ull, 1 };
+    zn_serialize::swap_items(wide, 2);
+    assert(wide[0] == 0x0807060504030201ull && wide[1] == 0x0100000000000000ull);
+}
+
+// 测试帧校验: 编码时累加CRC32C, 解码前校验
+void test24(const Child& child)
+{
+    const char digits[] = "123456789";
+    assert(zn_serialize::crc32c(0, digits, 9) == 0xE3069283);
+    assert(zn_serialize::crc32c(zn_serialize::crc32c(0, digits, 4), digits + 4, 5) == 0xE3069283);
+    (void)digits;
+    std::vector<uint8_t> noise(4000);
+    for (size_t i = 0; i < noise.size(); ++i)
+        noise[i] = static_cast<uint8_t>(i * 131 + 7);
+    // 硬件实现(短数据与分3段并行的长数据)与软件实现的结果相同
+    for (size_t size = 0; size < noise.size() - 3; size += size < 40 ? 1 : 97)
+        assert(zn_serialize::crc32c(7, noise.data() + 3, size) == ~zn_serialize::crc32c_software(~7u, noise.data() + 3, size));
+
+    ZnSerializeBuffer plain, buf;
+    child.serialize(plain);
+    zn_serialize::serialize_checked(child, buf);
+    assert(buf.size() == plain.size() + 4 && std::equal(plain.begin(), plain.end(), buf.begin()));
+    assert(zn_serialize::checksum_valid(buf.data(), buf.data() + buf.size()));
+    Child new_child;
+    zn_serialize::deserialize_checked(buf, new_child);
+    assert(new_child.name == child.name && new_child.map.size() == child.map.size());
+
+    buf[buf.size() / 2] ^= 0x10;
+    assert(throws([&] { zn_serialize::deserialize_checked(buf, new_child); }));
+
+    Counter counter;
+    counter.znset(9u, int64_t(-1), High, std::vector<int>{1, 2}, std::vector<double>{}, std::string("c"), std::map<uint16_t, std::string>{});
+    buf.clear();
+    zn_serialize::serialize_checked(counter, buf);
+    Counter new_counter;
+    zn_serialize::deserialize_checked(buf, new_counter);
+    assert(new_counter.id == 9 && new_counter.level == High && new_counter.values == counter.values);
+
+    uint8_t frame[256];
+    zn_serialize::SpanSink sink(frame, sizeof(frame));
+    zn_serialize::serialize_checked(counter, sink);
+    assert(ZnSerializeBuffer(frame, frame + sink.size()) == buf);
+}
+
+// 测试环形缓冲区: 回绕, 预留与放弃, 以及多线程同时读写
+void test25(const Child& child)
+{
+    zn_serialize::SpscRing ring(200);
+    assert(ring.capacity() == 256 && ring.max_message_size() == 120);
+    Counter counter, new_counter;
+    counter.znset(0u, int64_t(-7), High, std::vector<int>{1, 300}, std::vector<double>{0.25}, std::string(), std::map<uint16_t, std::string>{{1, "a"}});
+    // 长度不同的消息反复回绕
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+        counter.id = i;
+        counter.name.assign(i % 90, 'n');
+        bool written = ring.try_push(counter);
+        bool taken = ring.try_pop(new_counter);
+        assert(written && taken);
+        (void)written;
+        (void)taken;
+        assert(new_counter.id == i && new_counter.name == counter.name && new_counter.tags == counter.tags);
+    }
+    bool empty = !ring.try_pop(new_counter);
+    assert(empty);
+    (void)empty;
+    // 写满后一次性读出
+    uint32_t pushed = 0;
+    for (counter.id = 0; ring.try_push(counter); ++counter.id)
+        ++pushed;
+    assert(pushed > 1);
+    uint32_t next = 0;
+    size_t drained = ring.consume([&](const uint8_t* begin, const uint8_t* end)
+    {
+        const uint8_t* decoded = new_counter.deserialize(begin, end);
+        assert(decoded == end && new_counter.id == next);
+        (void)decoded;
+        ++next;
+    });
+    assert(drained == pushed && next == pushed);
+    (void)drained;
+
+    zn_serialize::RingSlot slot;
+    bool reserved = ring.try_reserve(5, slot);
+    assert(reserved);
+    memcpy(slot.data, "hello", 5);
+    ring.commit(slot);
+    reserved = ring.try_reserve(3, slot);
+    assert(reserved);
+    ring.cancel(slot);
+    reserved = ring.try_reserve(1, slot);
+    assert(reserved);
+    (void)reserved;
+    slot.data[0] = '!';
+    ring.commit(slot);
+    zn_serialize::RingRecord record;
+    bool read = ring.try_read(record);
+    assert(read && record.size() == 5 && memcmp(record.begin, "hello", 5) == 0);
+    read = ring.try_read(record);
+    assert(read && record.size() == 1 && record.begin[0] == '!');
+    read = ring.try_read(record);
+    assert(!read);
+    ring.release(record);
+    assert(throws([&] { ring.try_reserve(121, slot); }));
+    assert(throws([] { zn_serialize::SpscRing huge(SIZE_MAX); }));
+
+    // 单生产者单消费者
+    const uint32_t count = 10000;
+    zn_serialize::SpscRing spsc(1024);
+    std::thread producer([&]
+    {
+        Counter v = counter;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            v.id = i;
+            v.name.assign(i % 50, 's');
+            spsc.push(v);
+        }
+    });
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        Counter v;
+        spsc.pop(v);
+        assert(v.id == i && v.name.size() == i % 50);
+    }
+    producer.join();
+
+    // 多生产者单消费者, 每个生产者的消息保持各自的顺序
+    const int producers = 4;
+    zn_serialize::MpscRing mpsc(2048);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&, p]
+        {
+            Counter v = counter;
+            v.delta = p;
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                v.id = i;
+                v.name.assign((i + p) % 40, 'm');
+                mpsc.push(v);
+            }
+        });
+    }
+    std::vector<uint32_t> expected(producers, 0);
+    size_t received = 0;
+    while (received < count * producers)
+    {
+        size_t consumed = mpsc.consume([&](const uint8_t* begin, const uint8_t* end)
+        {
+            Counter v;
+            const uint8_t* decoded = v.deserialize(begin, end);
+            assert(decoded == end);
+            (void)decoded;
+            assert(v.id == expected[v.delta] && v.name.size() == static_cast<size_t>((v.id + v.delta) % 40));
+            ++expected[v.delta];
+        });
+        if (!consumed)
+            std::this_thread::yield();
+        received += consumed;
+    }
+    for (auto& thread : threads)
+        thread.join();
+    for (int p = 0; p < producers; ++p)
+        assert(expected[p] == count);
+    read = mpsc.try_read(record);
+    assert(!read);
+    (void)read;
+
+    // 定长格式的大消息
+    zn_serialize::MpscRing large(zn_serialize::message_size(child) * 4);
+    Child new_child;
+    large.push(child);
+    large.pop(new_child);
+    assert(new_child.name == child.name && new_child.map.size() == child.map.size());
+}
+
+// 引用跟踪: 重复引用的对象只编码一次, 解码后仍然共享
+ZN_STRUCT(Scene)
+{
+    typedef zn_serialize::CompactFormat ZnFormat;
+    std::vector<std::shared_ptr<Normal>> nodes;
+    std::shared_ptr<Normal> root;
+    std::map<int, std::shared_ptr<Used>> groups;
+    ZN_SERIALIZE(nodes, root, groups);
+};
+
+void test26(const Child& child)
+{
+    // child.vector中同一个Used出现了两次
+    assert(child.vector.size() == 2 && child.vector[0] == child.vector[1]);
+    ZnSerializeBuffer plain, shared;
+    child.serialize(plain);
+    zn_serialize::serialize_shared(child, shared);
+    assert(shared.size() < plain.size());
+    Child new_child;
+    const uint8_t* shared_end = zn_serialize::deserialize_shared(shared, new_child);
+    assert(shared_end == shared.data() + shared.size());
+    (void)shared_end;
+    assert(new_child.vector.size() == 2 && new_child.vector[0] == new_child.vector[1]);
+    assert(new_child.vector[0]->n1.d == child.vector[0]->n1.d && new_child.name == child.name && new_child.map.size() == child.map.size());
+
+    Scene scene;
+    for (int i = 0; i < 3; ++i)
+    {
+        scene.nodes.push_back(std::make_shared<Normal>());
+        scene.nodes.back()->a = i;
+    }
+    scene.nodes.push_back(scene.nodes[1]);
+    scene.nodes.push_back(nullptr);
+    scene.root = scene.nodes[2];
+    auto used = std::make_shared<Used>();
+    used->n1.d = "group";
+    scene.groups[1] = used;
+    scene.groups[2] = used;
+    shared.clear();
+    zn_serialize::serialize_shared(scene, shared);
+    Scene new_scene;
+    zn_serialize::deserialize_shared(shared, new_scene);
+    assert(new_scene.nodes.size() == 5 && new_scene.nodes[3] == new_scene.nodes[1] && !new_scene.nodes[4]);
+    assert(new_scene.root == new_scene.nodes[2] && new_scene.root->a == 2 && new_scene.nodes[0]->a == 0);
+    assert(new_scene.groups[1] == new_scene.groups[2] && new_scene.groups[1]->n1.d == "group");
+    // 重建的对象只被容器与其他引用持有
+    assert(new_scene.nodes[1].use_count() == 2 && new_scene.root.use_count() == 2);
+
+    // 编号超出已解码的对象
+    const uint8_t invalid[] = { 1, 5 };
+    assert(throws([&] { zn_serialize::deserialize_shared(invalid, invalid + sizeof(invalid), new_scene); }));
+    (void)invalid;
+}
+
+// 列式编码: 同一成员的值连续存放, 重复的字符串用字典编码
+ZN_STRUCT(Table)
+{
+    typedef zn_serialize::CompactFormat ZnFormat;
+    int version;
+    zn_serialize::ColumnVector<Counter> counters;
+    ZN_SERIALIZE(version, counters);
+};
+
+ZN_STRUCT(Blank)
+{
+    ZN_SERIALIZE();
+};
+
+void test27(const Child& child)
+{
+    std::vector<Normal> rows(1000);
+    for (size_t i = 0; i < rows.size(); ++i)
+        rows[i].znset(int(i), i * 0.5, float(i), i % 3 ? "buy" : "sell", L"w", std::make_tuple(int(i), 1.0, 2.0f), "");
+    ZnSerializeBuffer plain, columns;
+    zn_serialize::serialize(plain, rows);
+    zn_serialize::serialize_columns(rows, columns);
+    assert(columns.size() < plain.size());
+    std::vector<Normal> new_rows;
+    const uint8_t* columns_end = zn_serialize::deserialize_columns(columns, new_rows);
+    assert(columns_end == columns.data() + columns.size());
+    (void)columns_end;
+    assert(new_rows.size() == rows.size());
+    for (size_t i = 0; i < rows.size(); ++i)
+        assert(new_rows[i].a == rows[i].a && new_rows[i].b == rows[i].b && new_rows[i].c == rows[i].c && new_rows[i].d == rows[i].d
+            && new_rows[i].e == rows[i].e && new_rows[i].f == rows[i].f);
+
+    // 嵌套的结构体按成员拆分为列, 各不相同的字符串逐行写入
+    std::vector<Used> used(3, *child.vector[0]);
+    used[1].n2.d = "second";
+    used[2].n1.a = -7;
+    columns.clear();
+    zn_serialize::serialize_columns(used, columns);
+    std::vector<Used> new_used;
+    zn_serialize::deserialize_columns(columns, new_used);
+    assert(new_used.size() == 3 && new_used[1].n2.d == "second" && new_used[2].n1.a == -7 && new_used[0].n1.d == used[0].n1.d);
+
+    // 作为成员时跟随外层结构体的格式
+    Table table;
+    table.version = 2;
+    for (uint32_t i = 0; i < 64; ++i)
+    {
+        Counter counter;
+        counter.znset(i, -int64_t(i), i % 2 ? Low : High, std::vector<int>(i % 4, 1), std::vector<double>(), i % 2 ? "odd" : "even", std::map<uint16_t, std::string>());
+        table.counters.push_back(counter);
+    }
+    ZnSerializeBuffer buf;
+    table.serialize(buf);
+    Table new_table;
+    const uint8_t* table_end = new_table.deserialize(buf.data(), buf.data() + buf.size());
+    assert(table_end == buf.data() + buf.size());
+    (void)table_end;
+    assert(new_table.version == 2 && new_table.counters.size() == 64);
+    assert(new_table.counters[63].id == 63 && new_table.counters[63].delta == -63 && new_table.counters[63].level == Low);
+    assert(new_table.counters[63].values.size() == 3 && new_table.counters[62].name == "even");
+
+    // 截断的输入
+    assert(throws([&] { zn_serialize::deserialize_columns(columns.data(), columns.data() + columns.size() / 2, new_used); }));
+
+    // 没有列的行不占字节, 行数受固定上限约束
+    std::vector<Blank> blanks(10), new_blanks;
+    columns.clear();
+    zn_serialize::serialize_columns(blanks, columns);
+    zn_serialize::deserialize_columns(columns, new_blanks);
+    assert(new_blanks.size() == 10);
+    const uint8_t forged[] = { 0xFF, 0xFF, 0xFF, 0xFF };
+    assert(throws([&] { zn_serialize::deserialize_columns(forged, forged + sizeof(forged), new_blanks); }));
+    (void)forged;
+}
+
+// 分块模式: 大容器带有分块表, 在线程池上并行解码
+ZN_STRUCT(Snapshot)
+{
+    typedef zn_serialize::CompactFormat ZnFormat;
+    std::vector<Used> used;
+    std::map<int, Normal> normals;
+    std::set<int> ids;
+    std::list<std::string> names;
+    std::vector<bool> flags;
+    std::vector<std::vector<std::string>> nested;
+    ZN_SERIALIZE(used, normals, ids, names, flags, nested);
+};
+
+void test28(const Child& child)
+{
+    Snapshot snapshot;
+    snapshot.used.assign(5000, *child.vector[0]);
+    for (int i = 0; i < 5000; ++i)
+    {
+        snapshot.used[i].n1.a = i;
+        snapshot.normals[i * 3] = child.vector[0]->n2;
+        snapshot.ids.insert(i * 7);
+        snapshot.names.push_back(std::to_string(i));
+        snapshot.flags.push_back(i % 3 == 0);
+    }
+    snapshot.nested.assign(4100, std::vector<std::string>(1, "x"));
+    snapshot.nested[4099].assign(5000, "y");
+    ZnSerializeBuffer plain, blocks;
+    snapshot.serialize(plain);
+    zn_serialize::serialize_parallel(snapshot, blocks);
+    assert(blocks.size() > plain.size());
+
+    zn_serialize::WorkerPool pool(4);
+    Snapshot parallel, sequential;
+    const uint8_t* parallel_end = zn_serialize::deserialize_parallel(blocks, parallel, &pool);
+    const uint8_t* sequential_end = zn_serialize::deserialize_parallel(blocks, sequential);
+    assert(parallel_end == blocks.data() + blocks.size() && sequential_end == blocks.data() + blocks.size());
+    (void)parallel_end;
+    (void)sequential_end;
+    ZnSerializeBuffer parallel_buf, sequential_buf;
+    parallel.serialize(parallel_buf);
+    sequential.serialize(sequential_buf);
+    assert(parallel_buf == plain && sequential_buf == plain);
+    assert(parallel.used[4999].n1.a == 4999 && parallel.normals.rbegin()->first == 14997 && parallel.names.back() == "4999");
+
+    // 内存池不是线程安全的, 当前线程有内存池时顺序解码, 所有字符串都从这个内存池分配
+    Record record;
+    record.lines.assign(5000, "a line longer than the small string buffer");
+    ZnSerializeBuffer record_blocks;
+    zn_serialize::serialize_parallel(record, record_blocks);
+    zn_serialize::Arena arena;
+    {
+        zn_serialize::ArenaScope scope(arena);
+        ArenaRecord arena_record;
+        const uint8_t* record_end = zn_serialize::deserialize_parallel(record_blocks, arena_record, &pool);
+        assert(record_end == record_blocks.data() + record_blocks.size() && arena_record.lines.size() == 5000);
+        (void)record_end;
+        assert(arena_record.lines.back().get_allocator().arena() == &arena && arena_record.lines.front() == record.lines.front().c_str());
+    }
+
+    // 分块表与元素不一致
+    blocks[2] ^= 1;
+    for (int i = 0; i < 2; ++i)
+    {
+        assert(throws([&] { zn_serialize::deserialize_parallel(blocks, parallel, i ? &pool : nullptr); }));
+    }
+
+    // 声明了0xFFFFFFFF个元素, 分块表中每块的长度都为0: 不预先分配元素, 顺序解码时因字节不足抛出异常
+    ZnSerializeBuffer forged = { 0xFF, 0xFF, 0xFF, 0xFF, 0x0F };
+    forged.resize(forged.size() + (0x100000000ull / zn_serialize::ParallelBlockSize), 0);
+    Snapshot huge;
+    assert(throws([&] { zn_serialize::deserialize_parallel(forged, huge, &pool); }));
+    assert(huge.used.capacity() <= forged.size());
+}
+
+// 无序容器, 以及有序容器按顺序插入到末尾
+ZN_STRUCT(Lookup)
+{
+    std::unordered_map<std::string, Normal> by_name;
+    std::unordered_set<int> ids;
+    std::unordered_multimap<int, std::string> tags;
+    std::unordered_multiset<std::string> words;
+    std::multimap<int, int> ordered;
+    ZN_SERIALIZE(by_name, ids, tags, words, ordered);
+};
+
+void test29(const Child& child)
+{
+    Lookup lookup;
+    for (int i = 0; i < 5000; ++i)
+    {
+        lookup.by_name[std::to_string(i)] = child.vector[0]->n1;
+        lookup.by_name[std::to_string(i)].a = i;
+        lookup.ids.insert(i * 3);
+        lookup.ordered.insert(std::make_pair(i / 10, i));
+    }
+    lookup.tags.insert(std::make_pair(1, "a"));
+    lookup.tags.insert(std::make_pair(1, "b"));
+    lookup.words.insert("w");
+    lookup.words.insert("w");
+    ZnSerializeBuffer buf;
+    lookup.serialize(buf);
+    assert(buf.size() == lookup.serialized_size());
+    Lookup new_lookup;
+    new_lookup.deserialize(buf);
+    assert(new_lookup.by_name.size() == 5000 && new_lookup.by_name["4321"].a == 4321 && new_lookup.by_name["7"].d == child.vector[0]->n1.d);
+    assert(new_lookup.ids == lookup.ids && new_lookup.tags.count(1) == 2 && new_lookup.words.count("w") == 2);
+    // 相同键的元素保持原来的顺序
+    assert(new_lookup.ordered == lookup.ordered);
+
+    // 复用模式, 流式解码, 分块模式与带索引的编码
+    zn_serialize::deserialize_reuse(buf, new_lookup);
+    assert(new_lookup.by_name.size() == 5000 && new_lookup.ids.size() == 5000 && new_lookup.words.size() == 2);
+    Lookup streamed;
+    stream_decode(buf, streamed, 4096);
+    assert(streamed.ids == lookup.ids && streamed.by_name.size() == 5000 && streamed.ordered == lookup.ordered);
+    ZnSerializeBuffer blocks;
+    zn_serialize::serialize_parallel(lookup, blocks);
+    zn_serialize::WorkerPool pool(2);
+    Lookup parallel;
+    zn_serialize::deserialize_parallel(blocks, parallel, &pool);
+    assert(parallel.ids == lookup.ids && parallel.by_name["4999"].a == 4999 && parallel.ordered == lookup.ordered);
+    ZnSerializeBuffer indexed;
+    zn_serialize::serialize_indexed(lookup, indexed);
+    Lookup from_indexed;
+    zn_serialize::deserialize_indexed(indexed, from_indexed);
+    assert(from_indexed.ids == lookup.ids && from_indexed.tags.count(1) == 2 && from_indexed.by_name["12"].a == 12);
+
+    // 增量编码按键比较无序容器
+    ZnSerializeBuffer delta;
+    bool changed = zn_serialize::serialize_delta(lookup, new_lookup, delta);
+    assert(!changed);
+    new_lookup.by_name["12"].a = -1;
+    changed = zn_serialize::serialize_delta(lookup, new_lookup, delta);
+    assert(changed);
+    (void)changed;
+}
+
+// 定长布局: 成员(包括基类与嵌套的结构体)全部定长时, 编码长度是编译期常量, 整体打包后一次写入
+ZN_STRUCT(Vec3)
+{
+    float x, y, z;
+    ZN_SERIALIZE(x, y, z);
+};
+
+ZN_STRUCT(Pose, Vec3)
+{
+    int32_t id;
+    Level level;
+    double angles[4];
+    std::array<uint16_t, 3> flags;
+    std::tuple<uint8_t, bool, int64_t> stamp;
+    Vec3 target[2];
+    ZN_SERIALIZE(id, level, angles, flags, stamp, target);
+};
+
+ZN_STRUCT(Sample)
+{
+    typedef zn_serialize::CompactFormat ZnFormat;
+    float value;
+    bool valid;
+    int8_t channel;
+    ZN_SERIALIZE(value, valid, channel);
+};
+
+static_assert(zn_serialize::FixedLayout<Vec3>::value && zn_serialize::FixedLayout<Vec3>::size == 12, "Vec3 should have a fixed layout");
+static_assert(zn_serialize::FixedLayout<Pose>::size == 12 + 4 + sizeof(Level) + 32 + 6 + 10 + 24, "Pose should have a fixed layout");
+static_assert(zn_serialize::FixedLayout<Pose, zn_serialize::PortableFormat>::size == zn_serialize::FixedLayout<Pose>::size, "portable layout should match");
+static_assert(!zn_serialize::FixedLayout<Pose, zn_serialize::CompactFormat>::value, "varints are not fixed");
+static_assert(zn_serialize::FixedLayout<Sample>::value && zn_serialize::FixedLayout<Sample>::size == 6, "Sample should have a fixed layout");
+static_assert(!zn_serialize::FixedLayout<Normal>::value && !zn_serialize::FixedLayout<Counter>::value, "strings and containers are not fixed");
+
+void test30(const Child& child)
+{
+    Pose pose;
+    pose.x = 1.5f; pose.y = -2.5f; pose.z = 3.0f;
+    pose.id = child.vector[0]->n1.a;
+    pose.level = Level::High;
+    for (int i = 0; i < 4; ++i)
+        pose.angles[i] = i * 0.25;
+    pose.flags = {{ 7, 8, 9 }};
+    pose.stamp = std::make_tuple(uint8_t(5), true, int64_t(-1099511627776));
+    pose.target[0].znset(4.0f, 5.0f, 6.0f);
+    pose.target[1].znset(-4.0f, -5.0f, -6.0f);
+    ZnSerializeBuffer buf;
+    pose.serialize(buf);
+    assert(buf.size() == zn_serialize::FixedLayout<Pose>::size && pose.serialized_size() == buf.size());
+
+    // 与逐个成员编码的字节相同
+    ZnSerializeBuffer members;
+    zn_serialize::serialize_values(members, pose.x, pose.y, pose.z, pose.id, pose.level, pose.angles, pose.flags, pose.stamp
+        , pose.target[0].x, pose.target[0].y, pose.target[0].z, pose.target[1].x, pose.target[1].y, pose.target[1].z);
+    assert(members == buf);
+
+    Pose new_pose;
+    const uint8_t* pose_end = new_pose.deserialize(buf.data(), buf.data() + buf.size());
+    assert(pose_end == buf.data() + buf.size());
+    (void)pose_end;
+    assert(new_pose.x == 1.5f && new_pose.z == 3.0f && new_pose.id == pose.id && new_pose.level == Level::High);
+    assert(new_pose.angles[3] == 0.75 && new_pose.flags == pose.flags && new_pose.stamp == pose.stamp && new_pose.target[1].y == -5.0f);
+
+    // 只检查一次剩余的字节数, 不足时不修改对象
+    Pose truncated;
+    truncated.id = -1;
+    assert(throws([&] { truncated.deserialize(buf.data(), buf.data() + buf.size() - 1); }));
+    assert(truncated.id == -1);
+
+    // 作为容器的元素, 其他格式与数组
+    std::vector<Pose> poses(3, pose);
+    ZnSerializeBuffer list;
+    zn_serialize::serialize(list, poses);
+    std::vector<Pose> new_poses;
+    zn_serialize::deserialize(list.data(), list.data() + list.size(), new_poses);
+    assert(new_poses.size() == 3 && new_poses[2].stamp == pose.stamp && new_poses[1].target[0].x == 4.0f);
+    ZnSerializeBuffer portable;
+    zn_serialize::FormatSink<zn_serialize::PortableFormat, ZnSerializeBuffer> out(portable);
+    pose.serialize_to(out);
+    assert((portable.size() == zn_serialize::FixedLayout<Pose, zn_serialize::PortableFormat>::size));
+    zn_serialize::Reader<zn_serialize::PortableFormat> in(portable);
+    Pose portable_pose;
+    portable_pose.deserialize_from(in);
+    assert(in.cursor == in.end && portable_pose.flags == pose.flags && portable_pose.target[0].z == 6.0f);
+
+    Sample samples[2];
+    samples[0].znset(0.5f, true, int8_t(-3));
+    samples[1].znset(1.5f, false, int8_t(4));
+    ZnSerializeBuffer compact;
+    samples[0].serialize(compact);
+    samples[1].serialize(compact);
+    assert(compact.size() == 2 * zn_serialize::FixedLayout<Sample>::size);
+    Sample new_sample;
+    auto next = new_sample.deserialize(compact.data(), compact.data() + compact.size());
+    new_sample.deserialize(next, compact.data() + compact.size());
+    assert(new_sample.value == 1.5f && !new_sample.valid && new_sample.channel == 4);
+}
+
 ZN_STRUCT(Empty, Used, Normal)
 {
     ZN_SERIALIZE();
@@ -158,6 +1566,30 @@ int main()
     test4();
     test5(child);
     test6();
+    test7(child);
+    test8();
+    test9(child);
+    test10();
+    test11(child);
+    test12();
+    test13(child);
+    test14(child);
+    test15();
+    test16(child);
+    test17(child);
+    test18(child);
+    test19(child);
+    test20(child);
+    test21(child);
+    test22(child);
+    test23(child);
+    test24(child);
+    test25(child);
+    test26(child);
+    test27(child);
+    test28(child);
+    test29(child);
+    test30(child);
 
     Empty emp;
     emp.Used::znset(child, child);